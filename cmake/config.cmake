@@ -31,6 +31,35 @@ else()
   message(FATAL_ERROR "${PICO_RUNTIME_SYSTEM} is not a supported runtime system.")
 endif()
 
+if (PICO_ENABLE_POOL_ALLOC)
+  message(STATUS "Pool allocator enabled.")
+  add_definitions(-DPICO_POOL_ALLOC)
+endif()
+
+if (PICO_ENABLE_NUMA)
+  find_path(NUMA_INCLUDE_DIR numa.h)
+  find_library(NUMA_LIBRARY numa)
+  if (NOT NUMA_INCLUDE_DIR OR NOT NUMA_LIBRARY)
+    message(FATAL_ERROR "NUMA placement requires libnuma.")
+  endif()
+  message(STATUS "NUMA placement enabled.")
+  include_directories(${NUMA_INCLUDE_DIR})
+  add_definitions(-DPICO_NUMA)
+  list(APPEND PICO_RUNTIME_LIB ${NUMA_LIBRARY})
+endif()
+
+if (PICO_ENABLE_ZLIB)
+  find_package(ZLIB)
+endif()
+if (PICO_ENABLE_ZLIB AND ZLIB_FOUND)
+  message(STATUS "Block-compressed file operators enabled.")
+  include_directories(${ZLIB_INCLUDE_DIRS})
+  add_definitions(-DPICO_ZLIB)
+  list(APPEND PICO_RUNTIME_LIB ${ZLIB_LIBRARIES})
+else()
+  message(STATUS "Block-compressed file operators disabled.")
+endif()
+
 if (PICO_ENABLE_UNIT_TEST)
   include_directories(tests/include)
 endif()
@@ -41,15 +41,19 @@ int main(int argc, char** argv) {
   }
   std::string in_fname(argv[1]), out_fname(argv[2]);
 
-  /* define a generic word-count pipeline */
-  pico::FlatMap<std::string, KV> tokenizer(
-      [](std::string& in, pico::FlatMapCollector<KV>& collector) {
-        std::string::size_type i = 0, j;
-        while ((j = in.find_first_of(' ', i)) != std::string::npos) {
-          collector.add(KV(in.substr(i, j - i), 1));
+  /*
+   * define a generic word-count pipeline
+   * lines are views into the input blocks, so only words are copied
+   */
+  pico::FlatMap<pico::LineView, KV> tokenizer(
+      [](pico::LineView& in, pico::FlatMapCollector<KV>& collector) {
+        size_t i = 0, j;
+        while ((j = in.find_first_of(' ', i)) != pico::LineView::npos) {
+          collector.add(KV(std::string(in.data() + i, j - i), 1));
           i = j + 1;
         }
-        if (i < in.size()) collector.add(KV(in.substr(i, in.size() - i), 1));
+        if (i < in.size())
+          collector.add(KV(std::string(in.data() + i, in.size() - i), 1));
       });
 
   auto countWords =
@@ -63,7 +67,7 @@ int main(int argc, char** argv) {
   // and streaming pipelines.
 
   /* define i/o operators from/to file */
-  pico::ReadFromFile reader(in_fname);
+  pico::BasicReadFromFile<pico::LineView> reader(in_fname);
   pico::WriteToDisk<KV> writer(out_fname);
 
   /* compose the pipeline */
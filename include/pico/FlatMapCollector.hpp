@@ -22,6 +22,7 @@
 #define INTERNALS_TYPES_FLATMAPCOLLECTOR_HPP_
 
 #include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
 #include "pico/Internals/Token.hpp"
 #include "pico/defines/Global.hpp"
 #include "pico/ff_implementation/ff_config.hpp"
@@ -58,7 +59,7 @@ class TokenCollector : public FlatMapCollector<DataType> {
   typedef Microbatch<Token<DataType>> mb_t;
 
  public:
-  TokenCollector() { clear(); }
+  TokenCollector(unsigned mb_size = 0) : sizer_(mb_size) { clear(); }
 
   /**
    * Add a token by copying a DataType value
@@ -106,8 +107,25 @@ class TokenCollector : public FlatMapCollector<DataType> {
 
   cnode *begin() { return first; }
 
+  /**
+   * The number of collected items.
+   */
+  unsigned size() const {
+    unsigned res = 0;
+    for (cnode *n = first; n; n = n->next) res += n->mb->size();
+    return res;
+  }
+
+  /**
+   * The sizer for the produced microbatches.
+   * The owner of the collector is expected to send the collected lists
+   * through it.
+   */
+  MicrobatchSizer &sizer() { return sizer_; }
+
  private:
   cnode *first, *head;
+  MicrobatchSizer sizer_;
 
   /*
    * ensure there is an available slot in the head node
@@ -132,7 +150,7 @@ class TokenCollector : public FlatMapCollector<DataType> {
     assert(this->tag());
     cnode *res = (cnode *)MALLOC(sizeof(cnode));
     res->next = nullptr;
-    res->mb = NEW<mb_t>(this->tag(), global_params.MICROBATCH_SIZE);
+    res->mb = NEW<mb_t>(this->tag(), sizer_.size());
     return res;
   }
 };
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_BOUNDEDCOMBINER_HPP_
+#define INTERNALS_BOUNDEDCOMBINER_HPP_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <utility>
+
+#include "pico/ff_implementation/ff_config.hpp"
+
+#include "FlatHashMap.hpp"
+
+/*
+ * Default number of entries of map-side combiners.
+ */
+#define COMBINER_ENTRIES (1 << 14)
+
+/*
+ * Number of entries per set of map-side combiners.
+ */
+#define COMBINER_WAYS 4
+
+namespace pico {
+
+/*
+ * A fixed-size cache of partially reduced key-value pairs, used for combining
+ * on the map side of map-reduce pipelines.
+ *
+ * The cache is set-associative: each key is mapped to a set of COMBINER_WAYS
+ * entries, where it is searched by linear scan.
+ * A key found in its set is reduced in place and swapped one entry towards the
+ * front of the set, so that frequent keys gather at the front.
+ * A missing key takes the first free entry of its set or, if the set is full,
+ * it evicts the last one, that is handed to the caller for being forwarded to
+ * the final reducer.
+ *
+ * Since the final reducer merges partial values, evictions only cost extra
+ * traffic, while memory is bounded by the number of entries.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class bounded_combiner {
+ public:
+  struct value_type {
+    K first;
+    V second;
+  };
+
+  /*
+   * builds a combiner of (at least) the given number of entries, zero standing
+   * for COMBINER_ENTRIES
+   */
+  explicit bounded_combiner(size_t entries = 0) {
+    if (!entries) entries = COMBINER_ENTRIES;
+    size_t sets = 2;
+    while (sets * COMBINER_WAYS < entries) sets <<= 1;
+    shift = 64 - __builtin_ctzll(sets);
+    capacity_ = sets * COMBINER_WAYS;
+    void *p = nullptr;
+    if (POSIX_MEMALIGN(&p, SLOT_ALIGN, capacity_ * sizeof(slot))) {
+      fprintf(stderr, "Unable to allocate combiner of %zu entries\n",
+              capacity_);
+      exit(1);
+    }
+    slots = (slot *)p;
+    for (size_t i = 0; i < capacity_; ++i) slots[i].hash = 0;
+  }
+
+  bounded_combiner(const bounded_combiner &) = delete;
+  bounded_combiner &operator=(const bounded_combiner &) = delete;
+
+  ~bounded_combiner() {
+    for (size_t i = 0; i < capacity_; ++i)
+      if (slots[i].hash) slots[i].kv.~value_type();
+    FREE(slots);
+  }
+
+  /*
+   * Reduces v into the entry of the given key, as by:
+   *   value = reduce_f(v, value)
+   * or inserts v if the key is not cached, possibly evicting an entry e by
+   * calling evict_f(e.first, e.second).
+   */
+  template <typename ReduceF, typename EvictF>
+  inline void reduce(const K &k, V &v, ReduceF &&reduce_f, EvictF &&evict_f) {
+    reduce(hash_of(k), k, v, reduce_f, evict_f);
+  }
+
+  /*
+   * Reduces n key-value pairs, as by
+   *   reduce(key_at(i), value_at(i), reduce_f, evict_f)
+   * for each i in [0, n).
+   *
+   * Keys are hashed a few pairs ahead of the one being reduced, and their sets
+   * are prefetched, so that the cache misses of close lookups overlap.
+   */
+  template <typename KeyAt, typename ValueAt, typename ReduceF,
+            typename EvictF>
+  void reduce_batch(size_t n, KeyAt &&key_at, ValueAt &&value_at,
+                    ReduceF &&reduce_f, EvictF &&evict_f) {
+    uint64_t ahead[FLAT_HASH_PREFETCH];
+    for (size_t i = 0; i < n && i < FLAT_HASH_PREFETCH; ++i)
+      ahead[i] = prefetch(key_at(i));
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t h = ahead[i % FLAT_HASH_PREFETCH];
+      size_t next = i + FLAT_HASH_PREFETCH;
+      if (next < n) ahead[i % FLAT_HASH_PREFETCH] = prefetch(key_at(next));
+      reduce(h, key_at(i), value_at(i), reduce_f, evict_f);
+    }
+  }
+
+  /*
+   * evicts all the entries
+   */
+  template <typename EvictF>
+  void flush(EvictF &&evict_f) {
+    for (size_t i = 0; i < capacity_; ++i)
+      if (slots[i].hash) {
+        evict_f(slots[i].kv.first, slots[i].kv.second);
+        slots[i].kv.~value_type();
+        slots[i].hash = 0;
+      }
+  }
+
+  inline size_t capacity() const { return capacity_; }
+
+  /*
+   * statistics, for tuning the number of entries
+   */
+  inline unsigned long long lookups() const { return lookups_; }
+
+  inline unsigned long long hits() const { return hits_; }
+
+  inline unsigned long long evictions() const { return evictions_; }
+
+ private:
+  static constexpr size_t SLOT_ALIGN = 64;  // cache line
+
+  struct slot {
+    uint64_t hash;  // zero for free entries
+    value_type kv;
+  };
+
+  slot *slots;
+  size_t capacity_, shift;
+  Hash hasher;
+  unsigned long long lookups_ = 0, hits_ = 0, evictions_ = 0;
+
+  /* Fibonacci hashing, as in flat_hash_map */
+  inline uint64_t hash_of(const K &k) const {
+    return ((uint64_t)hasher(k) * 0x9E3779B97F4A7C15ull) | 1;
+  }
+
+  inline slot *set_of(uint64_t h) const {
+    return slots + (h >> shift) * COMBINER_WAYS;
+  }
+
+  inline uint64_t prefetch(const K &k) const {
+    uint64_t h = hash_of(k);
+    __builtin_prefetch(set_of(h), 1);
+    return h;
+  }
+
+  /*
+   * The occupied entries of a set always form a prefix of the set, since
+   * entries are freed only by flushing the whole combiner.
+   */
+  template <typename ReduceF, typename EvictF>
+  inline void reduce(uint64_t h, const K &k, V &v, ReduceF &&reduce_f,
+                     EvictF &&evict_f) {
+    slot *set = set_of(h);
+    unsigned w = 0;
+    ++lookups_;
+    for (; w < COMBINER_WAYS && set[w].hash; ++w)
+      if (set[w].hash == h && set[w].kv.first == k) {
+        V &acc(set[w].kv.second);
+        acc = reduce_f(v, acc);
+        if (w) std::swap(set[w], set[w - 1]);
+        ++hits_;
+        return;
+      }
+
+    /* evict the last entry of a full set */
+    if (w == COMBINER_WAYS) {
+      --w;
+      evict_f(set[w].kv.first, set[w].kv.second);
+      set[w].kv.~value_type();
+      ++evictions_;
+    }
+    new (&set[w].kv) value_type{k, v};
+    set[w].hash = h;
+  }
+};
+
+} /* namespace pico */
+
+#endif /* INTERNALS_BOUNDEDCOMBINER_HPP_ */
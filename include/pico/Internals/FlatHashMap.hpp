@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FLATHASHMAP_HPP_
+#define INTERNALS_FLATHASHMAP_HPP_
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <utility>
+
+#include "pico/ff_implementation/ff_config.hpp"
+
+/*
+ * Number of lookups ahead of the current one, whose slots are prefetched by
+ * batched updates.
+ */
+#define FLAT_HASH_PREFETCH 8
+
+namespace pico {
+
+/*
+ * An open-addressing hash table, holding the per-key state of reducers.
+ *
+ * Entries are stored in place, in a single cache-aligned array of slots, and
+ * collisions are resolved by linear probing, so that a lookup usually touches
+ * a single cache line and updating a key costs one probe sequence.
+ * Each slot also stores the (mixed) hash of its key, that filters out most of
+ * the key comparisons and avoids hashing again upon growing.
+ *
+ * The table grows by doubling when 3/4 full, and it can be pre-sized for a
+ * given number of keys (e.g., from a cardinality hint).
+ * Entries are never removed, except by clearing the whole table.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class flat_hash_map {
+ public:
+  struct value_type {
+    K first;
+    V second;
+  };
+
+ private:
+  struct slot {
+    uint64_t hash;  // zero for empty slots
+    value_type kv;
+  };
+
+ public:
+  explicit flat_hash_map(size_t keys = 0) {
+    if (keys) reserve(keys);
+  }
+
+  flat_hash_map(const flat_hash_map &) = delete;
+  flat_hash_map &operator=(const flat_hash_map &) = delete;
+
+  flat_hash_map(flat_hash_map &&m)
+      : slots(m.slots), capacity_(m.capacity_), shift(m.shift), size_(m.size_) {
+    m.slots = nullptr;
+    m.capacity_ = m.size_ = 0;
+    m.shift = 64;
+  }
+
+  flat_hash_map &operator=(flat_hash_map &&m) {
+    if (this != &m) {
+      clear();
+      if (slots) FREE(slots);
+      slots = m.slots;
+      capacity_ = m.capacity_;
+      shift = m.shift;
+      size_ = m.size_;
+      m.slots = nullptr;
+      m.capacity_ = m.size_ = 0;
+      m.shift = 64;
+    }
+    return *this;
+  }
+
+  ~flat_hash_map() {
+    clear();
+    if (slots) FREE(slots);
+  }
+
+  /*
+   * grows the table (if needed) so that it can hold the given number of keys
+   * without further growing
+   */
+  void reserve(size_t keys) {
+    size_t cap = capacity_ ? capacity_ : MIN_CAPACITY;
+    while (keys > max_load(cap)) cap <<= 1;
+    if (cap != capacity_) rehash(cap);
+  }
+
+  /*
+   * Returns the entry for the given key, inserting (k, v) if the key is not
+   * in the table.
+   * The second member of the returned pair tells whether the key was inserted.
+   */
+  std::pair<value_type *, bool> insert(const K &k, const V &v) {
+    return insert(hash_of(k), k, v);
+  }
+
+  /*
+   * Reduces v into the value of the given key, as by:
+   *   value = reduce_f(v, value)
+   * or inserts v if the key is not in the table.
+   */
+  template <typename ReduceF>
+  inline void reduce(const K &k, V &v, ReduceF &&reduce_f) {
+    auto res = insert(k, v);
+    if (!res.second) res.first->second = reduce_f(v, res.first->second);
+  }
+
+  /*
+   * Inserts n key-value pairs, as by insert(key_at(i), value_at(i)) for each
+   * i in [0, n), and calls entry_f(i, res) with the result of each insertion.
+   *
+   * Keys are hashed a few pairs ahead of the one being inserted, and their home
+   * slots are prefetched, so that the cache misses of close lookups overlap.
+   */
+  template <typename KeyAt, typename ValueAt, typename EntryF>
+  void insert_batch(size_t n, KeyAt &&key_at, ValueAt &&value_at,
+                    EntryF &&entry_f) {
+    uint64_t ahead[FLAT_HASH_PREFETCH];
+    for (size_t i = 0; i < n && i < FLAT_HASH_PREFETCH; ++i)
+      ahead[i] = prefetch(key_at(i));
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t h = ahead[i % FLAT_HASH_PREFETCH];
+      size_t next = i + FLAT_HASH_PREFETCH;
+      if (next < n) ahead[i % FLAT_HASH_PREFETCH] = prefetch(key_at(next));
+      entry_f(i, insert(h, key_at(i), value_at(i)));
+    }
+  }
+
+  /*
+   * Reduces n key-value pairs, as by reduce(key_at(i), value_at(i), reduce_f)
+   * for each i in [0, n), prefetching as insert_batch().
+   */
+  template <typename KeyAt, typename ValueAt, typename ReduceF>
+  void reduce_batch(size_t n, KeyAt &&key_at, ValueAt &&value_at,
+                    ReduceF &&reduce_f) {
+    insert_batch(n, key_at, value_at,
+                 [&](size_t i, std::pair<value_type *, bool> res) {
+                   V &acc(res.first->second);
+                   if (!res.second) acc = reduce_f(value_at(i), acc);
+                 });
+  }
+
+  /*
+   * returns a pointer to the value of the given key, or nullptr if not found
+   */
+  V *find(const K &k) {
+    if (!size_) return nullptr;
+    uint64_t h = hash_of(k);
+    for (size_t i = home(h);; i = (i + 1) & (capacity_ - 1)) {
+      slot &s(slots[i]);
+      if (!s.hash) return nullptr;
+      if (s.hash == h && s.kv.first == k) return &s.kv.second;
+    }
+  }
+
+  V &operator[](const K &k) { return insert(k, V()).first->second; }
+
+  /*
+   * destroys all the entries, keeping the allocated slots
+   */
+  void clear() {
+    for (size_t i = 0; i < capacity_ && size_; ++i)
+      if (slots[i].hash) {
+        slots[i].kv.~value_type();
+        slots[i].hash = 0;
+        --size_;
+      }
+  }
+
+  inline size_t size() const { return size_; }
+
+  inline bool empty() const { return size_ == 0; }
+
+  inline size_t capacity() const { return capacity_; }
+
+  /*
+   * iterator over the entries, in slot order
+   */
+  class iterator {
+   public:
+    iterator(slot *p_, slot *end_) : p(p_), end(end_) { skip(); }
+    iterator &operator++() {
+      ++p;
+      skip();
+      return *this;
+    }
+    bool operator==(const iterator &rhs) const { return p == rhs.p; }
+    bool operator!=(const iterator &rhs) const { return p != rhs.p; }
+    value_type &operator*() const { return p->kv; }
+    value_type *operator->() const { return &p->kv; }
+
+   private:
+    slot *p, *end;
+    void skip() {
+      while (p != end && !p->hash) ++p;
+    }
+  };
+
+  iterator begin() { return iterator(slots, slots + capacity_); }
+
+  iterator end() {
+    return iterator(slots + capacity_, slots + capacity_);
+  }
+
+ private:
+  static constexpr size_t MIN_CAPACITY = 16;
+  static constexpr size_t SLOT_ALIGN = 64;  // cache line
+
+  slot *slots = nullptr;
+  size_t capacity_ = 0, shift = 64, size_ = 0;
+  Hash hasher;
+
+  static inline size_t max_load(size_t cap) { return cap / 4 * 3; }
+
+  /*
+   * Mixes the user hash by Fibonacci hashing, so that the home slot (taken
+   * from the high bits) depends on all the hash bits.
+   * The lowest bit is set to tell occupied slots.
+   */
+  inline uint64_t hash_of(const K &k) const {
+    return ((uint64_t)hasher(k) * 0x9E3779B97F4A7C15ull) | 1;
+  }
+
+  inline size_t home(uint64_t h) const { return h >> shift; }
+
+  inline uint64_t prefetch(const K &k) const {
+    uint64_t h = hash_of(k);
+    if (slots) __builtin_prefetch(slots + home(h), 1);
+    return h;
+  }
+
+  std::pair<value_type *, bool> insert(uint64_t h, const K &k, const V &v) {
+    if (size_ + 1 > max_load(capacity_))
+      rehash(capacity_ ? capacity_ << 1 : MIN_CAPACITY);
+    size_t i = home(h);
+    for (;; i = (i + 1) & (capacity_ - 1)) {
+      slot &s(slots[i]);
+      if (!s.hash) break;
+      if (s.hash == h && s.kv.first == k) return {&s.kv, false};
+    }
+    new (&slots[i].kv) value_type{k, v};
+    slots[i].hash = h;
+    ++size_;
+    return {&slots[i].kv, true};
+  }
+
+  void rehash(size_t cap) {
+    assert(cap && !(cap & (cap - 1)) && max_load(cap) >= size_);
+    slot *old = slots;
+    size_t old_cap = capacity_;
+    void *p = nullptr;
+    if (POSIX_MEMALIGN(&p, SLOT_ALIGN, cap * sizeof(slot))) {
+      fprintf(stderr, "Unable to allocate hash table of %zu slots\n", cap);
+      exit(1);
+    }
+    slots = (slot *)p;
+    for (size_t i = 0; i < cap; ++i) slots[i].hash = 0;
+    capacity_ = cap;
+    shift = 64 - __builtin_ctzll(cap);
+
+    /* move entries to the new slots */
+    for (size_t j = 0; j < old_cap; ++j) {
+      slot &s(old[j]);
+      if (!s.hash) continue;
+      size_t i = home(s.hash);
+      while (slots[i].hash) i = (i + 1) & (cap - 1);
+      new (&slots[i].kv) value_type{std::move(s.kv.first),
+                                    std::move(s.kv.second)};
+      slots[i].hash = s.hash;
+      s.kv.~value_type();
+    }
+    if (old) FREE(old);
+  }
+};
+
+} /* namespace pico */
+
+#endif /* INTERNALS_FLATHASHMAP_HPP_ */
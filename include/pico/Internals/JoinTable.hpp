@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_JOINTABLE_HPP_
+#define INTERNALS_JOINTABLE_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "FlatHashMap.hpp"
+
+/*
+ * Number of radix partitions of join tables (a power of two).
+ */
+#define JOIN_PARTITIONS 64
+
+namespace pico {
+
+/*
+ * The build side of a hash join: a multimap from keys to key-value items,
+ * stored in a few flat arrays.
+ *
+ * Items are radix-partitioned by (mixed) key hash. Each partition stores its
+ * items contiguously, in insertion order, and chains the items with the same
+ * key by their indices, from the last inserted one, that is held by a
+ * per-partition flat_hash_map.
+ * Hence inserting an item does not allocate (except for growing the arrays)
+ * and a probe only touches the partition of its key, so that probing a
+ * micro-batch partition by partition keeps each partition in cache.
+ */
+template <typename T, typename Hash = std::hash<typename T::keytype>>
+class join_table {
+  typedef typename T::keytype K;
+  static constexpr uint32_t NIL = UINT32_MAX;
+
+  struct partition {
+    std::vector<T> items;
+    std::vector<uint32_t> next;              // previous item with the same key
+    flat_hash_map<K, uint32_t, Hash> last;  // last item of each key
+  };
+
+ public:
+  void insert(const T &t) {
+    if (parts.empty()) parts.resize(JOIN_PARTITIONS);
+    auto &p(parts[partition_of(t.Key())]);
+    uint32_t i = p.items.size();
+    auto res = p.last.insert(t.Key(), i);
+    p.next.push_back(res.second ? NIL : res.first->second);
+    res.first->second = i;
+    p.items.push_back(t);
+    ++size_;
+  }
+
+  /* stores all the items of a micro-batch */
+  template <typename Mb>
+  void insert_all(Mb &mb) {
+    for (auto &t : mb) insert(t);
+  }
+
+  /*
+   * Calls match_f(probe item, stored item) for each item of the micro-batch
+   * and each stored item with the same key.
+   * Probe items are visited grouped by partition.
+   */
+  template <typename Mb, typename MatchF>
+  void probe(Mb &mb, MatchF &&match_f) {
+    if (!size_) return;
+    unsigned n = mb.size();
+
+    /* counting sort of the probe items by partition */
+    probe_part.resize(n);
+    order.resize(n);
+    offset.assign(JOIN_PARTITIONS + 1, 0);
+    for (unsigned i = 0; i < n; ++i) {
+      probe_part[i] = partition_of(mb.at(i).Key());
+      ++offset[probe_part[i] + 1];
+    }
+    for (unsigned j = 0; j < JOIN_PARTITIONS; ++j) offset[j + 1] += offset[j];
+    for (unsigned i = 0; i < n; ++i) order[offset[probe_part[i]]++] = i;
+
+    for (auto i : order) {
+      auto &in(mb.at(i));
+      auto &p(parts[probe_part[i]]);
+      auto l = p.last.find(in.Key());
+      if (!l) continue;
+      for (uint32_t j = *l; j != NIL; j = p.next[j]) match_f(in, p.items[j]);
+    }
+  }
+
+  /* releases all the items */
+  void clear() {
+    std::vector<partition>().swap(parts);
+    size_ = 0;
+  }
+
+  inline size_t size() const { return size_; }
+
+  inline bool empty() const { return size_ == 0; }
+
+ private:
+  std::vector<partition> parts;
+  size_t size_ = 0;
+  Hash hasher;
+
+  /* scratch space for probing */
+  std::vector<unsigned> probe_part, order, offset;
+
+  /*
+   * The partition is taken from middle bits of the Fibonacci-mixed hash, so
+   * that it is independent of both the worker a key is routed to and the
+   * slot of the key in the partition table (taken from the high bits).
+   */
+  inline unsigned partition_of(const K &k) const {
+    uint64_t h = (uint64_t)hasher(k) * 0x9E3779B97F4A7C15ull;
+    return (h >> 24) & (JOIN_PARTITIONS - 1);
+  }
+};
+
+} /* namespace pico */
+
+#endif /* INTERNALS_JOINTABLE_HPP_ */
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_TYPES_KVMICROBATCH_HPP_
+#define INTERNALS_TYPES_KVMICROBATCH_HPP_
+
+#include <cassert>
+#include <new>
+#include <type_traits>
+
+#include "Microbatch.hpp"
+#include "Token.hpp"
+
+#include "pico/KeyValue.hpp"
+
+namespace pico {
+
+/*
+ * Tells whether key-value items decorated by TokenType are stored by column.
+ *
+ * Columns are used for plain (i.e., meta-data free) tokens carrying key-value
+ * pairs with trivially-copyable keys and values.
+ */
+template <typename TokenType>
+struct is_columnar_kv : std::false_type {};
+
+template <typename K, typename V>
+struct is_columnar_kv<Token<KeyValue<K, V>>>
+    : std::integral_constant<bool, std::is_trivially_copyable<K>::value &&
+                                       std::is_trivially_copyable<V>::value> {
+};
+
+/**
+ * ColumnarMicrobatch is the struct-of-arrays counterpart of Microbatch, for
+ * key-value collections.
+ *
+ * The chunk stores all the keys first, then all the values, so that keyed
+ * nodes (partitioners and reducers) can stream over contiguous keys.
+ * Since keys and values are trivially copyable, no token descriptors are
+ * stored and no destructors are called.
+ *
+ * Unlike Microbatch, items are appended by a single push(), that both
+ * allocates and commits.
+ */
+template <typename TokenType>
+class ColumnarMicrobatch : public base_microbatch {
+ public:
+  typedef typename TokenType::datatype DataType;
+  typedef typename DataType::keytype K;
+  typedef typename DataType::valuetype V;
+
+  ColumnarMicrobatch(base_microbatch::tag_t tag, unsigned int slots_)
+      : base_microbatch(tag, (char *)MALLOC(chunk_size(slots_))),
+        slots(slots_),
+        committed(0) {
+    assert(slots_);
+  }
+
+  ~ColumnarMicrobatch() {
+    if (chunk) FREE(chunk);
+  }
+
+  inline void push(const K &k, const V &v) {
+    assert(!full());
+    new (keys() + committed) K(k);
+    new (values() + committed) V(v);
+    ++committed;
+  }
+
+  inline K *keys() const { return (K *)chunk; }
+
+  inline V *values() const { return (V *)(chunk + values_offset(slots)); }
+
+  inline bool full() const { return committed == slots; }
+
+  inline bool empty() const { return committed == 0; }
+
+  inline unsigned size() const { return committed; }
+
+ private:
+  const unsigned int slots;
+  unsigned int committed;
+
+  static size_t values_offset(unsigned slots_) {
+    size_t a = alignof(V);
+    return (slots_ * sizeof(K) + a - 1) / a * a;
+  }
+
+  static size_t chunk_size(unsigned slots_) {
+    return values_offset(slots_) + slots_ * sizeof(V);
+  }
+};
+
+/*
+ * Uniform access to the microbatches flowing along keyed edges (e.g., from a
+ * by-key partitioner to its reducers), either row- or column-based depending
+ * on the token type.
+ */
+template <typename TokenType, bool = is_columnar_kv<TokenType>::value>
+struct kv_microbatch {
+  typedef Microbatch<TokenType> type;
+  typedef typename TokenType::datatype DataType;
+  typedef typename DataType::keytype K;
+  typedef typename DataType::valuetype V;
+
+  static inline void push(type *mb, const K &k, const V &v) {
+    new (mb->allocate()) DataType(k, v);
+    mb->commit();
+  }
+
+  static inline const K &first_key(type *mb) { return (*mb->begin()).Key(); }
+
+  /* calls f(key, value) for each item */
+  template <typename F>
+  static inline void for_each(type *mb, F &&f) {
+    for (DataType &kv : *mb) f(kv.Key(), kv.Value());
+  }
+
+  /* the key and the value of the i-th item */
+  static inline const K &key(type *mb, unsigned i) { return mb->at(i).Key(); }
+
+  static inline V &value(type *mb, unsigned i) { return mb->at(i).Value(); }
+
+  /* reduces all the items into a keyed table (see flat_hash_map) */
+  template <typename Table, typename F>
+  static inline void reduce_into(Table &t, type *mb, F &&f) {
+    t.reduce_batch(
+        mb->size(), [&](unsigned i) -> const K & { return key(mb, i); },
+        [&](unsigned i) -> V & { return value(mb, i); }, f);
+  }
+};
+
+template <typename TokenType>
+struct kv_microbatch<TokenType, true> {
+  typedef ColumnarMicrobatch<TokenType> type;
+  typedef typename type::K K;
+  typedef typename type::V V;
+
+  static inline void push(type *mb, const K &k, const V &v) { mb->push(k, v); }
+
+  static inline const K &first_key(type *mb) { return mb->keys()[0]; }
+
+  template <typename F>
+  static inline void for_each(type *mb, F &&f) {
+    K *keys = mb->keys();
+    V *values = mb->values();
+    for (unsigned i = 0, n = mb->size(); i < n; ++i) f(keys[i], values[i]);
+  }
+
+  static inline const K &key(type *mb, unsigned i) { return mb->keys()[i]; }
+
+  static inline V &value(type *mb, unsigned i) { return mb->values()[i]; }
+
+  template <typename Table, typename F>
+  static inline void reduce_into(Table &t, type *mb, F &&f) {
+    K *keys = mb->keys();
+    V *values = mb->values();
+    t.reduce_batch(
+        mb->size(), [&](unsigned i) -> const K & { return keys[i]; },
+        [&](unsigned i) -> V & { return values[i]; }, f);
+  }
+};
+
+} /* namespace pico */
+
+#endif /* INTERNALS_TYPES_KVMICROBATCH_HPP_ */
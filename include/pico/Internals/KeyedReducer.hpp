@@ -0,0 +1,595 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_KEYEDREDUCER_HPP_
+#define INTERNALS_KEYEDREDUCER_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "FlatHashMap.hpp"
+#include "SpillFile.hpp"
+
+/*
+ * Number of distinct keys beyond which automatic aggregation switches from
+ * hashing to sorting.
+ */
+#define SORT_AGG_KEYS (1 << 20)
+
+/*
+ * Number of pairs buffered by sort-based aggregation before sorting them into
+ * a run.
+ */
+#define SORT_RUN_ITEMS (1 << 16)
+
+/*
+ * Number of runs of the same size merged into a larger one.
+ */
+#define SORT_MERGE_FANOUT 8
+
+/*
+ * Number of spilled runs of the same level merged into a single one, bounding
+ * the number of open spill files (to fewer than SPILL_MERGE_FANOUT per level).
+ */
+#define SPILL_MERGE_FANOUT 64
+
+namespace pico {
+
+/**
+ * The strategy of keyed aggregation (see ReduceByKey::aggregation).
+ *
+ * HASH reduces into a hash table, SORT sorts pairs into runs and merges them,
+ * AUTO starts hashing and switches to sorting when keys grow large.
+ */
+enum class Aggregation { AUTO, HASH, SORT };
+
+/*
+ * The configuration of the keyed state of a reducer.
+ */
+struct keyed_state_cfg {
+  Aggregation agg = Aggregation::AUTO;
+  size_t memory_budget = 0;  // in bytes, zero for unbounded
+};
+
+/*
+ * Statistics of the runs spilled to disk.
+ *
+ * budget_ignored tells that a memory budget was given for a state that cannot
+ * be spilled (see keyed_reducer), so that it is kept in memory.
+ */
+struct spill_stats {
+  unsigned long long runs = 0, bytes = 0;
+  std::chrono::duration<double> merge_time{0};
+  bool budget_ignored = false;
+
+  void add(const spill_stats &s) {
+    runs += s.runs;
+    bytes += s.bytes;
+    merge_time += s.merge_time;
+    budget_ignored = budget_ignored || s.budget_ignored;
+  }
+
+  void print(std::ostream &os) const {
+    if (budget_ignored)
+      os << "  PICO-spill budget   : ignored (unspillable keys or values)\n";
+    os << "  PICO-spill runs     : " << runs << "\n";
+    os << "  PICO-spill bytes    : " << bytes << "\n";
+    os << "  PICO-spill merge ms : " << merge_time.count() * 1000 << "\n";
+  }
+};
+
+/*
+ * Tells whether keys can be sorted, i.e., compared by operator<.
+ */
+template <typename K, typename = void>
+struct is_sortable_key : std::false_type {};
+
+template <typename K>
+struct is_sortable_key<K, decltype(void(std::declval<const K &>() <
+                                        std::declval<const K &>()))>
+    : std::true_type {};
+
+/*
+ * Sort-based reduce state.
+ *
+ * Pairs are appended to a buffer, that is sorted by key and reduced into a run
+ * of distinct keys when full.
+ * Runs are merged SORT_MERGE_FANOUT at a time into larger runs (as in a
+ * log-structured merge), so that at most SORT_MERGE_FANOUT runs per size are
+ * kept and each pair takes part in a logarithmic number of merges.
+ * Draining merges all the runs, producing keys in ascending order.
+ *
+ * Memory is sequentially accessed, unlike hash tables whose random accesses
+ * miss the cache once the table outgrows it, and keys are stored compactly
+ * rather than in sparse slots.
+ * As for reduce-by-key in general, values of the same key are reduced in no
+ * specific order.
+ *
+ * Given a memory budget, runs are merged and spilled to a file as soon as
+ * they exceed it (see spill_file), provided that keys and values can be
+ * encoded (see spill_codec). Draining then merges the spilled runs as well.
+ */
+template <typename K, typename V>
+class sort_reducer {
+  typedef std::pair<K, V> pair_t;
+  typedef std::vector<pair_t> run_t;
+
+ public:
+  static constexpr bool spillable =
+      spill_codec<K>::enabled && spill_codec<V>::enabled &&
+      std::is_default_constructible<K>::value &&
+      std::is_default_constructible<V>::value;
+
+  explicit sort_reducer(size_t run_items_ = SORT_RUN_ITEMS,
+                        size_t budget_ = 0)
+      : run_items(run_items_), budget(spillable ? budget_ : 0) {}
+
+  template <typename ReduceF>
+  inline void reduce(const K &k, const V &v, ReduceF &&reduce_f) {
+    buf.emplace_back(k, v);
+    if (budget) buf_bytes += bytes(buf.back());
+    if (buf.size() >= run_items || (budget && buf_bytes > budget))
+      seal(reduce_f);
+  }
+
+  /*
+   * reduces n key-value pairs, as by reduce(key_at(i), value_at(i), reduce_f)
+   * for each i in [0, n)
+   */
+  template <typename KeyAt, typename ValueAt, typename ReduceF>
+  void reduce_batch(size_t n, KeyAt &&key_at, ValueAt &&value_at,
+                    ReduceF &&reduce_f) {
+    for (size_t i = 0; i < n; ++i) reduce(key_at(i), value_at(i), reduce_f);
+  }
+
+  /*
+   * Calls emit_f(key, value) for each key, in ascending key order, then clears
+   * the state.
+   */
+  template <typename ReduceF, typename EmitF>
+  void drain(ReduceF &&reduce_f, EmitF &&emit_f) {
+    seal(reduce_f);
+    if (spills.empty())
+      merge(0, reduce_f, emit_f);
+    else if constexpr (spillable)
+      merge_spilled(reduce_f, emit_f);
+    runs.clear();
+    levels.clear();
+    run_bytes.clear();
+    spills.clear();
+    spill_levels.clear();
+  }
+
+  /* the number of buffered pairs, an upper bound to the number of keys */
+  size_t size() const {
+    size_t res = buf.size();
+    for (auto &r : runs) res += r.size();
+    return res;
+  }
+
+  bool empty() const { return buf.empty() && runs.empty() && spills.empty(); }
+
+  const spill_stats &stats() const { return stats_; }
+
+ private:
+  const size_t run_items, budget;
+  run_t buf, radix_buf;
+  std::vector<run_t> runs;       // from the largest to the smallest
+  std::vector<unsigned> levels;  // the number of merges behind each run
+  std::vector<size_t> run_bytes;
+  size_t buf_bytes = 0, mem_bytes = 0;  // tracked only given a budget
+  std::vector<std::unique_ptr<spill_file>> spills;  // as runs
+  std::vector<unsigned> spill_levels;
+  spill_stats stats_;
+
+  static constexpr bool radix_sortable =
+      std::is_integral<K>::value && !std::is_same<K, bool>::value &&
+      std::is_trivially_copyable<V>::value;
+
+  static bool less(const pair_t &a, const pair_t &b) {
+    return a.first < b.first;
+  }
+
+  static size_t bytes(const pair_t &kv) {
+    return spill_codec<K>::bytes(kv.first) + spill_codec<V>::bytes(kv.second);
+  }
+
+  /*
+   * restores the min-heap property from the i-th element downwards
+   */
+  template <typename T, typename Less>
+  static void sift_down(std::vector<T> &heap, size_t i, Less &&less_f) {
+    size_t n = heap.size();
+    T c = heap[i];
+    for (size_t j; (j = 2 * i + 1) < n; i = j) {
+      if (j + 1 < n && less_f(heap[j + 1], heap[j])) ++j;
+      if (!less_f(heap[j], c)) break;
+      heap[i] = heap[j];
+    }
+    heap[i] = c;
+  }
+
+  /*
+   * Sorts the buffer by key, by LSD radix sort for integral keys and by
+   * comparison otherwise.
+   * Radix sort takes one byte per pass, skipping the bytes shared by all the
+   * keys (e.g., the high bytes of small keys).
+   */
+  void sort_buf() {
+    if constexpr (radix_sortable) {
+      typedef typename std::make_unsigned<K>::type UK;
+      constexpr unsigned bytes = sizeof(K);
+      constexpr UK flip = std::is_signed<K>::value ? UK(1) << (8 * bytes - 1)
+                                                   : UK(0);
+      auto digit = [&](const K &k, unsigned b) -> unsigned {
+        return (UK(k) ^ flip) >> (8 * b) & 0xff;
+      };
+      size_t n = buf.size(), cnt[bytes][256] = {};
+      for (auto &kv : buf)
+        for (unsigned b = 0; b < bytes; ++b) ++cnt[b][digit(kv.first, b)];
+      radix_buf.resize(n);
+      pair_t *src = buf.data(), *dst = radix_buf.data();
+      for (unsigned b = 0; b < bytes; ++b) {
+        if (cnt[b][digit(src[0].first, b)] == n) continue;
+        size_t pos = 0;
+        for (auto &c : cnt[b]) {
+          size_t tmp = c;
+          c = pos;
+          pos += tmp;
+        }
+        for (size_t i = 0; i < n; ++i)
+          dst[cnt[b][digit(src[i].first, b)]++] = src[i];
+        std::swap(src, dst);
+      }
+      if (src != buf.data()) buf.swap(radix_buf);
+    } else
+      std::sort(buf.begin(), buf.end(), less);
+  }
+
+  /*
+   * sorts and reduces the buffer into a new run, then merges the runs of the
+   * same level while SORT_MERGE_FANOUT of them are found, and spills the runs
+   * if beyond the memory budget
+   */
+  template <typename ReduceF>
+  void seal(ReduceF &reduce_f) {
+    if (buf.empty()) return;
+    sort_buf();
+    size_t w = 0;
+    for (size_t i = 1; i < buf.size(); ++i) {
+      if (buf[w].first < buf[i].first) {
+        if (++w != i) buf[w] = std::move(buf[i]);
+      } else
+        buf[w].second = reduce_f(buf[i].second, buf[w].second);
+    }
+    buf.resize(w + 1);
+    push_run(std::move(buf), 0);
+    buf = run_t();
+    buf.reserve(run_items);
+    buf_bytes = 0;
+
+    while (runs.size() >= SORT_MERGE_FANOUT &&
+           levels[runs.size() - SORT_MERGE_FANOUT] == levels.back()) {
+      size_t from = runs.size() - SORT_MERGE_FANOUT;
+      unsigned level = levels.back() + 1;
+      run_t merged;
+      size_t items = 0;
+      for (size_t i = from; i < runs.size(); ++i) items += runs[i].size();
+      merged.reserve(items);
+      merge(from, reduce_f, [&](K &k, V &v) {
+        merged.emplace_back(std::move(k), std::move(v));
+      });
+      for (size_t i = from; i < runs.size(); ++i) mem_bytes -= run_bytes[i];
+      runs.resize(from);
+      levels.resize(from);
+      run_bytes.resize(from);
+      push_run(std::move(merged), level);
+    }
+
+    if (budget && mem_bytes > budget) spill(reduce_f);
+  }
+
+  void push_run(run_t &&run, unsigned level) {
+    size_t b = 0;
+    if (budget)
+      for (auto &kv : run) b += bytes(kv);
+    runs.push_back(std::move(run));
+    levels.push_back(level);
+    run_bytes.push_back(b);
+    mem_bytes += b;
+  }
+
+  /*
+   * k-way merges the in-memory runs from the given one, reducing equal keys
+   * and calling emit_f(key, value) in ascending key order
+   */
+  template <typename ReduceF, typename EmitF>
+  void merge(size_t from, ReduceF &reduce_f, EmitF &&emit_f) {
+    struct cursor {
+      pair_t *p, *end;
+    };
+    auto head_less = [](const cursor &a, const cursor &b) {
+      return a.p->first < b.p->first;
+    };
+
+    /* a binary min-heap of the run heads */
+    std::vector<cursor> heap;
+    for (size_t i = from; i < runs.size(); ++i)
+      if (!runs[i].empty())
+        heap.push_back(cursor{runs[i].data(), runs[i].data() + runs[i].size()});
+    for (size_t i = heap.size() / 2; i-- > 0;) sift_down(heap, i, head_less);
+
+    pair_t *acc = nullptr;
+    while (!heap.empty()) {
+      cursor &c(heap.front());
+      if (acc && !(acc->first < c.p->first))
+        acc->second = reduce_f(c.p->second, acc->second);
+      else {
+        if (acc) emit_f(acc->first, acc->second);
+        acc = c.p;
+      }
+      if (++c.p == c.end) {
+        c = heap.back();
+        heap.pop_back();
+      }
+      if (!heap.empty()) sift_down(heap, 0, head_less);
+    }
+    if (acc) emit_f(acc->first, acc->second);
+  }
+
+  /*
+   * a run being merged, either in memory or spilled
+   */
+  struct stream {
+    pair_t head;
+    pair_t *p = nullptr, *end = nullptr;
+    spill_file *f = nullptr;
+
+    bool next() {
+      if (f)
+        return spill_codec<K>::read(*f, head.first) &&
+               spill_codec<V>::read(*f, head.second);
+      if (p == end) return false;
+      head = std::move(*p++);
+      return true;
+    }
+  };
+
+  /*
+   * k-way merges the given runs, as merge()
+   */
+  template <typename ReduceF, typename EmitF>
+  void merge_streams(std::vector<stream> &streams, ReduceF &reduce_f,
+                     EmitF &&emit_f) {
+    auto head_less = [](const stream *a, const stream *b) {
+      return a->head.first < b->head.first;
+    };
+    std::vector<stream *> heap;
+    for (auto &s : streams) {
+      if (s.f) s.f->rewind();
+      if (s.next()) heap.push_back(&s);
+    }
+    for (size_t i = heap.size() / 2; i-- > 0;) sift_down(heap, i, head_less);
+
+    pair_t acc;
+    bool any = false;
+    while (!heap.empty()) {
+      stream *s = heap.front();
+      if (any && !(acc.first < s->head.first))
+        acc.second = reduce_f(s->head.second, acc.second);
+      else {
+        if (any) emit_f(acc.first, acc.second);
+        acc = std::move(s->head);
+        any = true;
+      }
+      if (!s->next()) {
+        heap.front() = heap.back();
+        heap.pop_back();
+      }
+      if (!heap.empty()) sift_down(heap, 0, head_less);
+    }
+    if (any) emit_f(acc.first, acc.second);
+  }
+
+  /*
+   * Merges the in-memory runs into a new spilled run, then merges the last
+   * spilled runs into a single one as long as SPILL_MERGE_FANOUT of them are
+   * found at the same level, as seal() does in memory.
+   * Thus each spilled pair is rewritten a logarithmic number of times.
+   */
+  template <typename ReduceF>
+  void spill(ReduceF &reduce_f) {
+    if constexpr (spillable) {
+      auto f = std::unique_ptr<spill_file>(new spill_file());
+      merge(0, reduce_f, [&](const K &k, const V &v) { write(*f, k, v); });
+      stats_.runs++;
+      stats_.bytes += f->size();
+      spills.push_back(std::move(f));
+      spill_levels.push_back(0);
+      runs.clear();
+      levels.clear();
+      run_bytes.clear();
+      mem_bytes = 0;
+
+      while (spills.size() >= SPILL_MERGE_FANOUT &&
+             spill_levels[spills.size() - SPILL_MERGE_FANOUT] ==
+                 spill_levels.back()) {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        size_t from = spills.size() - SPILL_MERGE_FANOUT;
+        unsigned level = spill_levels.back() + 1;
+        std::vector<stream> streams(SPILL_MERGE_FANOUT);
+        for (size_t i = 0; i < SPILL_MERGE_FANOUT; ++i)
+          streams[i].f = spills[from + i].get();
+        auto merged = std::unique_ptr<spill_file>(new spill_file());
+        merge_streams(streams, reduce_f,
+                      [&](const K &k, const V &v) { write(*merged, k, v); });
+        stats_.bytes += merged->size();
+        spills.resize(from);
+        spill_levels.resize(from);
+        spills.push_back(std::move(merged));
+        spill_levels.push_back(level);
+        stats_.merge_time += std::chrono::high_resolution_clock::now() - t0;
+      }
+    }
+  }
+
+  /*
+   * merges the spilled runs with the in-memory ones
+   */
+  template <typename ReduceF, typename EmitF>
+  void merge_spilled(ReduceF &reduce_f, EmitF &&emit_f) {
+    auto t0 = std::chrono::high_resolution_clock::now();
+    std::vector<stream> streams(spills.size() + runs.size());
+    size_t i = 0;
+    for (auto &f : spills) streams[i++].f = f.get();
+    for (auto &r : runs) {
+      streams[i].p = r.data();
+      streams[i++].end = r.data() + r.size();
+    }
+    merge_streams(streams, reduce_f, emit_f);
+    stats_.merge_time += std::chrono::high_resolution_clock::now() - t0;
+  }
+
+  static void write(spill_file &f, const K &k, const V &v) {
+    spill_codec<K>::write(f, k);
+    spill_codec<V>::write(f, v);
+  }
+};
+
+/*
+ * The per-key state of reducers, either hash- or sort-based (see
+ * Aggregation).
+ *
+ * Automatic aggregation hashes until the table holds SORT_AGG_KEYS keys, then
+ * moves the table into a sorted run and keeps sorting.
+ * It starts sorting if the expected number of keys is beyond that threshold.
+ * Sorting requires keys to be comparable by operator<, otherwise hashing is
+ * always used.
+ *
+ * Given a memory budget, a hash table outgrowing it is moved into sorted runs
+ * as well, so that they can be spilled to disk (see sort_reducer).
+ * The budget is ignored if keys cannot be sorted, or if keys or values cannot
+ * be encoded (see spill_codec), as reported by spills().
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class keyed_reducer {
+  static constexpr bool sortable = is_sortable_key<K>::value;
+
+ public:
+  static constexpr bool spillable =
+      sortable && sort_reducer<K, V>::spillable;
+
+  explicit keyed_reducer(size_t keys = 0,
+                         keyed_state_cfg cfg = keyed_state_cfg())
+      : agg(sortable ? cfg.agg : Aggregation::HASH),
+        budget(spillable ? cfg.memory_budget : 0),
+        budget_ignored(cfg.memory_budget && !spillable),
+        sorting(agg == Aggregation::SORT ||
+                (agg == Aggregation::AUTO && keys > SORT_AGG_KEYS)),
+        table(sorting ? 0 : keys),
+        sorted(SORT_RUN_ITEMS, budget) {}
+
+  /*
+   * reduces n key-value pairs, as by flat_hash_map::reduce_batch()
+   */
+  template <typename KeyAt, typename ValueAt, typename ReduceF>
+  void reduce_batch(size_t n, KeyAt &&key_at, ValueAt &&value_at,
+                    ReduceF &&reduce_f) {
+    if constexpr (sortable)
+      if (sorting) {
+        sorted.reduce_batch(n, key_at, value_at, reduce_f);
+        return;
+      }
+    table.reduce_batch(n, key_at, value_at, reduce_f);
+    switch_if_large(reduce_f);
+  }
+
+  template <typename ReduceF>
+  inline void reduce(const K &k, V &v, ReduceF &&reduce_f) {
+    if constexpr (sortable)
+      if (sorting) {
+        sorted.reduce(k, v, reduce_f);
+        return;
+      }
+    table.reduce(k, v, reduce_f);
+    switch_if_large(reduce_f);
+  }
+
+  /*
+   * Calls emit_f(key, value) for each key, then clears the state.
+   * Keys are produced in ascending order if sorting.
+   */
+  template <typename ReduceF, typename EmitF>
+  void drain(ReduceF &&reduce_f, EmitF &&emit_f) {
+    if constexpr (sortable)
+      if (sorting) {
+        sorted.drain(reduce_f, emit_f);
+        return;
+      }
+    for (auto &kv : table) emit_f(kv.first, kv.second);
+    table.clear();
+  }
+
+  /* tells whether the state is sort-based */
+  bool sort_based() const { return sorting; }
+
+  bool empty() const { return sorting ? sorted.empty() : table.empty(); }
+
+  spill_stats spills() const {
+    spill_stats res(sorted.stats());
+    res.budget_ignored = budget_ignored;
+    return res;
+  }
+
+ private:
+  const Aggregation agg;
+  const size_t budget;
+  const bool budget_ignored;
+  bool sorting;
+  flat_hash_map<K, V, Hash> table;
+  sort_reducer<K, V> sorted;
+
+  /* approximate size of the hash table (ignoring any out-of-slot data) */
+  size_t table_bytes() const {
+    return table.capacity() * (sizeof(uint64_t) + sizeof(K) + sizeof(V));
+  }
+
+  template <typename ReduceF>
+  inline void switch_if_large(ReduceF &reduce_f) {
+    if constexpr (sortable)
+      if ((agg == Aggregation::AUTO && table.size() > SORT_AGG_KEYS) ||
+          (budget && table_bytes() > budget)) {
+        for (auto &kv : table) sorted.reduce(kv.first, kv.second, reduce_f);
+        table = flat_hash_map<K, V, Hash>();
+        sorting = true;
+      }
+  }
+};
+
+} /* namespace pico */
+
+#endif /* INTERNALS_KEYEDREDUCER_HPP_ */
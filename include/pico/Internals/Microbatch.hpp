@@ -29,6 +29,9 @@
 #include "Token.hpp"
 
 #include "pico/ff_implementation/ff_config.hpp"
+#ifdef PICO_NUMA
+#include "pico/ff_implementation/numa.hpp"
+#endif
 
 namespace pico {
 
@@ -66,9 +69,17 @@ class base_microbatch {
 
   inline char *payload() const { return chunk; }
 
+#ifdef PICO_NUMA
+  /* the NUMA node the micro-batch was produced on */
+  inline int numa_node() const { return numa_node_; }
+#endif
+
  protected:
   tag_t tag_;
   char *chunk;
+#ifdef PICO_NUMA
+  int numa_node_ = numa::this_node();
+#endif
 };
 
 /**
@@ -170,10 +181,27 @@ class Microbatch : public base_microbatch {
     return (TokenType *)(((char *)(data_slot)) - desc_size);
   }
 
+  /**
+   * Return the number of slots fitting a memory budget (at least one).
+   */
+  static unsigned slots_for(size_t bytes) {
+    return bytes > slot_size ? (unsigned)(bytes / slot_size) : 1;
+  }
+
   inline bool full() const { return allocated == slots; }
 
   inline bool empty() const { return allocated == 0; }
 
+  inline unsigned size() const { return committed; }
+
+  /*
+   * Returns the i-th committed item.
+   */
+  inline DataType &at(unsigned i) {
+    assert(i < committed);
+    return *(DataType *)(chunk + i * slot_size + desc_size);
+  }
+
   /*
    * Microbatch iterator over committed items.
    */
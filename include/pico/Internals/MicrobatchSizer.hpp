@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_MICROBATCHSIZER_HPP_
+#define INTERNALS_MICROBATCHSIZER_HPP_
+
+#include <algorithm>
+#include <chrono>
+
+#include "pico/defines/Global.hpp"
+
+namespace pico {
+
+/*
+ * Resolves a per-operator microbatch size, zero standing for the global one.
+ */
+static inline unsigned microbatch_size(unsigned mb_size) {
+  return mb_size ? mb_size : global_params.MICROBATCH_SIZE;
+}
+
+/*
+ * Decides the size of the microbatches produced by an emitter.
+ *
+ * A non-zero size given at construction (i.e., a per-operator setting) is
+ * kept fixed. Otherwise, with the FIXED policy the size is the global
+ * MICROBATCH_SIZE, while with an adaptive policy the emitter routes each
+ * outgoing microbatch through send(), so that the sizer can observe:
+ * - the per-item service time, i.e. the time spent filling microbatches
+ *   divided by the number of produced items
+ * - the output-queue occupancy, approximated by the fraction of time spent
+ *   blocked in sending (i.e., waiting for room in full queues)
+ *
+ * Observations are aggregated over short windows, at the end of which
+ * the size is adjusted towards the target:
+ * - LATENCY: the size is such that filling a microbatch (plus the observed
+ *   queueing) fits the latency budget
+ * - THROUGHPUT: the size is doubled while the observed rate is below the
+ *   target and growing keeps paying off, and shrunk when the target is
+ *   comfortably exceeded
+ *
+ * The fanout is the number of microbatches filled concurrently (e.g., one per
+ * destination in a by-key emitter), each one filling fanout times slower.
+ */
+class MicrobatchSizer {
+  typedef std::chrono::steady_clock clock;
+
+ public:
+  MicrobatchSizer(unsigned mb_size = 0, unsigned fanout_ = 1)
+      : target(mb_size ? mb_target() : global_params.MICROBATCH_TARGET),
+        fanout(fanout_),
+        size_(microbatch_size(mb_size)) {
+    if (adaptive()) clamp();
+  }
+
+  /*
+   * the size (in items) for the next microbatch
+   */
+  inline unsigned size() const { return size_; }
+
+  inline bool adaptive() const { return target.policy != mb_target::FIXED; }
+
+  /*
+   * sends out a microbatch of the given number of items by calling send_f
+   */
+  template <typename F>
+  inline void send(unsigned items, F &&send_f) {
+    if (!adaptive()) {
+      send_f();
+      return;
+    }
+
+    auto t0 = clock::now();
+    send_f();
+    auto t1 = clock::now();
+
+    if (started) {
+      w_fill += t0 - last;
+      w_block += t1 - t0;
+      w_items += items;
+      ++w_batches;
+      if (w_batches >= min_window_batches && w_fill + w_block >= window)
+        adapt();
+    }
+    started = true;
+    last = t1;
+  }
+
+ private:
+  const mb_target target;
+  const unsigned fanout;
+  unsigned size_;
+
+  /* observation window */
+  static constexpr unsigned min_window_batches = 4;
+  const std::chrono::duration<double> window{0.001};
+  bool started = false;
+  clock::time_point last;
+  std::chrono::duration<double> w_fill{0}, w_block{0};
+  unsigned long long w_items = 0, w_batches = 0;
+
+  /* throughput hill-climbing state */
+  double prev_rate = 0;
+  bool grown = false;
+  unsigned hold = 0;
+
+  void adapt() {
+    double fill = w_fill.count(), block = w_block.count();
+    double elapsed = fill + block;
+    double per_item = fill / w_items;
+    double occupancy = block / elapsed;
+
+    if (target.policy == mb_target::LATENCY) {
+      /* batching delay = fanout * size * per_item, plus queueing */
+      double budget = target.value * (1 - occupancy);
+      double ideal = global_params.MICROBATCH_MAX;
+      if (per_item > 0) ideal = std::max(budget / (fanout * per_item), 1.0);
+      size_ = (unsigned)((size_ + std::min(ideal, (double)size_ * 4)) / 2);
+    } else {
+      double rate = w_items / elapsed;
+      if (hold)
+        --hold;
+      else if (rate < target.value) {
+        if (grown && rate < prev_rate * 1.05) {
+          /* growing did not pay off */
+          size_ /= 2;
+          grown = false;
+          hold = 16;
+        } else {
+          size_ *= 2;
+          grown = true;
+        }
+      } else {
+        if (rate > target.value * 1.25) size_ -= size_ / 4;
+        grown = false;
+      }
+      prev_rate = rate;
+    }
+    clamp();
+
+    w_fill = w_block = std::chrono::duration<double>(0);
+    w_items = w_batches = 0;
+  }
+
+  void clamp() {
+    size_ = std::max<unsigned>(size_, global_params.MICROBATCH_MIN);
+    size_ = std::min<unsigned>(size_, global_params.MICROBATCH_MAX);
+    size_ = std::max<unsigned>(size_, 1);
+  }
+};
+
+} /* namespace pico */
+
+#endif /* INTERNALS_MICROBATCHSIZER_HPP_ */
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_SKEWPARTITIONER_HPP_
+#define INTERNALS_SKEWPARTITIONER_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "FlatHashMap.hpp"
+
+/*
+ * One routed key out of SKEW_SAMPLE_RATE is sampled for estimating key
+ * frequencies.
+ */
+#define SKEW_SAMPLE_RATE 16
+
+/*
+ * Number of (most frequent) keys tracked by the frequency sketch.
+ */
+#define SKEW_SKETCH_KEYS 32
+
+/*
+ * Number of samples to be taken before detecting hot keys.
+ */
+#define SKEW_MIN_SAMPLES 1024
+
+/*
+ * A key is hot if it takes more than 1/SKEW_HOT_SHARE of the fair share of a
+ * worker (i.e., of 1/n of the traffic).
+ */
+#define SKEW_HOT_SHARE 4
+
+namespace pico {
+
+/*
+ * The hot keys of a shuffle, shared by the senders (that split hot keys
+ * across workers) and by the merging end of the shuffle (that merges the
+ * partial results of split keys).
+ *
+ * Keys are only inserted, and rarely, so that readers keep a local copy and
+ * refresh it only when the set has grown.
+ */
+template <typename K>
+class hot_key_set {
+ public:
+  void insert(const K &k) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (keys.insert(k).second) size_.store(keys.size());
+  }
+
+  inline size_t size() const { return size_.load(); }
+
+  /* refreshes a local copy of the set */
+  void refresh(std::unordered_set<K> &copy) const {
+    if (copy.size() == size()) return;
+    std::lock_guard<std::mutex> lock(mtx);
+    copy = keys;
+  }
+
+ private:
+  mutable std::mutex mtx;
+  std::unordered_set<K> keys;
+  std::atomic<size_t> size_{0};
+};
+
+/*
+ * Skew-aware key partitioning over n workers.
+ *
+ * Cold keys go to their home worker, given by plain hashing.
+ * Key frequencies are estimated online, by a Space-Saving sketch over a
+ * sample of the routed keys. A key whose share of the traffic exceeds a
+ * fraction of the fair share of a worker (see SKEW_HOT_SHARE) is hot, and it
+ * is spread round-robin over a group of consecutive workers, starting from
+ * its home, large enough for each of them to get about that fraction.
+ *
+ * Since the values of a hot key end up on several workers, splitting is only
+ * correct when partial results are merged afterwards (e.g., for associative
+ * and commutative reductions). Hot keys are published into a shared
+ * hot_key_set for the merging end to know them.
+ */
+template <typename K, typename Hash = std::hash<K>>
+class skew_partitioner {
+ public:
+  skew_partitioner(unsigned n_,
+                   std::shared_ptr<hot_key_set<K>> published_ = nullptr)
+      : n(n_), load_(n_, 0), published(published_) {}
+
+  /*
+   * returns the worker for the given key
+   */
+  inline unsigned operator()(const K &k) {
+    unsigned dst = n > 1 ? hasher(k) % n : 0;
+    if (n > 1) {
+      if (!hot.empty()) {
+        auto h = hot.find(k);
+        if (h) dst = (dst + h->next++ % h->split) % n;
+      }
+      if (!--countdown) {
+        countdown = SKEW_SAMPLE_RATE;
+        sample(k);
+      }
+    }
+    ++load_[dst];
+    return dst;
+  }
+
+  /* the number of keys routed to each worker */
+  const std::vector<unsigned long long> &load() const { return load_; }
+
+  size_t hot_keys() const { return hot.size(); }
+
+ private:
+  struct hot_state {
+    unsigned split, next;
+  };
+
+  struct counter {
+    K key;
+    unsigned long long count;
+  };
+
+  const unsigned n;
+  std::vector<unsigned long long> load_;
+  std::shared_ptr<hot_key_set<K>> published;
+  Hash hasher;
+  flat_hash_map<K, hot_state, Hash> hot;
+  std::vector<counter> sketch;
+  unsigned long long samples = 0;
+  unsigned countdown = SKEW_SAMPLE_RATE;
+
+  /*
+   * Space-Saving: a tracked key is counted, while an untracked one replaces
+   * the least frequent tracked key, inheriting (and increasing) its count.
+   */
+  void sample(const K &k) {
+    ++samples;
+    for (auto &c : sketch)
+      if (c.key == k) {
+        check(c.key, ++c.count);
+        return;
+      }
+    if (sketch.size() < SKEW_SKETCH_KEYS) {
+      sketch.push_back(counter{k, 1});
+      check(k, 1);
+      return;
+    }
+    auto min = std::min_element(
+        sketch.begin(), sketch.end(),
+        [](const counter &a, const counter &b) { return a.count < b.count; });
+    min->key = k;
+    check(k, ++min->count);
+  }
+
+  void check(const K &k, unsigned long long count) {
+    unsigned long long scaled = SKEW_HOT_SHARE * n * count;
+    if (samples < SKEW_MIN_SAMPLES || scaled <= samples) return;
+    /* each worker of the group gets about a fraction of the fair share */
+    unsigned split =
+        std::min<unsigned long long>(n, (scaled + samples - 1) / samples);
+    auto h = hot.find(k);
+    if (h) {
+      h->split = std::max(h->split, split);
+      return;
+    }
+    hot.insert(k, hot_state{split, 0});
+    if (published) published->insert(k);
+  }
+};
+
+} /* namespace pico */
+
+#endif /* INTERNALS_SKEWPARTITIONER_HPP_ */
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_SPILLFILE_HPP_
+#define INTERNALS_SPILLFILE_HPP_
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <type_traits>
+
+/*
+ * Size of the stdio buffers of spill files.
+ */
+#define SPILL_BUFFER_SIZE (1 << 20)
+
+namespace pico {
+
+/*
+ * A temporary file holding a spilled run, written once and then read back
+ * sequentially.
+ *
+ * Files are created in the directory named by the PICO_SPILL_DIR environment
+ * variable (or TMPDIR, or /tmp) and unlinked right away, so that they are
+ * removed when closed, even upon abnormal termination.
+ */
+class spill_file {
+ public:
+  spill_file() {
+    std::string path = spill_dir() + "/pico-spill-XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0 || !(f = fdopen(fd, "w+b"))) {
+      fprintf(stderr, "Unable to create spill file in %s\n",
+              spill_dir().c_str());
+      exit(1);
+    }
+    unlink(path.c_str());
+    setvbuf(f, nullptr, _IOFBF, SPILL_BUFFER_SIZE);
+  }
+
+  spill_file(const spill_file &) = delete;
+  spill_file &operator=(const spill_file &) = delete;
+
+  ~spill_file() { fclose(f); }
+
+  void write(const void *p, size_t len) {
+    if (fwrite(p, 1, len, f) != len) {
+      fprintf(stderr, "Unable to write spill file\n");
+      exit(1);
+    }
+    written += len;
+  }
+
+  /* reads exactly len bytes, returns false at end of file */
+  bool read(void *p, size_t len) { return fread(p, 1, len, f) == len; }
+
+  /* switches from writing to reading from the beginning */
+  void rewind() {
+    if (fflush(f)) {
+      fprintf(stderr, "Unable to write spill file\n");
+      exit(1);
+    }
+    ::rewind(f);
+  }
+
+  /* the number of written bytes */
+  size_t size() const { return written; }
+
+ private:
+  FILE *f = nullptr;
+  size_t written = 0;
+
+  static std::string spill_dir() {
+    auto dir = std::getenv("PICO_SPILL_DIR");
+    if (!dir) dir = std::getenv("TMPDIR");
+    return dir ? dir : "/tmp";
+  }
+};
+
+/*
+ * Encodes values of type T into spill files.
+ *
+ * Trivially-copyable types are stored by their bytes and strings by their
+ * length followed by their characters; other types cannot be spilled.
+ * bytes() estimates the memory taken by a value.
+ */
+template <typename T, typename = void>
+struct spill_codec {
+  static constexpr bool enabled = false;
+  static size_t bytes(const T &) { return sizeof(T); }
+};
+
+template <typename T>
+struct spill_codec<T, typename std::enable_if<
+                          std::is_trivially_copyable<T>::value>::type> {
+  static constexpr bool enabled = true;
+  static size_t bytes(const T &) { return sizeof(T); }
+  static void write(spill_file &f, const T &x) { f.write(&x, sizeof(T)); }
+  static bool read(spill_file &f, T &x) { return f.read(&x, sizeof(T)); }
+};
+
+template <>
+struct spill_codec<std::string> {
+  static constexpr bool enabled = true;
+  static size_t bytes(const std::string &s) {
+    return sizeof(std::string) + s.capacity();
+  }
+  static void write(spill_file &f, const std::string &s) {
+    uint64_t len = s.size();
+    f.write(&len, sizeof(len));
+    f.write(s.data(), len);
+  }
+  static bool read(spill_file &f, std::string &s) {
+    uint64_t len;
+    if (!f.read(&len, sizeof(len))) return false;
+    s.resize(len);
+    return !len || f.read(&s[0], len);
+  }
+};
+
+} /* namespace pico */
+
+#endif /* INTERNALS_SPILLFILE_HPP_ */
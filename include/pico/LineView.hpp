@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINEVIEW_HPP_
+#define LINEVIEW_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "pico/ff_implementation/ff_config.hpp"
+
+namespace pico {
+
+/*
+ * A reference-counted block of input bytes, shared by the lines it contains.
+ * The block is freed when the last reference is dropped.
+ *
+ * A block either owns its bytes (allocated right after the block header) or
+ * wraps external memory (e.g., a file mapping), that is released by a
+ * user-provided function.
+ */
+class line_block {
+ public:
+  typedef void (*release_t)(line_block *);
+
+  static line_block *make(size_t capacity) {
+    void *p = MALLOC(sizeof(line_block) + capacity);
+    auto res = new (p) line_block(nullptr, capacity, nullptr);
+    res->data_ = reinterpret_cast<char *>(res + 1);
+    return res;
+  }
+
+  static line_block *wrap(char *data__, size_t size, release_t release_f) {
+    void *p = MALLOC(sizeof(line_block));
+    return new (p) line_block(data__, size, release_f);
+  }
+
+  inline char *data() { return data_; }
+
+  inline size_t capacity() const { return capacity_; }
+
+  inline void ref() { refs.fetch_add(1, std::memory_order_relaxed); }
+
+  inline void unref() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      if (release) release(this);
+      this->~line_block();
+      FREE(this);
+    }
+  }
+
+ private:
+  line_block(char *data__, size_t capacity__, release_t release_)
+      : refs(1), data_(data__), capacity_(capacity__), release(release_) {}
+
+  std::atomic<unsigned> refs;
+  char *data_;
+  size_t capacity_;
+  release_t release;
+};
+
+/**
+ * \ingroup op-api
+ *
+ * A read-only line of text, pointing into a shared input block.
+ *
+ * A LineView behaves like a std::string_view, but it keeps its block alive:
+ * reading lines as views costs neither allocations nor copies, and input
+ * blocks are freed once no line refers to them anymore.
+ */
+class LineView {
+ public:
+  typedef const char *const_iterator;
+  static constexpr size_t npos = std::string::npos;
+
+  LineView() : blk(nullptr), ptr(""), len(0) {}
+
+  LineView(line_block *blk_, const char *ptr_, size_t len_)
+      : blk(blk_), ptr(ptr_), len(len_) {
+    if (blk) blk->ref();
+  }
+
+  LineView(const LineView &lv) : blk(lv.blk), ptr(lv.ptr), len(lv.len) {
+    if (blk) blk->ref();
+  }
+
+  LineView(LineView &&lv) : blk(lv.blk), ptr(lv.ptr), len(lv.len) {
+    lv.blk = nullptr;
+  }
+
+  LineView &operator=(const LineView &lv) {
+    if (lv.blk) lv.blk->ref();
+    if (blk) blk->unref();
+    blk = lv.blk;
+    ptr = lv.ptr;
+    len = lv.len;
+    return *this;
+  }
+
+  LineView &operator=(LineView &&lv) {
+    std::swap(blk, lv.blk);
+    ptr = lv.ptr;
+    len = lv.len;
+    return *this;
+  }
+
+  ~LineView() {
+    if (blk) blk->unref();
+  }
+
+  /**
+   * string_view-like interface
+   */
+  const char *data() const { return ptr; }
+
+  size_t size() const { return len; }
+
+  size_t length() const { return len; }
+
+  bool empty() const { return len == 0; }
+
+  char operator[](size_t i) const { return ptr[i]; }
+
+  const_iterator begin() const { return ptr; }
+
+  const_iterator end() const { return ptr + len; }
+
+  size_t find(char c, size_t pos = 0) const {
+    if (pos >= len) return npos;
+    auto p = (const char *)memchr(ptr + pos, c, len - pos);
+    return p ? p - ptr : npos;
+  }
+
+  size_t find_first_of(char c, size_t pos = 0) const { return find(c, pos); }
+
+  /* the returned view shares the block */
+  LineView substr(size_t pos, size_t n = npos) const {
+    if (pos > len) pos = len;
+    return LineView(blk, ptr + pos, std::min(n, len - pos));
+  }
+
+  std::string_view view() const { return std::string_view(ptr, len); }
+
+  std::string str() const { return std::string(ptr, len); }
+
+  std::string to_string() const { return str(); }
+
+  bool operator==(const LineView &lv) const { return view() == lv.view(); }
+
+  bool operator!=(const LineView &lv) const { return !(*this == lv); }
+
+  friend bool operator<(const LineView &l, const LineView &r) {
+    return l.view() < r.view();
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, const LineView &lv) {
+    return os.write(lv.ptr, lv.len);
+  }
+
+ private:
+  line_block *blk;
+  const char *ptr;
+  size_t len;
+};
+
+} /* namespace pico */
+
+namespace std {
+template <>
+struct hash<::pico::LineView> {
+  size_t operator()(const ::pico::LineView &lv) const {
+    return hash<string_view>{}(lv.view());
+  }
+};
+} /* namespace std */
+
+#endif /* LINEVIEW_HPP_ */
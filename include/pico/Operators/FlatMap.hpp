@@ -85,11 +85,15 @@ class FlatMapBase : public UnaryOperator<In, Out> {
     // todo assert unique stype
     if (st == StructureType::STREAM) {
       using impl_t = FMapBatchStream<In, Out, Token<In>, Token<Out>>;
-      return new impl_t(parallelism, flatmapf);
+      return new impl_t(parallelism, flatmapf, mb_size());
     }
     assert(st == StructureType::BAG);
     using impl_t = FMapBatchBag<In, Out, Token<In>, Token<Out>>;
-    return new impl_t(parallelism, flatmapf);
+    return new impl_t(parallelism, flatmapf, mb_size());
+  }
+
+  unsigned mb_size() const {
+    return this->template microbatch_slots<Token<Out>>();
   }
 
   std::function<void(In &, FlatMapCollector<Out> &)> flatmapf;
@@ -100,7 +104,8 @@ class FlatMapBase : public UnaryOperator<In, Out> {
  */
 
 template <typename In, typename Out>
-class FlatMap : public FlatMapBase<In, Out> {
+class FlatMap : public FlatMapBase<In, Out>,
+                public MicrobatchSizing<FlatMap<In, Out>> {
  public:
   /**
    * \ingroup op-api
@@ -125,7 +130,9 @@ class FlatMap : public FlatMapBase<In, Out> {
  */
 
 template <typename In, typename K, typename V>
-class FlatMap<In, KeyValue<K, V>> : public FlatMapBase<In, KeyValue<K, V>> {
+class FlatMap<In, KeyValue<K, V>>
+    : public FlatMapBase<In, KeyValue<K, V>>,
+      public MicrobatchSizing<FlatMap<In, KeyValue<K, V>>> {
  public:
   /**
    * \ingroup op-api
@@ -151,7 +158,9 @@ class FlatMap<In, KeyValue<K, V>> : public FlatMapBase<In, KeyValue<K, V>> {
     assert(st == StructureType::BAG);
     auto nextop = dynamic_cast<ReduceByKey<KeyValue<K, V>> *>(a.op);
     return FMapPReduceBatch<Token<In>, Token<KeyValue<K, V>>>(
-        par, this->flatmapf, nextop->pardeg(), nextop->kernel());
+        par, this->flatmapf, nextop->pardeg(), nextop->kernel(),  //
+        this->mb_size(), nextop->mb_size(), nextop->cardinality(),
+        nextop->combiner_entries(), nextop->keyed_state());
   }
 };
 
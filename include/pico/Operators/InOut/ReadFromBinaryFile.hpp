@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPERATORS_INOUT_READFROMBINARYFILE_HPP_
+#define OPERATORS_INOUT_READFROMBINARYFILE_HPP_
+
+#include <sstream>
+#include <string>
+
+#include "pico/ff_implementation/OperatorsFFNodes/InOut/ReadFromBinaryFileFFNode.hpp"
+
+#include "InputOperator.hpp"
+
+namespace pico {
+
+/**
+ * Defines an operator that reads fixed-size binary records (e.g., written by
+ * WriteToBinaryFile) and produces an unordered bounded collection.
+ *
+ * Records are either trivially-copyable values or key-value pairs with
+ * trivially-copyable keys and values. They are copied from a mapping of the
+ * file straight into microbatches, with no parsing.
+ *
+ * The operator is global and unique for the Pipe it refers to.
+ */
+template <typename T>
+class ReadFromBinaryFile : public InputOperator<T>,
+                           public MicrobatchSizing<ReadFromBinaryFile<T>> {
+ public:
+  /**
+   * \ingroup op-api
+   *
+   * ReadFromBinaryFile Constructor
+   *
+   * Creates a new ReadFromBinaryFile operator,
+   * yielding an unordered bounded collection.
+   */
+  ReadFromBinaryFile(std::string fname_, unsigned par = def_par())
+      : InputOperator<T>(StructureType::BAG), fname(fname_) {
+    this->pardeg(par);
+  }
+
+  /**
+   * Copy constructor.
+   */
+  ReadFromBinaryFile(const ReadFromBinaryFile &copy)
+      : InputOperator<T>(copy), fname(copy.fname) {}
+
+  /**
+   * Returns a unique name for the operator.
+   */
+  std::string name() {
+    std::string name("ReadFromBinaryFile");
+    std::ostringstream address;
+    address << (void const *)this;
+    return name + address.str().erase(0, 2);
+  }
+
+  /**
+   * Returns the name of the operator, consisting in the name of the class.
+   */
+  std::string name_short() { return "ReadFromBinaryFile\n[" + fname + "]"; }
+
+ protected:
+  ReadFromBinaryFile *clone() { return new ReadFromBinaryFile(*this); }
+
+  ff::ff_node *node_operator(int parallelism, StructureType st) {
+    assert(st == StructureType::BAG);
+    auto mb_size = this->template microbatch_slots<Token<T>>();
+    return ReadFromBinaryFileFFNode<T>(parallelism, fname, mb_size);
+  }
+
+ private:
+  std::string fname;
+};
+
+} /* namespace pico */
+
+#endif /* OPERATORS_INOUT_READFROMBINARYFILE_HPP_ */
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPERATORS_INOUT_READFROMCOMPRESSEDFILE_HPP_
+#define OPERATORS_INOUT_READFROMCOMPRESSEDFILE_HPP_
+
+#include <sstream>
+#include <string>
+
+#include "pico/ff_implementation/OperatorsFFNodes/InOut/ReadFromCompressedFileFFNode.hpp"
+
+#include "InputOperator.hpp"
+
+namespace pico {
+
+/**
+ * Defines an operator that reads data from a block-compressed text file (e.g.,
+ * written by WriteToCompressedFile) and produces an unordered bounded
+ * collection.
+ *
+ * The file consists of independently compressed blocks of whole lines, listed
+ * by an index, so that blocks are decompressed and split into lines in
+ * parallel, with no decompressed copy of the file.
+ *
+ * As for ReadFromFile, lines are either std::string or LineView records.
+ *
+ * The operator is global and unique for the Pipe it refers to.
+ */
+template <typename Line = std::string>
+class ReadFromCompressedFile : public InputOperator<Line>,
+                               public MicrobatchSizing<ReadFromCompressedFile<Line>> {
+ public:
+  /**
+   * \ingroup op-api
+   *
+   * ReadFromCompressedFile Constructor
+   *
+   * Creates a new ReadFromCompressedFile operator,
+   * yielding an unordered bounded collection.
+   */
+  ReadFromCompressedFile(std::string fname_, unsigned par = def_par())
+      : InputOperator<Line>(StructureType::BAG), fname(fname_) {
+    this->pardeg(par);
+  }
+
+  /**
+   * Copy constructor.
+   */
+  ReadFromCompressedFile(const ReadFromCompressedFile &copy)
+      : InputOperator<Line>(copy), fname(copy.fname) {}
+
+  /**
+   * Returns a unique name for the operator.
+   */
+  std::string name() {
+    std::string name("ReadFromCompressedFile");
+    std::ostringstream address;
+    address << (void const *)this;
+    return name + address.str().erase(0, 2);
+  }
+
+  /**
+   * Returns the name of the operator, consisting in the name of the class.
+   */
+  std::string name_short() { return "ReadFromCompressedFile\n[" + fname + "]"; }
+
+ protected:
+  ReadFromCompressedFile *clone() { return new ReadFromCompressedFile(*this); }
+
+  ff::ff_node *node_operator(int parallelism, StructureType st) {
+    assert(st == StructureType::BAG);
+    auto mb_size = this->template microbatch_slots<Token<Line>>();
+    return ReadFromCompressedFileFFNode<Line>(parallelism, fname, mb_size);
+  }
+
+ private:
+  std::string fname;
+};
+
+} /* namespace pico */
+
+#endif /* OPERATORS_INOUT_READFROMCOMPRESSEDFILE_HPP_ */
@@ -40,12 +40,15 @@ namespace pico {
  * Defines an operator that reads data from a text file and produces an
  * Ordered+Bounded collection (i.e. LIST).
  *
- * The operator returns a std::string to the user containing a single line read.
+ * The operator returns a Line to the user containing a single line read,
+ * either as a std::string (default) or as a LineView pointing into a shared
+ * input block (i.e., with no per-line allocation or copy).
  *
  * The operator is global and unique for the Pipe it refers to.
  */
-
-class ReadFromFile : public InputOperator<std::string> {
+template <typename Line>
+class BasicReadFromFile : public InputOperator<Line>,
+                          public MicrobatchSizing<BasicReadFromFile<Line>> {
  public:
   /**
    * \ingroup op-api
@@ -55,16 +58,72 @@ class ReadFromFile : public InputOperator<std::string> {
    * Creates a new ReadFromFile operator,
    * yielding an unordered bounded collection.
    */
-  ReadFromFile(std::string fname_, unsigned par = def_par())
-      : InputOperator<std::string>(StructureType::BAG), fname(fname_) {
+  BasicReadFromFile(std::string fname_, unsigned par = def_par())
+      : InputOperator<Line>(StructureType::BAG), fname(fname_) {
     this->pardeg(par);
   }
 
   /**
    * Copy constructor.
    */
-  ReadFromFile(const ReadFromFile &copy)
-      : InputOperator<std::string>(copy), fname(copy.fname) {}
+  BasicReadFromFile(const BasicReadFromFile &copy)
+      : InputOperator<Line>(copy), fname(copy.fname), opts(copy.opts) {}
+
+  /**
+   * \ingroup op-api
+   * Reads the file through a memory mapping, rather than by buffered reads.
+   *
+   * Lines are scanned in place over the mapping, and LineView lines point
+   * directly into it, with no intermediate copy.
+   */
+  BasicReadFromFile mmap() const {
+    BasicReadFromFile res(*this);
+    res.opts.mapped = true;
+    return res;
+  }
+
+  /**
+   * \ingroup op-api
+   * Reads the file asynchronously, keeping depth reads of block_size bytes in
+   * flight for each file partition.
+   *
+   * Reads are performed by io_uring where available, or else by a pool of I/O
+   * threads, while lines are parsed from the completed blocks.
+   */
+  BasicReadFromFile async_io(unsigned depth = ASYNC_IO_DEPTH,
+                        size_t block_size = ASYNC_IO_BLOCK_SIZE) const {
+    BasicReadFromFile res(*this);
+    res.opts.aio_depth = depth;
+    res.opts.aio_block = block_size;
+    return res;
+  }
+
+  /**
+   * \ingroup op-api
+   * Bypasses the page cache (i.e., O_DIRECT) in asynchronous reading.
+   *
+   * Direct reads are silently turned into buffered ones if not supported by
+   * the file system.
+   */
+  BasicReadFromFile direct_io() const {
+    BasicReadFromFile res(*this);
+    if (!res.opts.aio_depth) res.opts.aio_depth = ASYNC_IO_DEPTH;
+    res.opts.direct = true;
+    return res;
+  }
+
+  /**
+   * \ingroup op-api
+   * Sets the size (in bytes) of the chunks parallel readers pull on demand.
+   *
+   * Smaller chunks balance the load better (e.g., over heterogeneous lines or
+   * partially cached files), at the cost of more scheduling.
+   */
+  BasicReadFromFile chunk_size(size_t bytes) const {
+    BasicReadFromFile res(*this);
+    res.opts.chunk_size = bytes;
+    return res;
+  }
 
   /**
    * Returns a unique name for the operator.
@@ -82,17 +141,25 @@ class ReadFromFile : public InputOperator<std::string> {
   std::string name_short() { return "ReadFromFile\n[" + fname + "]"; }
 
  protected:
-  ReadFromFile *clone() { return new ReadFromFile(*this); }
+  BasicReadFromFile *clone() { return new BasicReadFromFile(*this); }
 
   ff::ff_node *node_operator(int parallelism, StructureType st) {
     assert(st == StructureType::BAG);
-    return ReadFromFileFFNode(parallelism, fname);
+    auto mb_size = this->template microbatch_slots<Token<Line>>();
+    return ReadFromFileFFNode<Line>(parallelism, fname, mb_size, opts);
   }
 
  private:
   std::string fname;
+  file_read_opts opts;
 };
 
+/**
+ * \ingroup op-api
+ * ReadFromFile producing std::string lines (see BasicReadFromFile<LineView>).
+ */
+typedef BasicReadFromFile<std::string> ReadFromFile;
+
 } /* namespace pico */
 
 #endif /* OPERATORS_INOUT_READFROMFILE_HPP_ */
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPERATORS_INOUT_READFROMFILES_HPP_
+#define OPERATORS_INOUT_READFROMFILES_HPP_
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "pico/ff_implementation/OperatorsFFNodes/InOut/ReadFromFilesFFNode.hpp"
+
+#include "InputOperator.hpp"
+
+namespace pico {
+
+/**
+ * Defines an operator that reads data from many text files and produces a
+ * single unordered bounded collection.
+ *
+ * Each input is either a file name, a directory (standing for all its
+ * files, except hidden ones) or a glob pattern (e.g., "data/part-*").
+ * Small files and line-aligned ranges of large files are read in parallel as
+ * a single pool of work units.
+ *
+ * The operator returns a Line to the user containing a single line read,
+ * either as a std::string (default) or as a LineView.
+ *
+ * The operator is global and unique for the Pipe it refers to.
+ */
+template <typename Line = std::string>
+class ReadFromFiles : public InputOperator<Line>,
+                      public MicrobatchSizing<ReadFromFiles<Line>> {
+ public:
+  /**
+   * \ingroup op-api
+   *
+   * ReadFromFiles Constructor
+   *
+   * Creates a new ReadFromFiles operator over a list of inputs,
+   * yielding an unordered bounded collection.
+   */
+  ReadFromFiles(std::vector<std::string> inputs_, unsigned par = def_par())
+      : InputOperator<Line>(StructureType::BAG), inputs(inputs_) {
+    this->pardeg(par);
+  }
+
+  /**
+   * \ingroup op-api
+   *
+   * ReadFromFiles Constructor
+   *
+   * Creates a new ReadFromFiles operator over a single input (e.g., a
+   * directory or a glob pattern).
+   */
+  ReadFromFiles(std::string input, unsigned par = def_par())
+      : ReadFromFiles(std::vector<std::string>{input}, par) {}
+
+  /**
+   * Copy constructor.
+   */
+  ReadFromFiles(const ReadFromFiles &copy)
+      : InputOperator<Line>(copy), inputs(copy.inputs) {}
+
+  /**
+   * Returns a unique name for the operator.
+   */
+  std::string name() {
+    std::string name("ReadFromFiles");
+    std::ostringstream address;
+    address << (void const *)this;
+    return name + address.str().erase(0, 2);
+  }
+
+  /**
+   * Returns the name of the operator, consisting in the name of the class.
+   */
+  std::string name_short() {
+    std::string res("ReadFromFiles\n[");
+    for (auto &in : inputs) res += (&in == &inputs[0] ? "" : " ") + in;
+    return res + "]";
+  }
+
+ protected:
+  ReadFromFiles *clone() { return new ReadFromFiles(*this); }
+
+  ff::ff_node *node_operator(int parallelism, StructureType st) {
+    assert(st == StructureType::BAG);
+    auto mb_size = this->template microbatch_slots<Token<Line>>();
+    return new ReadFromFilesFFNode<Line>(parallelism, inputs, mb_size);
+  }
+
+ private:
+  std::vector<std::string> inputs;
+};
+
+} /* namespace pico */
+
+#endif /* OPERATORS_INOUT_READFROMFILES_HPP_ */
@@ -40,10 +40,12 @@ namespace pico {
  * Defines an operator that reads a data stream from a socket,
  * yielding an ordered unbounded collection.
  *
- * The user specifies a delimiter to identify stream items.
+ * The user specifies a delimiter to identify stream items, that are passed
+ * as a Line (either a std::string or a LineView).
  */
-
-class ReadFromSocket : public InputOperator<std::string> {
+template <typename Line>
+class BasicReadFromSocket : public InputOperator<Line>,
+                            public MicrobatchSizing<BasicReadFromSocket<Line>> {
  public:
   /**
    * \ingroup op-api
@@ -52,8 +54,8 @@ class ReadFromSocket : public InputOperator<std::string> {
    * Creates a new ReadFromSocket operator by defining its kernel function,
    * operating on each token of the stream, delimited by the delimiter value.
    */
-  ReadFromSocket(std::string server_, int port_, char delimiter_)
-      : InputOperator<std::string>(StructureType::STREAM) {
+  BasicReadFromSocket(std::string server_, int port_, char delimiter_)
+      : InputOperator<Line>(StructureType::STREAM) {
     server_name = server_;
     port = port_;
     delimiter = delimiter_;
@@ -62,11 +64,35 @@ class ReadFromSocket : public InputOperator<std::string> {
   /**
    * Copy constructor.
    */
-  ReadFromSocket(const ReadFromSocket &copy)
-      : InputOperator<std::string>(copy) {
+  BasicReadFromSocket(const BasicReadFromSocket &copy)
+      : InputOperator<Line>(copy) {
     server_name = copy.server_name;
     port = copy.port;
     delimiter = copy.delimiter;
+    buffer_size = copy.buffer_size;
+    rcvbuf = copy.rcvbuf;
+  }
+
+  /**
+   * \ingroup op-api
+   * Sets the size (in bytes) of the blocks the stream is received into.
+   * Lines are split in place, so a block must be larger than most lines.
+   */
+  BasicReadFromSocket receive_buffer(size_t bytes) const {
+    BasicReadFromSocket res(*this);
+    res.buffer_size = bytes;
+    return res;
+  }
+
+  /**
+   * \ingroup op-api
+   * Sets the size (in bytes) of the kernel receive buffer (i.e., SO_RCVBUF)
+   * of the socket, for sustaining high-bandwidth links.
+   */
+  BasicReadFromSocket socket_rcvbuf(int bytes) const {
+    BasicReadFromSocket res(*this);
+    res.rcvbuf = bytes;
+    return res;
   }
 
   /**
@@ -85,21 +111,33 @@ class ReadFromSocket : public InputOperator<std::string> {
   std::string name_short() { return "ReadFromSocket\n[" + server_name + "]"; }
 
  protected:
-  ReadFromSocket *clone() { return new ReadFromSocket(*this); }
+  BasicReadFromSocket *clone() { return new BasicReadFromSocket(*this); }
 
   const OpClass operator_class() { return OpClass::INPUT; }
 
   ff::ff_node *node_operator(int parallelism, StructureType st) {
     assert(st == StructureType::STREAM);
-    return new ReadFromSocketFFNode(server_name, port, delimiter);
+    using node_t = ReadFromSocketFFNode<Token<Line>>;
+    return new node_t(server_name, port, delimiter,
+                      this->template microbatch_slots<Token<Line>>(),
+                      buffer_size, rcvbuf);
   }
 
  private:
   std::string server_name;
   int port;
   char delimiter;
+  size_t buffer_size = SOCKET_BUFFER_SIZE;
+  int rcvbuf = 0;  // system default
 };
 
+/**
+ * \ingroup op-api
+ * ReadFromSocket producing std::string lines
+ * (see BasicReadFromSocket<LineView>).
+ */
+typedef BasicReadFromSocket<std::string> ReadFromSocket;
+
 } /* namespace pico */
 
 #endif /* OPERATORS_INOUT_READFROMSOCKET_HPP_ */
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPERATORS_INOUT_READFROMSOCKETS_HPP_
+#define OPERATORS_INOUT_READFROMSOCKETS_HPP_
+
+#include <sstream>
+#include <string>
+
+#include "pico/ff_implementation/OperatorsFFNodes/InOut/ReadFromSocketsFFNode.hpp"
+
+#include "InputOperator.hpp"
+
+namespace pico {
+
+/**
+ * Defines an operator that reads data streams from many connections,
+ * yielding an unbounded collection.
+ *
+ * Connections are either accepted on a listening port or established towards
+ * a list of endpoints. They are multiplexed (by epoll) over a pool of reader
+ * threads, as many as the parallelism degree of the operator, each one
+ * splitting its connections by the delimiter into Lines (either std::string or
+ * LineView). Lines of the same connection are emitted in order, while lines of
+ * different connections are interleaved.
+ *
+ * The collection ends when all the connections have been closed by the peers.
+ */
+template <typename Line = std::string>
+class ReadFromSockets : public InputOperator<Line>,
+                        public MicrobatchSizing<ReadFromSockets<Line>> {
+ public:
+  /**
+   * \ingroup op-api
+   * ReadFromSockets Constructor
+   *
+   * Creates a new ReadFromSockets operator, accepting the given number of
+   * connections on a port.
+   */
+  ReadFromSockets(int port_, unsigned connections_, char delimiter_,
+                  unsigned par = def_par())
+      : InputOperator<Line>(StructureType::STREAM),
+        port(port_),
+        connections(connections_),
+        delimiter(delimiter_) {
+    this->pardeg(par);
+  }
+
+  /**
+   * \ingroup op-api
+   * ReadFromSockets Constructor
+   *
+   * Creates a new ReadFromSockets operator, connecting to each (server, port)
+   * endpoint.
+   */
+  ReadFromSockets(socket_endpoints endpoints_, char delimiter_,
+                  unsigned par = def_par())
+      : InputOperator<Line>(StructureType::STREAM),
+        endpoints(endpoints_),
+        delimiter(delimiter_) {
+    this->pardeg(par);
+  }
+
+  /**
+   * Copy constructor.
+   */
+  ReadFromSockets(const ReadFromSockets &copy)
+      : InputOperator<Line>(copy),
+        endpoints(copy.endpoints),
+        port(copy.port),
+        connections(copy.connections),
+        delimiter(copy.delimiter),
+        buffer_size(copy.buffer_size) {}
+
+  /**
+   * \ingroup op-api
+   * Sets the size (in bytes) of the blocks each connection is received into.
+   */
+  ReadFromSockets receive_buffer(size_t bytes) const {
+    ReadFromSockets res(*this);
+    res.buffer_size = bytes;
+    return res;
+  }
+
+  /**
+   * Returns a unique name for the operator.
+   */
+  std::string name() {
+    std::string name("ReadFromSockets");
+    std::ostringstream address;
+    address << (void const *)this;
+    return name + address.str().erase(0, 2);
+  }
+
+  /**
+   * Returns the name of the operator, consisting in the name of the class.
+   */
+  std::string name_short() {
+    if (endpoints.empty())
+      return "ReadFromSockets\n[:" + std::to_string(port) + "]";
+    return "ReadFromSockets\n[" + std::to_string(endpoints.size()) +
+           " endpoints]";
+  }
+
+ protected:
+  ReadFromSockets *clone() { return new ReadFromSockets(*this); }
+
+  const OpClass operator_class() { return OpClass::INPUT; }
+
+  ff::ff_node *node_operator(int parallelism, StructureType st) {
+    assert(st == StructureType::STREAM);
+    using node_t = ReadFromSocketsFFNode<Token<Line>>;
+    auto mb_size = this->template microbatch_slots<Token<Line>>();
+    if (endpoints.empty())
+      return new node_t(port, connections, delimiter, parallelism, mb_size,
+                        buffer_size);
+    return new node_t(endpoints, delimiter, parallelism, mb_size, buffer_size);
+  }
+
+ private:
+  socket_endpoints endpoints;
+  int port = 0;
+  unsigned connections = 0;
+  char delimiter;
+  size_t buffer_size = LINE_BLOCK_SIZE;
+};
+
+} /* namespace pico */
+
+#endif /* OPERATORS_INOUT_READFROMSOCKETS_HPP_ */
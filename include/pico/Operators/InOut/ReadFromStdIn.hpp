@@ -40,35 +40,56 @@ namespace pico {
  * Defines an operator that reads data from a socket and produces a Stream.
  *
  * The user specifies the kernel function that operates on each item of the
- * stream, passed as a std::string. The delimiter is used to separate single
- * items of the stream. The kernel can be a lambda function, a functor or a
+ * stream, passed as a Line (either a std::string or a LineView pointing into
+ * a shared input block). The delimiter is used to separate single items of
+ * the stream. The kernel can be a lambda function, a functor or a
  * function.
  *
  *
+ * The operator is sequential by default. With a higher parallelism degree,
+ * large blocks are read from the standard input descriptor (i.e., redirections
+ * of std::cin are not honoured) and split into lines by parallel workers,
+ * keeping the input order unless the operator is unordered().
+ *
  * The operator is global and unique for the Pipe it refers to.
  */
-
-class ReadFromStdIn : public InputOperator<std::string> {
+template <typename Line>
+class BasicReadFromStdIn : public InputOperator<Line>,
+                           public MicrobatchSizing<BasicReadFromStdIn<Line>> {
  public:
   /**
    * \ingroup op-api
-   * ReadFromSocket Constructor
+   * ReadFromStdIn Constructor
    *
-   * Creates a new ReadFromSocket operator by defining its kernel function,
-   * operating on each token of the stream, delimited by the delimiter value.
+   * Creates a new ReadFromStdIn operator, yielding the tokens of the standard
+   * input, delimited by the delimiter value.
    */
-  ReadFromStdIn(char delimiter_)
-      : InputOperator<std::string>(StructureType::STREAM) {
+  BasicReadFromStdIn(char delimiter_, unsigned par = 1)
+      : InputOperator<Line>(StructureType::STREAM) {
     delimiter = delimiter_;
+    this->pardeg(par);
   }
 
   /**
    * Copy constructor.
    */
-  ReadFromStdIn(const ReadFromStdIn &copy) : InputOperator<std::string>(copy) {
+  BasicReadFromStdIn(const BasicReadFromStdIn &copy)
+      : InputOperator<Line>(copy) {
     delimiter = copy.delimiter;
   }
 
+  /**
+   * \ingroup op-api
+   * Yields an unordered collection (i.e., a bag) rather than a stream, so that
+   * parallel workers emit lines with no ordering constraint.
+   */
+  BasicReadFromStdIn unordered() const {
+    BasicReadFromStdIn res(*this);
+    res.stype(StructureType::STREAM, false);
+    res.stype(StructureType::BAG, true);
+    return res;
+  }
+
   /**
    * Returns a unique name for the operator.
    */
@@ -85,19 +106,32 @@ class ReadFromStdIn : public InputOperator<std::string> {
   std::string name_short() { return "ReadFromStdIn"; }
 
  protected:
-  ReadFromStdIn *clone() { return new ReadFromStdIn(*this); }
+  BasicReadFromStdIn *clone() { return new BasicReadFromStdIn(*this); }
 
   const OpClass operator_class() { return OpClass::INPUT; }
 
   ff::ff_node *node_operator(int parallelism, StructureType st) {
-    assert(st == StructureType::STREAM);
-    return new ReadFromStdInFFNode<Token<std::string>>(delimiter);
+    auto mb_size = this->template microbatch_slots<Token<Line>>();
+    if (parallelism == 1)
+      return new ReadFromStdInFFNode<Token<Line>>(delimiter, mb_size);
+    if (st == StructureType::STREAM)
+      return new ReadFromStdInFFNode_par<Token<Line>, OrderingFarm>(
+          parallelism, delimiter, mb_size);
+    assert(st == StructureType::BAG);
+    return new ReadFromStdInFFNode_par<Token<Line>, NonOrderingFarm>(
+        parallelism, delimiter, mb_size);
   }
 
  private:
   char delimiter;
 };
 
+/**
+ * \ingroup op-api
+ * ReadFromStdIn producing std::string lines (see BasicReadFromStdIn<LineView>).
+ */
+typedef BasicReadFromStdIn<std::string> ReadFromStdIn;
+
 } /* namespace pico */
 
 #endif /* OPERATORS_INOUT_READFROMSTDIN_HPP_ */
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPERATORS_INOUT_WRITETOBINARYFILE_HPP_
+#define OPERATORS_INOUT_WRITETOBINARYFILE_HPP_
+
+#include <sstream>
+#include <string>
+
+#include "pico/ff_implementation/OperatorsFFNodes/InOut/WriteToBinaryFileFFNode.hpp"
+
+#include "OutputOperator.hpp"
+
+namespace pico {
+
+/**
+ * Defines an operator that writes data as fixed-size binary records, to be
+ * read back by ReadFromBinaryFile.
+ *
+ * Items are either trivially-copyable values or key-value pairs with
+ * trivially-copyable keys and values (e.g., KeyValue<unsigned, float>).
+ *
+ * The operator is global and unique for the Pipe it refers to.
+ */
+template <typename In>
+class WriteToBinaryFile : public OutputOperator<In> {
+ public:
+  /**
+   * \ingroup op-api
+   *
+   * WriteToBinaryFile Constructor
+   *
+   * Creates a new WriteToBinaryFile operator.
+   */
+  WriteToBinaryFile(std::string fname_)
+      : OutputOperator<In>(StructureType::BAG), fname(fname_) {}
+
+  /**
+   * Copy constructor.
+   */
+  WriteToBinaryFile(const WriteToBinaryFile &copy)
+      : OutputOperator<In>(copy), fname(copy.fname) {}
+
+  /**
+   * Returns a unique name for the operator.
+   */
+  std::string name() {
+    std::string name("WriteToBinaryFile");
+    std::ostringstream address;
+    address << (void const *)this;
+    return name + address.str().erase(0, 2);
+  }
+
+  /**
+   * Returns the name of the operator, consisting in the name of the class.
+   */
+  std::string name_short() { return "WriteToBinaryFile\n[" + fname + "]"; }
+
+ protected:
+  WriteToBinaryFile *clone() { return new WriteToBinaryFile(*this); }
+
+  ff::ff_node *node_operator(int /* parallelism */, StructureType st) {
+    assert(st == StructureType::BAG);
+    return new WriteToBinaryFileFFNode<In>(fname);
+  }
+
+ private:
+  std::string fname;
+};
+
+} /* namespace pico */
+
+#endif /* OPERATORS_INOUT_WRITETOBINARYFILE_HPP_ */
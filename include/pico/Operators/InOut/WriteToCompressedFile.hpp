@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPERATORS_INOUT_WRITETOCOMPRESSEDFILE_HPP_
+#define OPERATORS_INOUT_WRITETOCOMPRESSEDFILE_HPP_
+
+#include <functional>
+#include <sstream>
+#include <string>
+
+#include "pico/ff_implementation/OperatorsFFNodes/InOut/WriteToCompressedFileFFNode.hpp"
+
+#include "OutputOperator.hpp"
+
+namespace pico {
+
+/**
+ * Defines an operator that writes data to a block-compressed text file, to be
+ * read back by ReadFromCompressedFile.
+ *
+ * Each item is written as a line, either produced by a user kernel or by
+ * ostream. Lines are grouped into independently compressed blocks of about
+ * block_size (uncompressed) bytes.
+ *
+ * The operator is global and unique for the Pipe it refers to.
+ */
+template <typename In>
+class WriteToCompressedFile : public OutputOperator<In> {
+ public:
+  /**
+   * \ingroup op-api
+   *
+   * WriteToCompressedFile Constructor
+   *
+   * Creates a new WriteToCompressedFile operator by defining its kernel
+   * function.
+   */
+  WriteToCompressedFile(std::string fname_,
+                        std::function<std::string(In)> func_,
+                        size_t block_size_ = ZBLOCK_SIZE)
+      : OutputOperator<In>(StructureType::BAG),
+        fname(fname_),
+        func(func_),
+        block_size(block_size_) {}
+
+  /**
+   * \ingroup op-api
+   *
+   * WriteToCompressedFile Constructor
+   *
+   * Creates a new WriteToCompressedFile writing by ostream.
+   */
+  WriteToCompressedFile(std::string fname_, size_t block_size_ = ZBLOCK_SIZE)
+      : OutputOperator<In>(StructureType::BAG),
+        fname(fname_),
+        block_size(block_size_) {}
+
+  /**
+   * Copy constructor.
+   */
+  WriteToCompressedFile(const WriteToCompressedFile &copy)
+      : OutputOperator<In>(copy),
+        fname(copy.fname),
+        func(copy.func),
+        block_size(copy.block_size) {}
+
+  /**
+   * Returns a unique name for the operator.
+   */
+  std::string name() {
+    std::string name("WriteToCompressedFile");
+    std::ostringstream address;
+    address << (void const *)this;
+    return name + address.str().erase(0, 2);
+  }
+
+  /**
+   * Returns the name of the operator, consisting in the name of the class.
+   */
+  std::string name_short() { return "WriteToCompressedFile\n[" + fname + "]"; }
+
+ protected:
+  WriteToCompressedFile *clone() { return new WriteToCompressedFile(*this); }
+
+  ff::ff_node *node_operator(int /* parallelism */, StructureType st) {
+    assert(st == StructureType::BAG);
+    return new WriteToCompressedFileFFNode<In>(fname, func, block_size);
+  }
+
+ private:
+  std::string fname;
+  std::function<std::string(In)> func;
+  size_t block_size;
+};
+
+} /* namespace pico */
+
+#endif /* OPERATORS_INOUT_WRITETOCOMPRESSEDFILE_HPP_ */
@@ -43,6 +43,12 @@ namespace pico {
  * the text file, passed as a std::string. The kernel can be a lambda function,
  * a functor or a function.
  *
+ * Lines are buffered in large user-space buffers, and the file is complete
+ * once the written collection is over.
+ *
+ * The operator is sequential by default (i.e., its parallelism degree is one),
+ * while a higher degree runs parallel writers (see parallel() and shards()).
+ *
  *
  * The operator is global and unique for the Pipe it refers to.
  */
@@ -61,7 +67,9 @@ class WriteToDisk : public OutputOperator<In> {
       : OutputOperator<In>(StructureType::BAG),
         fname(fname_),  //
         usr_func(true),
-        func(func_) {}
+        func(func_) {
+    this->pardeg(1);
+  }
 
   /**
    * \ingroup op-api
@@ -71,13 +79,56 @@ class WriteToDisk : public OutputOperator<In> {
    * Creates a new WriteToDisk writing by ostream.
    */
   WriteToDisk(std::string fname_)
-      : OutputOperator<In>(StructureType::BAG), fname(fname_) {}
+      : OutputOperator<In>(StructureType::BAG), fname(fname_) {
+    this->pardeg(1);
+  }
 
   /**
    * Copy constructor.
    */
   WriteToDisk(const WriteToDisk& copy)
-      : OutputOperator<In>(copy), fname(copy.fname), func(copy.func) {}
+      : OutputOperator<In>(copy),
+        fname(copy.fname),
+        usr_func(copy.usr_func),
+        func(copy.func),
+        async(copy.async),
+        sharded(copy.sharded) {}
+
+  /**
+   * \ingroup op-api
+   * Writes the file by par parallel writers, each one formatting whole
+   * microbatches into private buffers and writing them at disjoint regions of
+   * the file, such that the file holds the records in stream order.
+   */
+  WriteToDisk parallel(unsigned par) const {
+    WriteToDisk res(*this);
+    res.pardeg(par);
+    res.sharded = false;
+    return res;
+  }
+
+  /**
+   * \ingroup op-api
+   * Writes par shards in parallel, as the files part-00000, part-00001 and so
+   * on within the fname directory (replacing any part-* file found there).
+   */
+  WriteToDisk shards(unsigned par) const {
+    WriteToDisk res(*this);
+    res.pardeg(par);
+    res.sharded = true;
+    return res;
+  }
+
+  /**
+   * \ingroup op-api
+   * Writes the output buffers from a dedicated thread, while the next buffer
+   * is being filled.
+   */
+  WriteToDisk async_write() const {
+    WriteToDisk res(*this);
+    res.async = true;
+    return res;
+  }
 
   /**
    * Returns a unique name for the operator.
@@ -104,15 +155,19 @@ class WriteToDisk : public OutputOperator<In> {
   ff::ff_node* node_operator(int parallelism, StructureType st) {
     assert(st == StructureType::BAG);
     if (usr_func)
-      return new WriteToDiskFFNode<In>(fname, func);
+      return WriteToDiskFFNode_make<WriteToDiskFFNode<In>>(
+          parallelism, fname, sharded, async, func);
     else
-      return new WriteToDiskFFNode_ostream<In>(fname);
+      return WriteToDiskFFNode_make<WriteToDiskFFNode_ostream<In>>(
+          parallelism, fname, sharded, async);
   }
 
  private:
   std::string fname;
   bool usr_func = false;
   std::function<std::string(In)> func;
+  bool async = false;
+  bool sharded = false;
 };
 
 } /* namespace pico */
@@ -76,6 +76,18 @@ class WriteToStdOut : public OutputOperator<In> {
   WriteToStdOut(const WriteToStdOut& copy) : OutputOperator<In>(copy) {
     func = copy.func;
     usr_func = copy.usr_func;
+    async = copy.async;
+  }
+
+  /**
+   * \ingroup op-api
+   * Writes the output buffers from a dedicated thread, while the next buffer
+   * is being filled.
+   */
+  WriteToStdOut async_write() const {
+    WriteToStdOut res(*this);
+    res.async = true;
+    return res;
   }
 
   /**
@@ -104,13 +116,14 @@ class WriteToStdOut : public OutputOperator<In> {
 
   ff::ff_node* node_operator(int parallelism, StructureType st) {
     assert(st == StructureType::STREAM);
-    if (usr_func) return new WriteToStdOutFFNode<In, Token<In>>(func);
-    return new WriteToStdOutFFNode_ostream<In, Token<In>>();
+    if (usr_func) return new WriteToStdOutFFNode<In, Token<In>>(func, async);
+    return new WriteToStdOutFFNode_ostream<In, Token<In>>(async);
   }
 
  private:
   bool usr_func = false;
   std::function<std::string(In)> func;
+  bool async = false;
 };
 
 } /* namespace pico */
@@ -35,7 +35,9 @@ namespace pico {
  * according to the callable kernel.
  */
 template <typename In1, typename In2, typename Out>
-class JoinFlatMapByKey : public BinaryOperator<In1, In2, Out> {
+class JoinFlatMapByKey
+    : public BinaryOperator<In1, In2, Out>,
+      public MicrobatchSizing<JoinFlatMapByKey<In1, In2, Out>> {
  public:
   /**
    * \ingroup op-api
@@ -66,7 +68,7 @@ class JoinFlatMapByKey : public BinaryOperator<In1, In2, Out> {
                              StructureType st) {
     assert(st == StructureType::BAG);
     using t = JoinFlatMapByKeyFarm<Token<In1>, Token<In2>, Token<Out>>;
-    return new t(parallelism, kernel, left_input);
+    return new t(parallelism, kernel, left_input, mb_size());
   }
 
   ff::ff_node *opt_node(int pardeg, bool lin, PEGOptimization_t opt,
@@ -76,10 +78,18 @@ class JoinFlatMapByKey : public BinaryOperator<In1, In2, Out> {
     auto nextop = dynamic_cast<ReduceByKey<Out> *>(a.op);
     if (nextop->pardeg() == 1) {
       using t = JFMRBK_seq_red<Token<In1>, Token<In2>, Token<Out>>;
-      return new t(pardeg, lin, kernel, nextop->kernel());
+      return new t(pardeg, lin, kernel, nextop->kernel(), mb_size(),
+                   nextop->mb_size(), nextop->cardinality(),
+                   nextop->combiner_entries(), nextop->keyed_state());
     }
     using t = JFMRBK_par_red<Token<In1>, Token<In2>, Token<Out>>;
-    return new t(pardeg, lin, kernel, nextop->pardeg(), nextop->kernel());
+    return new t(pardeg, lin, kernel, nextop->pardeg(), nextop->kernel(),
+                 mb_size(), nextop->mb_size(), nextop->cardinality(),
+                 nextop->combiner_entries(), nextop->keyed_state());
+  }
+
+  unsigned mb_size() const {
+    return this->template microbatch_slots<Token<Out>>();
   }
 
  protected:
@@ -83,11 +83,15 @@ class MapBase : public UnaryOperator<In, Out> {
     // todo assert unique stype
     if (st == StructureType::STREAM) {
       using impl_t = MapBatchStream<In, Out, Token<In>, Token<Out>>;
-      return new impl_t(parallelism, mapf);
+      return new impl_t(parallelism, mapf, mb_size());
     }
     assert(st == StructureType::BAG);
     using impl_t = MapBatchBag<In, Out, Token<In>, Token<Out>>;
-    return new impl_t(parallelism, mapf);
+    return new impl_t(parallelism, mapf, mb_size());
+  }
+
+  unsigned mb_size() const {
+    return this->template microbatch_slots<Token<Out>>();
   }
 
   std::function<Out(In &)> mapf;
@@ -98,7 +102,7 @@ class MapBase : public UnaryOperator<In, Out> {
  */
 
 template <typename In, typename Out>
-class Map : public MapBase<In, Out> {
+class Map : public MapBase<In, Out>, public MicrobatchSizing<Map<In, Out>> {
  public:
   /**
    * \ingroup op-api
@@ -130,7 +134,9 @@ class Map : public MapBase<In, Out> {
  */
 
 template <typename In, typename K, typename V>
-class Map<In, KeyValue<K, V>> : public MapBase<In, KeyValue<K, V>> {
+class Map<In, KeyValue<K, V>>
+    : public MapBase<In, KeyValue<K, V>>,
+      public MicrobatchSizing<Map<In, KeyValue<K, V>>> {
  public:
   /**
    * \ingroup op-api
@@ -161,7 +167,9 @@ class Map<In, KeyValue<K, V>> : public MapBase<In, KeyValue<K, V>> {
     assert(st == StructureType::BAG);
     auto nextop = dynamic_cast<ReduceByKey<KeyValue<K, V>> *>(a.op);
     return MapPReduceBatch<Token<In>, Token<KeyValue<K, V>>>(
-        pardeg, this->mapf, nextop->pardeg(), nextop->kernel());
+        pardeg, this->mapf, nextop->pardeg(), nextop->kernel(),  //
+        this->mb_size(), nextop->mb_size(), nextop->cardinality(),
+        nextop->combiner_entries(), nextop->keyed_state());
   }
 };
 
@@ -26,6 +26,7 @@
 
 #include <ff/node.hpp>
 
+#include "pico/Internals/Microbatch.hpp"
 #include "pico/Internals/utils.hpp"
 #include "pico/WindowPolicy.hpp"
 
@@ -59,6 +60,8 @@ class Operator {
     stype(StructureType::BAG, copy.st_map.at(StructureType::BAG));
     stype(StructureType::STREAM, copy.st_map.at(StructureType::STREAM));
     pardeg_ = copy.pardeg_;
+    mb_items_ = copy.mb_items_;
+    mb_bytes_ = copy.mb_bytes_;
   }
 
   virtual ~Operator() {}
@@ -102,10 +105,65 @@ class Operator {
 
   void pardeg(unsigned pardeg__) { pardeg_ = pardeg__; }
 
+  /*
+   * size of the produced microbatches, either in items or in bytes
+   */
+  void set_microbatch_items(unsigned items) {
+    mb_items_ = items;
+    mb_bytes_ = 0;
+  }
+
+  void set_microbatch_bytes(size_t bytes) {
+    mb_bytes_ = bytes;
+    mb_items_ = 0;
+  }
+
+  /*
+   * Returns the number of items per microbatch, for microbatches of the given
+   * token type, or zero if not set (i.e., the global setting applies).
+   */
+  template <typename TokenType>
+  unsigned microbatch_slots() const {
+    if (mb_items_) return mb_items_;
+    if (mb_bytes_) return Microbatch<TokenType>::slots_for(mb_bytes_);
+    return 0;
+  }
+
  private:
   size_t in_deg, out_deg;
   st_map_t st_map;
   unsigned pardeg_ = def_par();
+  unsigned mb_items_ = 0;
+  size_t mb_bytes_ = 0;
+};
+
+/*
+ * Mixin exposing the microbatch sizing of an Operator as copy-and-set
+ * methods, to be inherited (as MicrobatchSizing<Derived>) by operators
+ * producing microbatches.
+ */
+template <typename Derived>
+class MicrobatchSizing {
+ public:
+  /**
+   * \ingroup op-api
+   * Sets the size (in items) of the microbatches produced by the operator.
+   */
+  Derived microbatch(unsigned items) const {
+    Derived res(static_cast<const Derived &>(*this));
+    res.set_microbatch_items(items);
+    return res;
+  }
+
+  /**
+   * \ingroup op-api
+   * Sets the size (in bytes) of the microbatches produced by the operator.
+   */
+  Derived microbatch_bytes(size_t bytes) const {
+    Derived res(static_cast<const Derived &>(*this));
+    res.set_microbatch_bytes(bytes);
+    return res;
+  }
 };
 
 } /* namespace pico */
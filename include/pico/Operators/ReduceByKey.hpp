@@ -21,8 +21,10 @@
 #ifndef REDUCEBYKEY_HPP_
 #define REDUCEBYKEY_HPP_
 
+#include "pico/Internals/KeyedReducer.hpp"
 #include "pico/Internals/TimedToken.hpp"
 #include "pico/Internals/Token.hpp"
+#include "pico/ff_implementation/OperatorsFFNodes/PReduceBatch.hpp"
 #include "pico/ff_implementation/OperatorsFFNodes/PReduceWin.hpp"
 
 #include "UnaryOperator.hpp"
@@ -41,7 +43,8 @@ namespace pico {
  * same.
  */
 template <typename In>
-class ReduceByKey : public UnaryOperator<In, In> {
+class ReduceByKey : public UnaryOperator<In, In>,
+                    public MicrobatchSizing<ReduceByKey<In>> {
   typedef typename In::keytype K;
   typedef typename In::valuetype V;
 
@@ -68,6 +71,9 @@ class ReduceByKey : public UnaryOperator<In, In> {
   ReduceByKey(const ReduceByKey& copy) : UnaryOperator<In, In>(copy) {
     reducef = copy.reducef;
     win = copy.win ? copy.win->clone() : nullptr;
+    keys = copy.keys;
+    combiner_entries_ = copy.combiner_entries_;
+    state = copy.state;
   }
 
   ~ReduceByKey() {
@@ -91,8 +97,84 @@ class ReduceByKey : public UnaryOperator<In, In> {
     return res;
   }
 
+  /**
+   * \ingroup op-api
+   * Hints the expected number of distinct keys, so that the reduce state is
+   * sized upfront rather than grown while reducing.
+   */
+  ReduceByKey cardinality(size_t keys_) const {
+    ReduceByKey res(*this);
+    res.keys = keys_;
+    return res;
+  }
+
+  /**
+   * \ingroup op-api
+   * Sets the number of entries of the map-side combiners.
+   *
+   * Each worker of the preceding operator (when a Map, a FlatMap or a
+   * JoinFlatMapByKey) or of the partitioning stage (otherwise) pre-reduces its
+   * output into a fixed-size combiner, and forwards the pairs evicted from a
+   * full combiner to the final reduce.
+   * Smaller combiners stay cache resident, larger ones evict less often.
+   */
+  ReduceByKey combiner(size_t entries) const {
+    ReduceByKey res(*this);
+    res.combiner_entries_ = entries;
+    return res;
+  }
+
+  /**
+   * \ingroup op-api
+   * Sets the aggregation strategy of batch reduce.
+   *
+   * Aggregation::HASH reduces into hash tables, Aggregation::SORT sorts the
+   * pairs into runs and merges them, streaming out keys in ascending order
+   * from each reducer. Sorting requires keys comparable by operator<.
+   * Aggregation::AUTO (the default) hashes and switches to sorting when the
+   * observed (or hinted) number of keys grows large.
+   */
+  ReduceByKey aggregation(Aggregation agg) const {
+    ReduceByKey res(*this);
+    res.state.agg = agg;
+    return res;
+  }
+
+  /**
+   * \ingroup op-api
+   * Bounds the memory (in bytes) taken by the state of each reducer.
+   *
+   * Beyond the budget, the state is sorted (see aggregation) and spilled to
+   * local disk, in the directory named by the PICO_SPILL_DIR environment
+   * variable (or TMPDIR, or /tmp), then merged upon completion.
+   * Spilling requires keys comparable by operator<, and keys and values that
+   * are either trivially copyable or strings, otherwise the budget is ignored
+   * (as reported among the node statistics under TRACE_PICO).
+   *
+   * Windowed (stream) reduce is not spilled: beyond the budget, only the keys
+   * of closed windows are dropped from the state of each reducer.
+   */
+  ReduceByKey memory_budget(size_t bytes) const {
+    ReduceByKey res(*this);
+    res.state.memory_budget = bytes;
+    return res;
+  }
+
   std::function<V(V&, V&)> kernel() { return reducef; }
 
+  /* the expected number of distinct keys (zero if unknown) */
+  size_t cardinality() const { return keys; }
+
+  /* the number of entries of map-side combiners (zero for the default) */
+  size_t combiner_entries() const { return combiner_entries_; }
+
+  /* the configuration of the reducer state (aggregation, memory budget) */
+  keyed_state_cfg keyed_state() const { return state; }
+
+  unsigned mb_size() const {
+    return this->template microbatch_slots<Token<In>>();
+  }
+
  protected:
   ReduceByKey* clone() { return new ReduceByKey(*this); }
 
@@ -106,15 +188,19 @@ class ReduceByKey : public UnaryOperator<In, In> {
     // todo assert unique stype
     if (st == StructureType::STREAM) {
       assert(win);
-      return new PReduceWin<In, Token<In>>(pardeg, reducef, win);
+      return new PReduceWin<In, Token<In>>(pardeg, reducef, win, mb_size(),
+                                           keys, state);
     }
-    // todo
-    return nullptr;
+    return PReduceBatch<Token<In>>(pardeg, reducef, mb_size(), keys,
+                                   combiner_entries_, state);
   }
 
  private:
   std::function<V(V&, V&)> reducef;
   WindowPolicy* win = nullptr;
+  size_t keys = 0;
+  size_t combiner_entries_ = 0;
+  keyed_state_cfg state;
 };
 
 } /* namespace pico */
@@ -144,6 +144,7 @@ class Pipe {
     in_deg_ = copy.in_deg_;
     out_deg_ = copy.out_deg_;
     copy_struct_type(*this, copy.st_map);
+    mb_target_ = copy.mb_target_;
 
     if (has_operator())
       term_value.op = copy.term_value.op->clone();
@@ -542,6 +543,36 @@ class Pipe {
     run_pipe(*executor, m);
   }
 
+  /**
+   * \ingroup pipe-api
+   * Enable adaptive microbatch sizing, aiming at
+   * a target throughput.
+   *
+   * Emitters resize their outgoing microbatches at runtime, based on the
+   * measured per-item service time and output-queue occupancy.
+   * @param items_per_sec the target throughput, in items per second
+   */
+  void throughput_target(double items_per_sec) {
+    mb_target_.policy = mb_target::THROUGHPUT;
+    mb_target_.value = items_per_sec;
+  }
+
+  /**
+   * \ingroup pipe-api
+   * Enable adaptive microbatch sizing, aiming at
+   * a target latency.
+   *
+   * Emitters resize their outgoing microbatches at runtime, so that the time
+   * spent batching each item fits the target.
+   * @param msecs the target batching latency, in milliseconds
+   */
+  void latency_target(double msecs) {
+    mb_target_.policy = mb_target::LATENCY;
+    mb_target_.value = msecs / 1000;
+  }
+
+  const mb_target &microbatch_target() const { return mb_target_; }
+
   /**
    * \ingroup pipe-api
    * Return execution time of the application in milliseconds
@@ -659,6 +690,9 @@ class Pipe {
   } term_value;
   std::vector<Pipe *> children_;
 
+  /* adaptive microbatch sizing */
+  mb_target mb_target_;
+
   /* semantic graph */
   SemanticGraph *semantic_graph = nullptr;
 
@@ -30,8 +30,24 @@
 
 namespace pico {
 
+/*
+ * Target for adaptive microbatch sizing:
+ * - FIXED: every microbatch has MICROBATCH_SIZE items
+ * - THROUGHPUT: value is a rate in items per second
+ * - LATENCY: value is the maximum batching delay in seconds
+ */
+struct mb_target {
+  enum policy_t { FIXED, THROUGHPUT, LATENCY };
+  policy_t policy = FIXED;
+  double value = 0;
+};
+
 struct {
   int MICROBATCH_SIZE = 8;
+  /* bounds and target for adaptive microbatch sizing */
+  int MICROBATCH_MIN = 1;
+  int MICROBATCH_MAX = 4096;
+  mb_target MICROBATCH_TARGET;
 } global_params;
 
 } /* namespace pico */
@@ -211,6 +211,12 @@ class FastFlowExecutor {
 
   void print_stats(std::ostream &os) const {
     if (ff_pipe) ff_pipe->ffStats(os);
+#ifdef PICO_POOL_ALLOC
+    pico::pool::print_stats(os);
+#endif
+#ifdef PICO_NUMA
+    pico::numa::print_stats(os);
+#endif
   }
 
  private:
@@ -227,6 +233,7 @@ class FastFlowExecutor {
 FastFlowExecutor *make_executor(const pico::Pipe &p) {
   auto mb_env = std::getenv("MBSIZE");
   if (mb_env) pico::global_params.MICROBATCH_SIZE = atoi(mb_env);
+  pico::global_params.MICROBATCH_TARGET = p.microbatch_target();
 
   return new FastFlowExecutor(p);
 }
@@ -34,7 +34,8 @@ template <typename In, typename Out, typename Farm, typename TokenTypeIn,
 class FMapBatch : public Farm {
  public:
   FMapBatch(int par,
-            std::function<void(In &, pico::FlatMapCollector<Out> &)> flatmapf) {
+            std::function<void(In &, pico::FlatMapCollector<Out> &)> flatmapf,
+            unsigned mb_size = 0) {
     ff::ff_node *e;
     if (this->isOFarm())
       e = new OrdForwardingEmitter(par);
@@ -44,7 +45,7 @@ class FMapBatch : public Farm {
     this->setEmitterF(e);
     this->setCollectorF(c);
     std::vector<ff::ff_node *> w;
-    for (int i = 0; i < par; ++i) w.push_back(new Worker(flatmapf));
+    for (int i = 0; i < par; ++i) w.push_back(new Worker(flatmapf, mb_size));
     this->add_workers(w);
     this->cleanup_all();
   }
@@ -54,8 +55,9 @@ class FMapBatch : public Farm {
     typedef typename pico::TokenCollector<Out>::cnode cnode_t;
 
    public:
-    Worker(std::function<void(In &, pico::FlatMapCollector<Out> &)> kernel_)
-        : mkernel(kernel_) {}
+    Worker(std::function<void(In &, pico::FlatMapCollector<Out> &)> kernel_,
+           unsigned mb_size)
+        : collector(mb_size), mkernel(kernel_) {}
 
     void kernel(pico::base_microbatch *mb) {
       auto in_mb = reinterpret_cast<pico::Microbatch<TokenTypeIn> *>(mb);
@@ -65,8 +67,10 @@ class FMapBatch : public Farm {
       for (In &tt : *in_mb) {
         mkernel(tt, collector);
       }
-      if (collector.begin())
-        ff_send_out(NEW<pico::mb_wrapped<cnode_t>>(tag, collector.begin()));
+      if (collector.begin()) {
+        auto wmb = NEW<pico::mb_wrapped<cnode_t>>(tag, collector.begin());
+        collector.sizer().send(collector.size(), [&]() { ff_send_out(wmb); });
+      }
 
       // clean up
       DELETE(in_mb);
@@ -21,18 +21,31 @@
 #ifndef INTERNALS_FFOPERATORS_FMAPPREDUCEBATCH_HPP_
 #define INTERNALS_FFOPERATORS_FMAPPREDUCEBATCH_HPP_
 
-#include <unordered_map>
+#include <memory>
+#include <ostream>
+#include <vector>
 
 #include <ff/ff.hpp>
 
 #include "pico/FlatMapCollector.hpp"
+#include "pico/Internals/KVMicrobatch.hpp"
 #include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
 #include "pico/Internals/TimedToken.hpp"
 #include "pico/Internals/utils.hpp"
 
+#include "pico/ff_implementation/SupportFFNodes/MapSideCombiner.hpp"
 #include "pico/ff_implementation/SupportFFNodes/RBKOptFarm.hpp"
+#include "pico/ff_implementation/SupportFFNodes/emitters.hpp"
 #include "pico/ff_implementation/ff_config.hpp"
 
+/*
+ * FlatMap followed by non-parallel ReduceByKey.
+ *
+ * Each worker combines its flat-map output by a bounded combiner, whose
+ * evicted entries (and whose content, upon c-stream end) are streamed to the
+ * reducing collector.
+ */
 template <typename TokenTypeIn, typename TokenTypeOut>
 class FMRBK_seq_red : public NonOrderingFarm {
   typedef typename TokenTypeIn::datatype In;
@@ -45,14 +58,19 @@ class FMRBK_seq_red : public NonOrderingFarm {
   FMRBK_seq_red(
       int fmap_par,
       std::function<void(In &, pico::FlatMapCollector<Out> &)> &flatmapf,
-      std::function<OutV(OutV &, OutV &)> reducef) {
+      std::function<OutV(OutV &, OutV &)> reducef,  //
+      unsigned fmap_mb_size = 0, unsigned red_mb_size = 0, size_t keys = 0,
+      size_t combiner_entries = 0,
+      pico::keyed_state_cfg state = {}) {
     auto e = new fw_emitter_t(fmap_par);
     this->setEmitterF(e);
-    auto c = new PReduceCollector<Out, TokenTypeOut>(fmap_par, reducef);
+    auto c = new PReduceCollector<Out, TokenTypeOut>(fmap_par, reducef,
+                                                     red_mb_size, keys, state);
     this->setCollectorF(c);
     std::vector<ff_node *> w;
     for (int i = 0; i < fmap_par; ++i)
-      w.push_back(new Worker(flatmapf, reducef));
+      w.push_back(
+          new Worker(flatmapf, reducef, fmap_mb_size, combiner_entries));
     this->add_workers(w);
     this->cleanup_all();
   }
@@ -62,8 +80,11 @@ class FMRBK_seq_red : public NonOrderingFarm {
    public:
     Worker(
         std::function<void(In &, pico::FlatMapCollector<Out> &)> &kernel_,  //
-        std::function<OutV(OutV &, OutV &)> &reducef_kernel_)
-        : map_kernel(kernel_), reduce_kernel(reducef_kernel_) {}
+        std::function<OutV(OutV &, OutV &)> &reducef_kernel_,
+        unsigned mb_size_, size_t combiner_entries)
+        : collector(mb_size_),
+          map_kernel(kernel_),
+          combiner(1, reducef_kernel_, mb_size_, combiner_entries) {}
 
     void kernel(pico::base_microbatch *in_mb) {
       /*
@@ -71,7 +92,6 @@ class FMRBK_seq_red : public NonOrderingFarm {
        */
       auto in_microbatch = reinterpret_cast<mb_in *>(in_mb);
       auto tag = in_mb->tag();
-      auto &s(tag_state[tag]);
 
       collector.tag(tag);
 
@@ -81,14 +101,8 @@ class FMRBK_seq_red : public NonOrderingFarm {
       // partial reduce on all output micro-batches
       auto it = collector.begin();
       while (it) {
-        /* reduce the micro-batch */
-        for (Out &kv : *it->mb) {
-          const OutK &k(kv.Key());
-          if (s.kvmap.find(k) != s.kvmap.end())
-            s.kvmap[k] = reduce_kernel(kv.Value(), s.kvmap[k]);
-          else
-            s.kvmap[k] = kv.Value();
-        }
+        /* combine the micro-batch */
+        combiner.reduce_mb(tag, it->mb, send_out());
 
         /* clean up and skip to the next micro-batch */
         auto it_ = it;
@@ -103,42 +117,37 @@ class FMRBK_seq_red : public NonOrderingFarm {
     }
 
     void cstream_end_callback(pico::base_microbatch::tag_t tag) {
-      auto &s(tag_state[tag]);
-      auto mb = NEW<mb_out>(tag, pico::global_params.MICROBATCH_SIZE);
-      for (auto it = s.kvmap.begin(); it != s.kvmap.end(); ++it) {
-        new (mb->allocate()) Out(it->first, it->second);
-        mb->commit();
-        if (mb->full()) {
-          ff_send_out(reinterpret_cast<void *>(mb));
-          mb = NEW<mb_out>(tag, pico::global_params.MICROBATCH_SIZE);
-        }
-      }
+      combiner.flush(tag, send_out());
+    }
 
-      /* send out the remainder micro-batch or destroy if spurious */
-      if (!mb->empty()) {
-        ff_send_out(reinterpret_cast<void *>(mb));
-      } else {
-        DELETE(mb);
-      }
+#ifdef TRACE_PICO
+    void ffStats(std::ostream &os) {
+      base_node::ffStats(os);
+      combiner.print_stats(os);
     }
+#endif
 
    private:
     typedef pico::Microbatch<TokenTypeIn> mb_in;
-    typedef pico::Microbatch<TokenTypeOut> mb_out;
+    typedef typename MapSideCombiner<TokenTypeOut>::mb_t mb_out;
 
     pico::TokenCollector<Out> collector;
     std::function<void(In &, pico::FlatMapCollector<Out> &)> map_kernel;
-    std::function<OutV(OutV &, OutV &)> reduce_kernel;
-    struct key_state {
-      std::unordered_map<OutK, OutV> kvmap;
-    };
-    std::unordered_map<pico::base_microbatch::tag_t, key_state> tag_state;
+    MapSideCombiner<TokenTypeOut> combiner;
+
+    inline auto send_out() {
+      return [this](mb_out *mb, unsigned) {
+        ff_send_out(reinterpret_cast<void *>(mb));
+      };
+    }
   };
 };
 
 /*
- * todo
- * this approach has poor performance, should be replaced by shuffling
+ * FlatMap followed by parallel ReduceByKey.
+ *
+ * Each flat-map worker combines its output by a bounded combiner and shuffles
+ * the evicted entries (and the content, upon c-stream end) to the reducers.
  */
 template <typename TokenTypeIn, typename TokenTypeOut>
 class FMRBK_par_red : public ff::ff_pipeline {
@@ -146,141 +155,99 @@ class FMRBK_par_red : public ff::ff_pipeline {
   typedef typename TokenTypeOut::datatype Out;
   typedef typename Out::keytype OutK;
   typedef typename Out::valuetype OutV;
-  typedef typename RBK_farm<TokenTypeOut>::Emitter emitter_t;
 
  public:
   FMRBK_par_red(
       int fmap_par,
       std::function<void(In &, pico::FlatMapCollector<Out> &)> &fmap_f,
       int red_par,  //
-      std::function<OutV(OutV &, OutV &)> red_f) {
-    /* create the flatmap farm */
-    auto fmap_farm = new FM_farm(fmap_par, fmap_f, red_par, red_f);
-
-    /* create the reduce-by-key farm farm */
-    auto rbk_farm = new RBK_farm<TokenTypeOut>(fmap_par, red_par, red_f);
-
-    auto emitter = reinterpret_cast<emitter_t *>(rbk_farm->getEmitter());
-
-    /* combine the farms with shuffle */
-    auto combined_farm = ff::combine_farms<emitter_t, emitter_t>(
-        *fmap_farm, emitter, *rbk_farm, nullptr, false);
+      std::function<OutV(OutV &, OutV &)> red_f,
+      unsigned fmap_mb_size = 0, unsigned red_mb_size = 0, size_t keys = 0,
+      size_t combiner_entries = 0,
+      pico::keyed_state_cfg state = {}) {
+    /* create the flat-map workers */
+    auto hot = std::make_shared<pico::hot_key_set<OutK>>();
+    std::vector<ff::ff_node *> w;
+    for (int i = 0; i < fmap_par; ++i)
+      w.push_back(new Worker(fmap_f, red_par, red_f, fmap_mb_size,
+                             combiner_entries, hot));
 
-    /* compose the pipeline */
-    this->add_stage(combined_farm);
+    /* shuffle to the reduce-by-key workers */
+    auto e = new ForwardingEmitter(fmap_par);
+    this->add_stage(new RBK_shuffle<TokenTypeOut>(e, w, red_par, red_f, hot,
+                                                  red_mb_size, keys, state));
     this->cleanup_nodes();
   }
 
  private:
   /*
-   * the FlatMap farm computes the flat-map for each micro-batch,
-   * then reduces the result and streams it out
+   * the FlatMap worker computes the flat-map for each micro-batch,
+   * then combines the result and streams out the partially reduced pairs
    */
-  class FM_farm : public NonOrderingFarm {
+  class Worker : public base_shuffler {
    public:
-    FM_farm(int fmap_par,
-            std::function<void(In &, pico::FlatMapCollector<Out> &)> &flatmapf,
-            int rbk_par,  //
-            std::function<OutV(OutV &, OutV &)> reducef) {
-      using emitter_t = ForwardingEmitter;
-      auto e = new emitter_t(fmap_par);
-      this->setEmitterF(e);
-      auto c = new ForwardingCollector(fmap_par);
-      this->setCollectorF(c);
-      std::vector<ff_node *> w;
-      for (int i = 0; i < fmap_par; ++i)
-        w.push_back(new Worker(flatmapf, rbk_par, reducef));
-      this->add_workers(w);
-      this->cleanup_all();
-    }
+    Worker(std::function<void(In &, pico::FlatMapCollector<Out> &)> &kernel_,
+           int rbk_par, std::function<OutV(OutV &, OutV &)> &reducef_kernel_,
+           unsigned mb_size_, size_t combiner_entries,
+           std::shared_ptr<pico::hot_key_set<OutK>> hot)
+        : base_shuffler(rbk_par),
+          collector(mb_size_),
+          map_kernel(kernel_),
+          combiner(rbk_par, reducef_kernel_, mb_size_, combiner_entries,
+                   hot) {}
 
-   private:
-    class Worker : public base_filter {
-     public:
-      Worker(
-          std::function<void(In &, pico::FlatMapCollector<Out> &)> &kernel_,  //
-          int rbk_par_, std::function<OutV(OutV &, OutV &)> &reducef_kernel_)
-          : map_kernel(kernel_),  //
-            rbk_par(rbk_par_),
-            rbk_f(reducef_kernel_) {}
-
-      void kernel(pico::base_microbatch *in_mb) {
-        /*
-         * got a microbatch to process and delete
-         */
-        auto in_microbatch = reinterpret_cast<mb_in *>(in_mb);
-        auto tag = in_mb->tag();
-
-        collector.tag(tag);
-
-        // iterate over microbatch
-        for (In &in : *in_microbatch) map_kernel(in, collector);
-
-        // partial reduce on all output micro-batches
-        auto &s(tag_state[tag]);
-        auto it = collector.begin();
-        while (it) {
-          /* reduce the micro-batch */
-          for (Out &kv : *it->mb) {
-            const OutK &k(kv.Key());
-            if (s.red_map.find(k) != s.red_map.end())
-              s.red_map[k] = rbk_f(kv.Value(), s.red_map[k]);
-            else
-              s.red_map[k] = kv.Value();
-          }
-
-          /* clean up and skip to the next micro-batch */
-          auto it_ = it;
-          it = it->next;
-          DELETE(it_->mb);
-          FREE(it_);
-        }
-
-        // clean up
-        DELETE(in_microbatch);
-        collector.clear();
-      }
+    void kernel(pico::base_microbatch *in_mb) {
+      /*
+       * got a microbatch to process and delete
+       */
+      auto in_microbatch = reinterpret_cast<mb_in *>(in_mb);
+      auto tag = in_mb->tag();
+
+      collector.tag(tag);
 
-      void cstream_end_callback(pico::base_microbatch::tag_t tag) {
-        std::vector<mb_out *> worker_mb;
-        for (unsigned wid = 0; wid < rbk_par; ++wid)
-          worker_mb.push_back(nullptr);
-        for (auto &kv : tag_state[tag].red_map) {
-          auto dst = key_to_worker(kv.first);
-          if (!worker_mb[dst]) worker_mb[dst] = NEW<mb_out>(tag, mb_size);
-          new (worker_mb[dst]->allocate()) Out(kv.first, kv.second);
-          worker_mb[dst]->commit();
-          if (worker_mb[dst]->full()) {
-            send_mb(worker_mb[dst]);
-            worker_mb[dst] = nullptr;
-          }
-        }
-
-        /* remainder */
-        for (auto mb : worker_mb)
-          if (mb) send_mb(mb);
+      // iterate over microbatch
+      for (In &in : *in_microbatch) map_kernel(in, collector);
+
+      // partial reduce on all output micro-batches
+      auto it = collector.begin();
+      while (it) {
+        /* combine the micro-batch */
+        combiner.reduce_mb(tag, it->mb, send_out());
+
+        /* clean up and skip to the next micro-batch */
+        auto it_ = it;
+        it = it->next;
+        DELETE(it_->mb);
+        FREE(it_);
       }
 
-     private:
-      typedef pico::Microbatch<TokenTypeIn> mb_in;
-      typedef pico::Microbatch<TokenTypeOut> mb_out;
-      typedef std::unordered_map<OutK, OutV> red_map_t;
-      int mb_size = pico::global_params.MICROBATCH_SIZE;
+      // clean up
+      DELETE(in_microbatch);
+      collector.clear();
+    }
+
+    void cstream_end_callback(pico::base_microbatch::tag_t tag) {
+      combiner.flush(tag, send_out());
+    }
 
-      pico::TokenCollector<Out> collector;
-      std::function<void(In &, pico::FlatMapCollector<Out> &)> map_kernel;
-      unsigned rbk_par;
-      std::function<OutV(OutV &, OutV &)> rbk_f;
+#ifdef TRACE_PICO
+    void ffStats(std::ostream &os) {
+      base_node::ffStats(os);
+      combiner.print_stats(os);
+    }
+#endif
 
-      struct tag_kv {
-        red_map_t red_map;
-      };
-      std::unordered_map<pico::base_microbatch::tag_t, tag_kv> tag_state;
+   private:
+    typedef pico::Microbatch<TokenTypeIn> mb_in;
+    typedef typename MapSideCombiner<TokenTypeOut>::mb_t mb_out;
 
-      inline size_t key_to_worker(const OutK &k) {
-        return std::hash<OutK>{}(k) % rbk_par;
-      }
-    };
+    pico::TokenCollector<Out> collector;
+    std::function<void(In &, pico::FlatMapCollector<Out> &)> map_kernel;
+    MapSideCombiner<TokenTypeOut> combiner;
+
+    inline auto send_out() {
+      return [this](mb_out *mb, unsigned dst) { send_mb_to(mb, dst); };
+    }
   };
 };
 
@@ -295,9 +262,16 @@ ff::ff_node *FMapPReduceBatch(
     int fmap_par,  //
     std::function<void(tkn_dt<TI> &, pico::FlatMapCollector<tkn_dt<TO>> &)> f,
     int red_par,  //
-    std::function<tkn_vt<TO>(tkn_vt<TO> &, tkn_vt<TO> &)> redf) {
-  if (red_par > 1) return new FMRBK_par_red<TI, TO>(fmap_par, f, red_par, redf);
-  return new FMRBK_seq_red<TI, TO>(fmap_par, f, redf);
+    std::function<tkn_vt<TO>(tkn_vt<TO> &, tkn_vt<TO> &)> redf,  //
+    unsigned fmap_mb_size = 0, unsigned red_mb_size = 0, size_t keys = 0,
+    size_t combiner_entries = 0,
+    pico::keyed_state_cfg state = {}) {
+  if (red_par > 1)
+    return new FMRBK_par_red<TI, TO>(fmap_par, f, red_par, redf, fmap_mb_size,
+                                     red_mb_size, keys, combiner_entries,
+                                     state);
+  return new FMRBK_seq_red<TI, TO>(fmap_par, f, redf, fmap_mb_size,
+                                   red_mb_size, keys, combiner_entries, state);
 }
 
 #endif /* INTERNALS_FFOPERATORS_FMAPPREDUCEBATCH_HPP_ */
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_INOUT_READFROMBINARYFILEFFNODE_HPP_
+#define INTERNALS_FFOPERATORS_INOUT_READFROMBINARYFILEFFNODE_HPP_
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <ff/farm.hpp>
+
+#include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
+#include "pico/Internals/Token.hpp"
+#include "pico/Internals/utils.hpp"
+#include "pico/ff_implementation/SupportFFNodes/farms.hpp"
+
+#include "pico/ff_implementation/SupportFFNodes/base_nodes.hpp"
+#include "pico/ff_implementation/ff_config.hpp"
+
+#include "binary_record.hpp"
+#include "mapped_range.hpp"
+
+/*
+ * range of records to be read
+ */
+struct record_range {
+  record_range(off_t begin_, off_t end_) : begin(begin_), end(end_) {}
+  off_t begin, end;
+};
+
+/*
+ * Opens a binary file and gets its number of records, exiting on failure.
+ */
+template <typename T>
+static inline int binary_open(const std::string &fname, off_t *n_records) {
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Unable to open input file %s\n", fname.c_str());
+    exit(1);
+  }
+  if (n_records) {
+    struct stat st;
+    fstat(fd, &st);
+    *n_records = st.st_size / binary_record<T>::size;
+    if (st.st_size % binary_record<T>::size)
+      fprintf(stderr, "Ignoring trailing partial record in %s\n",
+              fname.c_str());
+  }
+  return fd;
+}
+
+/*
+ * Reads a range of records from a mapping of the file straight into
+ * microbatch slots, calling send_f on each full microbatch.
+ */
+template <typename T, typename MB, typename SendF>
+static void read_records(int fd, off_t begin, off_t end, MB *&mb,
+                         pico::base_microbatch::tag_t tag,
+                         pico::MicrobatchSizer &sizer, SendF &&send_f) {
+  constexpr size_t rsize = binary_record<T>::size;
+  mapped_range range(fd, begin * rsize, end * rsize);
+  const char *p = range.data();
+  for (off_t i = begin; i < end; ++i, p += rsize) {
+    binary_record<T>::load(mb->allocate(), p);
+    mb->commit();
+    if (mb->full()) {
+      send_f(mb);
+      mb = NEW<MB>(tag, sizer.size());
+    }
+  }
+}
+
+/*
+ * A worker reading ranges of records.
+ */
+template <typename T>
+class binary_worker : public base_filter {
+  typedef pico::Microbatch<pico::Token<T>> mb_t;
+
+ public:
+  binary_worker(std::string fname, unsigned mb_size = 0)
+      : fd(binary_open<T>(fname, nullptr)), sizer(mb_size) {}
+
+  ~binary_worker() { close(fd); }
+
+  void kernel(pico::base_microbatch *wmb) {
+    auto r_ = reinterpret_cast<pico::mb_wrapped<record_range> *>(wmb);
+    auto tag = wmb->tag();
+    record_range *r = r_->get();
+    auto mb = NEW<mb_t>(tag, sizer.size());
+
+    read_records<T>(fd, r->begin, r->end, mb, tag, sizer,
+                    [&](mb_t *full) { send(full); });
+
+    /* remainder micro-batch */
+    if (!mb->empty())
+      send(mb);
+    else
+      DELETE(mb);
+
+    /* clean up */
+    DELETE(r);
+    DELETE(wmb);
+  }
+
+ private:
+  int fd;
+  pico::MicrobatchSizer sizer;
+
+  void send(mb_t *mb) {
+    sizer.send(mb->size(),
+               [&]() { ff_send_out(reinterpret_cast<void *>(mb)); });
+  }
+};
+
+/**
+ * The ReadFromBinaryFile non-ordering farm.
+ *
+ * The emitter partitions the file by record count, so that no parsing nor
+ * boundary search is needed.
+ */
+template <typename T>
+class ReadFromBinaryFileFFNode_par : public NonOrderingFarm {
+ public:
+  ReadFromBinaryFileFFNode_par(int parallelism, std::string fname,
+                               unsigned mb_size = 0) {
+    std::vector<ff_node *> workers;
+    for (int i = 0; i < parallelism; ++i)
+      workers.push_back(new binary_worker<T>(fname, mb_size));
+    this->setEmitterF(new RecordPartitioner(fname, parallelism));
+    this->add_workers(workers);
+    this->setCollectorF(new ForwardingCollector(parallelism));
+    this->cleanup_all();
+  }
+
+ private:
+  class RecordPartitioner : public base_emitter {
+   public:
+    RecordPartitioner(std::string fname, unsigned partitions_)
+        : base_emitter(partitions_), partitions(partitions_) {
+      close(binary_open<T>(fname, &n_records));
+    }
+
+    void begin_callback() {
+      /* get a fresh tag */
+      tag = pico::base_microbatch::fresh_tag();
+      begin_cstream(tag);
+
+      off_t pstep = (n_records + partitions - 1) / partitions;
+      for (off_t rbegin = 0; rbegin < n_records; rbegin += pstep) {
+        auto r = NEW<record_range>(rbegin, std::min(rbegin + pstep, n_records));
+        ff_send_out(NEW<pico::mb_wrapped<record_range>>(tag, r));
+      }
+
+      end_cstream(tag);
+    }
+
+    void kernel(pico::base_microbatch *) { assert(false); }
+
+   private:
+    unsigned partitions;
+    off_t n_records;
+    pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
+  };
+};
+
+/**
+ * Sequential ReadFromBinaryFile node.
+ */
+template <typename T>
+class ReadFromBinaryFileFFNode_seq : public base_filter {
+  typedef pico::Microbatch<pico::Token<T>> mb_t;
+
+ public:
+  ReadFromBinaryFileFFNode_seq(std::string fname, unsigned mb_size = 0)
+      : fd(binary_open<T>(fname, &n_records)), sizer(mb_size) {}
+
+  ~ReadFromBinaryFileFFNode_seq() { close(fd); }
+
+  void begin_callback() {
+    /* get a fresh tag */
+    tag = pico::base_microbatch::fresh_tag();
+    begin_cstream(tag);
+
+    mb_t *mb = NEW<mb_t>(tag, sizer.size());
+    read_records<T>(fd, 0, n_records, mb, tag, sizer, [&](mb_t *full) {
+      sizer.send(full->size(), [&]() { send_mb(full); });
+    });
+
+    /* send out the remainder micro-batch or destroy if spurious */
+    if (!mb->empty())
+      send_mb(mb);
+    else
+      DELETE(mb);
+
+    end_cstream(tag);
+  }
+
+  void kernel(pico::base_microbatch *) { assert(false); }
+
+ private:
+  pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
+  off_t n_records;
+  int fd;
+  pico::MicrobatchSizer sizer;
+};
+
+template <typename T>
+static ff::ff_node *ReadFromBinaryFileFFNode(int par, std::string fname,
+                                             unsigned mb_size = 0) {
+  if (par > 1)
+    return new ReadFromBinaryFileFFNode_par<T>(par, fname, mb_size);
+  assert(par == 1);
+  return new ReadFromBinaryFileFFNode_seq<T>(fname, mb_size);
+}
+
+#endif /* INTERNALS_FFOPERATORS_INOUT_READFROMBINARYFILEFFNODE_HPP_ */
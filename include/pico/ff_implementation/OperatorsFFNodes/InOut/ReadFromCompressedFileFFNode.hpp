@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_INOUT_READFROMCOMPRESSEDFILEFFNODE_HPP_
+#define INTERNALS_FFOPERATORS_INOUT_READFROMCOMPRESSEDFILEFFNODE_HPP_
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <ff/farm.hpp>
+
+#include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
+#include "pico/Internals/Token.hpp"
+#include "pico/Internals/utils.hpp"
+#include "pico/LineView.hpp"
+#include "pico/ff_implementation/SupportFFNodes/farms.hpp"
+
+#include "pico/ff_implementation/SupportFFNodes/base_nodes.hpp"
+#include "pico/ff_implementation/ff_config.hpp"
+
+#include "mapped_range.hpp"
+#include "zblock_file.hpp"
+
+/*
+ * Opens a block-compressed file and loads its index, exiting on failure.
+ */
+static inline int zblock_open(const std::string &fname,
+                              std::vector<zblock::entry> *index) {
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Unable to open input file %s\n", fname.c_str());
+    exit(1);
+  }
+  if (index && !zblock::read_index(fd, *index)) {
+    fprintf(stderr, "Invalid compressed input file %s\n", fname.c_str());
+    exit(1);
+  }
+  return fd;
+}
+
+/*
+ * A worker decompressing and splitting whole blocks.
+ */
+template <typename Line>
+class zblock_textfile : public base_filter {
+  typedef pico::Microbatch<pico::Token<Line>> mb_t;
+
+ public:
+  zblock_textfile(std::string fname, unsigned mb_size = 0)
+      : fd(zblock_open(fname, nullptr)), sizer(mb_size) {}
+
+  ~zblock_textfile() { close(fd); }
+
+  void kernel(pico::base_microbatch *wmb) {
+    auto e_ = reinterpret_cast<pico::mb_wrapped<zblock::entry> *>(wmb);
+    auto tag = wmb->tag();
+    zblock::entry *e = e_->get();
+    auto mb = NEW<mb_t>(tag, sizer.size());
+
+    auto blk = zblock::read_block(fd, *e, cbuf);
+    zblock::for_each_line(blk, e->size, [&](pico::line_block *b,
+                                            const char *p, size_t len) {
+      build_line(mb->allocate(), b, p, len);
+      mb->commit();
+      if (mb->full()) {
+        send(mb);
+        mb = NEW<mb_t>(tag, sizer.size());
+      }
+    });
+    blk->unref();
+
+    /* remainder micro-batch */
+    if (!mb->empty())
+      send(mb);
+    else
+      DELETE(mb);
+
+    /* clean up */
+    DELETE(e);
+    DELETE(wmb);
+  }
+
+ private:
+  int fd;
+  std::string cbuf;  // compressed block buffer
+  pico::MicrobatchSizer sizer;
+
+  void send(mb_t *mb) {
+    sizer.send(mb->size(),
+               [&]() { ff_send_out(reinterpret_cast<void *>(mb)); });
+  }
+};
+
+/**
+ * The ReadFromCompressedFile non-ordering farm.
+ *
+ * The emitter hands out single blocks, taken from the file index, so that
+ * workers decompress and tokenize in parallel.
+ */
+template <typename Line>
+class ReadFromCompressedFileFFNode_par : public NonOrderingFarm {
+ public:
+  ReadFromCompressedFileFFNode_par(int parallelism, std::string fname,
+                                   unsigned mb_size = 0) {
+    std::vector<ff_node *> workers;
+    for (int i = 0; i < parallelism; ++i)
+      workers.push_back(new zblock_textfile<Line>(fname, mb_size));
+    this->setEmitterF(new BlockPartitioner(fname, parallelism));
+    this->add_workers(workers);
+    this->setCollectorF(new ForwardingCollector(parallelism));
+    this->cleanup_all();
+  }
+
+ private:
+  class BlockPartitioner : public base_emitter {
+   public:
+    BlockPartitioner(std::string fname, unsigned nworkers)
+        : base_emitter(nworkers) {
+      close(zblock_open(fname, &index));
+    }
+
+    void begin_callback() {
+      /* get a fresh tag */
+      tag = pico::base_microbatch::fresh_tag();
+      begin_cstream(tag);
+
+      for (auto &e : index) {
+        auto ep = NEW<zblock::entry>(e);
+        ff_send_out(NEW<pico::mb_wrapped<zblock::entry>>(tag, ep));
+      }
+
+      end_cstream(tag);
+    }
+
+    void kernel(pico::base_microbatch *) { assert(false); }
+
+   private:
+    std::vector<zblock::entry> index;
+    pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
+  };
+};
+
+/**
+ * Sequential ReadFromCompressedFile node.
+ */
+template <typename Line>
+class ReadFromCompressedFileFFNode_seq : public base_filter {
+  typedef pico::Microbatch<pico::Token<Line>> mb_t;
+
+ public:
+  ReadFromCompressedFileFFNode_seq(std::string fname, unsigned mb_size = 0)
+      : fd(zblock_open(fname, &index)), sizer(mb_size) {}
+
+  ~ReadFromCompressedFileFFNode_seq() { close(fd); }
+
+  void begin_callback() {
+    /* get a fresh tag */
+    tag = pico::base_microbatch::fresh_tag();
+    begin_cstream(tag);
+
+    mb_t *mb = NEW<mb_t>(tag, sizer.size());
+    std::string cbuf;
+    for (auto &e : index) {
+      auto blk = zblock::read_block(fd, e, cbuf);
+      zblock::for_each_line(blk, e.size, [&](pico::line_block *b,
+                                             const char *p, size_t len) {
+        build_line(mb->allocate(), b, p, len);
+        mb->commit();
+        /* send out micro-batch if complete */
+        if (mb->full()) {
+          sizer.send(mb->size(), [&]() { send_mb(mb); });
+          mb = NEW<mb_t>(tag, sizer.size());
+        }
+      });
+      blk->unref();
+    }
+
+    /* send out the remainder micro-batch or destroy if spurious */
+    if (!mb->empty())
+      send_mb(mb);
+    else
+      DELETE(mb);
+
+    end_cstream(tag);
+  }
+
+  void kernel(pico::base_microbatch *) { assert(false); }
+
+ private:
+  pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
+  std::vector<zblock::entry> index;
+  int fd;
+  pico::MicrobatchSizer sizer;
+};
+
+template <typename Line>
+static ff::ff_node *ReadFromCompressedFileFFNode(int par, std::string fname,
+                                                 unsigned mb_size = 0) {
+  if (par > 1)
+    return new ReadFromCompressedFileFFNode_par<Line>(par, fname, mb_size);
+  assert(par == 1);
+  return new ReadFromCompressedFileFFNode_seq<Line>(fname, mb_size);
+}
+
+#endif /* INTERNALS_FFOPERATORS_INOUT_READFROMCOMPRESSEDFILEFFNODE_HPP_ */
@@ -21,21 +21,35 @@
 #ifndef INTERNALS_FFOPERATORS_INOUT_READFROMFILEFFNODE_HPP_
 #define INTERNALS_FFOPERATORS_INOUT_READFROMFILEFFNODE_HPP_
 
-#include <cmath>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <type_traits>
+#ifdef TRACE_PICO
+#include <chrono>
+#endif
 
 #include <ff/farm.hpp>
 
 #include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
 #include "pico/Internals/Token.hpp"
 #include "pico/Internals/utils.hpp"
+#include "pico/LineView.hpp"
 #include "pico/ff_implementation/SupportFFNodes/farms.hpp"
 
 #include "pico/ff_implementation/SupportFFNodes/base_nodes.hpp"
 #include "pico/ff_implementation/ff_config.hpp"
 
+#include "async_reader.hpp"
+#include "line_splitter.hpp"
+#include "mapped_range.hpp"
+
 /*
  *******************************************************************************
  * some variants of reading a text file line by line
@@ -46,6 +60,27 @@
  */
 #define BUFFERING_PAGES 4
 
+/*
+ * Default size of the chunks handed out to parallel readers.
+ */
+#define FILE_CHUNK_SIZE (1 << 23)
+
+/*
+ * options for reading a file, set by the ReadFromFile operator
+ */
+struct file_read_opts {
+  /* memory-mapped reading */
+  bool mapped = false;
+  /* asynchronous reads in flight (zero for synchronous reading) */
+  unsigned aio_depth = 0;
+  /* size of each asynchronous read */
+  size_t aio_block = ASYNC_IO_BLOCK_SIZE;
+  /* direct (i.e., O_DIRECT) asynchronous reads */
+  bool direct = false;
+  /* size of the chunks handed out to parallel readers */
+  size_t chunk_size = FILE_CHUNK_SIZE;
+};
+
 /*
  * file-range to be read
  */
@@ -69,7 +104,8 @@ class getline_textfile : public base_filter {
   typedef pico::Microbatch<pico::Token<std::string>> mb_t;
 
  public:
-  getline_textfile(std::string fname_) : file(fname_) {
+  getline_textfile(std::string fname_, unsigned mb_size = 0)
+      : file(fname_), sizer(mb_size) {
     assert(file.is_open());
   }
 
@@ -78,7 +114,7 @@ class getline_textfile : public base_filter {
     auto tag = in_mb->tag();
     prange *r = (prange *)wmb->get();
     file.seekg(r->begin);
-    mb_t *mb = NEW<mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
+    mb_t *mb = NEW<mb_t>(tag, sizer.size());
     while (true) {
       auto pos = file.tellg();
       if (pos < r->end && pos != -1) {
@@ -89,8 +125,8 @@ class getline_textfile : public base_filter {
           mb->commit();
           /* create next micro-batch if complete */
           if (mb->full()) {
-            ff_send_out(reinterpret_cast<void *>(mb));
-            mb = NEW<mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
+            send(mb);
+            mb = NEW<mb_t>(tag, sizer.size());
           }
         } else
           assert(false);
@@ -104,7 +140,7 @@ class getline_textfile : public base_filter {
 
     /* remainder micro-batch */
     if (!mb->empty())
-      ff_send_out(reinterpret_cast<void *>(mb));
+      send(mb);
     else
       DELETE(mb);
 
@@ -115,6 +151,12 @@ class getline_textfile : public base_filter {
 
  private:
   std::ifstream file;
+  pico::MicrobatchSizer sizer;
+
+  void send(mb_t *mb) {
+    sizer.send(mb->size(),
+               [&]() { ff_send_out(reinterpret_cast<void *>(mb)); });
+  }
 };
 
 /*
@@ -129,7 +171,7 @@ class read_textfile : public base_filter {
   typedef pico::Microbatch<pico::Token<std::string>> mb_t;
 
  public:
-  read_textfile(std::string fname) {
+  read_textfile(std::string fname, unsigned mb_size = 0) : sizer(mb_size) {
     fd = fopen(fname.c_str(), "rb");
     assert(fd);
     bufsize = BUFFERING_PAGES * getpagesize();
@@ -147,7 +189,7 @@ class read_textfile : public base_filter {
     prange *r = (prange *)r_->get();
     fseek(fd, r->begin, SEEK_SET);
     ssize_t remainder = r->end - r->begin;
-    auto mb = NEW<mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
+    auto mb = NEW<mb_t>(tag, sizer.size());
     std::string *line = new (mb->allocate()) std::string();
     bool continued = false;
     do {
@@ -163,8 +205,8 @@ class read_textfile : public base_filter {
             mb->commit();
             /* create next micro-batch if complete */
             if (mb->full()) {
-              ff_send_out(reinterpret_cast<void *>(mb));
-              mb = NEW<mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
+              send(mb);
+              mb = NEW<mb_t>(tag, sizer.size());
             }
             line = new (mb->allocate()) std::string();
           }
@@ -189,7 +231,7 @@ class read_textfile : public base_filter {
 
     /* remainder micro-batch */
     if (!mb->empty())
-      ff_send_out(reinterpret_cast<void *>(mb));
+      send(mb);
     else
       DELETE(mb);
 
@@ -202,24 +244,271 @@ class read_textfile : public base_filter {
   FILE *fd;
   ssize_t bufsize;
   char *buf;
+  pico::MicrobatchSizer sizer;
+
+  void send(mb_t *mb) {
+    sizer.send(mb->size(),
+               [&]() { ff_send_out(reinterpret_cast<void *>(mb)); });
+  }
+};
+
+/*
+ *******************************************************************************
+ * LineView-based implementation.
+ *
+ * The file range is read by large shared blocks (positional reads), and each
+ * line is emitted as a LineView pointing into its block, with no per-line
+ * allocation or copy.
+ *******************************************************************************
+ */
+class lineview_textfile : public base_filter {
+  typedef pico::Microbatch<pico::Token<pico::LineView>> mb_t;
+
+ public:
+  lineview_textfile(std::string fname, unsigned mb_size = 0) : sizer(mb_size) {
+    fd = open(fname.c_str(), O_RDONLY);
+    assert(fd >= 0);
+  }
+
+  ~lineview_textfile() { close(fd); }
+
+  void kernel(pico::base_microbatch *wmb) {
+    auto r_ = reinterpret_cast<pico::mb_wrapped<prange> *>(wmb);
+    auto tag = wmb->tag();
+    prange *r = (prange *)r_->get();
+    off_t pos = r->begin;
+    auto mb = NEW<mb_t>(tag, sizer.size());
+
+    auto read_f = [&](char *buf, size_t count) -> ssize_t {
+      size_t len = std::min<off_t>(count, r->end - pos);
+      if (!len) return 0;
+      ssize_t res = pread(fd, buf, len, pos);
+      if (res > 0) pos += res;
+      return res;
+    };
+    auto line_f = [&](pico::line_block *blk, const char *p, size_t len) {
+      new (mb->allocate()) pico::LineView(blk, p, len);
+      mb->commit();
+      if (mb->full()) {
+        send(mb);
+        mb = NEW<mb_t>(tag, sizer.size());
+      }
+    };
+    /* one extra byte for detecting the end of a fitting range */
+    size_t range = r->end - r->begin;
+    split_lines('\n', read_f, line_f,
+                std::min<size_t>(LINE_BLOCK_SIZE, range + 1));
+    assert(pos == r->end);
+
+    /* remainder micro-batch */
+    if (!mb->empty())
+      send(mb);
+    else
+      DELETE(mb);
+
+    /* clean up */
+    DELETE(r);
+    DELETE(wmb);
+  }
+
+ private:
+  int fd;
+  pico::MicrobatchSizer sizer;
+
+  void send(mb_t *mb) {
+    sizer.send(mb->size(),
+               [&]() { ff_send_out(reinterpret_cast<void *>(mb)); });
+  }
+};
+
+/*
+ *******************************************************************************
+ * mmap-based implementation.
+ *
+ * The file range is memory-mapped and scanned in place, with no intermediate
+ * buffering. LineView lines point directly into the mapping, that is released
+ * with the last line.
+ *******************************************************************************
+ */
+template <typename Line>
+class mmap_textfile : public base_filter {
+  typedef pico::Microbatch<pico::Token<Line>> mb_t;
+
+ public:
+  mmap_textfile(std::string fname, unsigned mb_size = 0) : sizer(mb_size) {
+    fd = open(fname.c_str(), O_RDONLY);
+    assert(fd >= 0);
+  }
+
+  ~mmap_textfile() { close(fd); }
+
+  void kernel(pico::base_microbatch *wmb) {
+    auto r_ = reinterpret_cast<pico::mb_wrapped<prange> *>(wmb);
+    auto tag = wmb->tag();
+    prange *r = (prange *)r_->get();
+    auto mb = NEW<mb_t>(tag, sizer.size());
+
+    mapped_range range(fd, r->begin, r->end);
+    range.for_each_line('\n', [&](pico::line_block *blk, const char *p,
+                                  size_t len) {
+      build_line(mb->allocate(), blk, p, len);
+      mb->commit();
+      if (mb->full()) {
+        send(mb);
+        mb = NEW<mb_t>(tag, sizer.size());
+      }
+    });
+
+    /* remainder micro-batch */
+    if (!mb->empty())
+      send(mb);
+    else
+      DELETE(mb);
+
+    /* clean up */
+    DELETE(r);
+    DELETE(wmb);
+  }
+
+ private:
+  int fd;
+  pico::MicrobatchSizer sizer;
+
+  void send(mb_t *mb) {
+    sizer.send(mb->size(),
+               [&]() { ff_send_out(reinterpret_cast<void *>(mb)); });
+  }
+};
+
+/*
+ *******************************************************************************
+ * Asynchronous implementation.
+ *
+ * The file range is read ahead by a number of large reads in flight (see
+ * async_reader), and filled blocks are split into lines as they complete, so
+ * that the worker parses while the device reads.
+ *******************************************************************************
+ */
+template <typename Line>
+class aio_textfile : public base_filter {
+  typedef pico::Microbatch<pico::Token<Line>> mb_t;
+
+ public:
+  aio_textfile(std::string fname, unsigned mb_size, file_read_opts opts_)
+      : opts(opts_), sizer(mb_size) {
+    fd = async_open(fname.c_str(), opts.direct);
+    assert(fd >= 0);
+  }
+
+  ~aio_textfile() { close(fd); }
+
+  void kernel(pico::base_microbatch *wmb) {
+    auto r_ = reinterpret_cast<pico::mb_wrapped<prange> *>(wmb);
+    auto tag = wmb->tag();
+    prange *r = (prange *)r_->get();
+    auto mb = NEW<mb_t>(tag, sizer.size());
+
+    async_reader reader(fd, r->begin, r->end, opts.aio_depth, opts.aio_block,
+                        opts.direct);
+    auto next_f = [&](char *&p, size_t &len) { return reader.next(p, len); };
+    auto line_f = [&](pico::line_block *blk, const char *p, size_t len) {
+      build_line(mb->allocate(), blk, p, len);
+      mb->commit();
+      if (mb->full()) {
+        send(mb);
+        mb = NEW<mb_t>(tag, sizer.size());
+      }
+    };
+    split_blocks('\n', next_f, line_f);
+
+    /* remainder micro-batch */
+    if (!mb->empty())
+      send(mb);
+    else
+      DELETE(mb);
+
+    /* clean up */
+    DELETE(r);
+    DELETE(wmb);
+  }
+
+ private:
+  int fd;
+  file_read_opts opts;
+  pico::MicrobatchSizer sizer;
+
+  void send(mb_t *mb) {
+    sizer.send(mb->size(),
+               [&]() { ff_send_out(reinterpret_cast<void *>(mb)); });
+  }
 };
 
+#ifdef TRACE_PICO
+/*
+ * Decorates a worker with per-chunk timings.
+ */
+template <typename Worker>
+class chunk_timed : public Worker {
+ public:
+  using Worker::Worker;
+
+  void kernel(pico::base_microbatch *wmb) {
+    auto t0 = std::chrono::high_resolution_clock::now();
+    Worker::kernel(wmb);
+    std::chrono::duration<double, std::milli> d =
+        std::chrono::high_resolution_clock::now() - t0;
+    min_ms = chunks ? std::min(min_ms, d.count()) : d.count();
+    max_ms = std::max(max_ms, d.count());
+    sum_ms += d.count();
+    ++chunks;
+  }
+
+  void ffStats(std::ostream &os) {
+    base_node::ffStats(os);
+    os << "  PICO-chunks   : " << chunks << "\n";
+    if (chunks)
+      os << "  PICO-chunk ms : " << min_ms << " min, " << sum_ms / chunks
+         << " avg, " << max_ms << " max\n";
+  }
+
+ private:
+  unsigned long chunks = 0;
+  double min_ms = 0, max_ms = 0, sum_ms = 0;
+};
+#endif
+
 /**
  * The ReadFromFile non-ordering farm.
+ *
+ * The Worker implements line-based file reading (e.g., getline_textfile or
+ * read_textfile for std::string lines, lineview_textfile for LineView lines,
+ * mmap_textfile and aio_textfile for both).
+ * Further arguments are forwarded to the workers.
+ *
+ * The file is cut into many line-aligned chunks, that idle workers pull on
+ * demand, so that a slow chunk (e.g., with long lines or not cached) does not
+ * stall the others.
  */
+template <typename Worker>
 class ReadFromFileFFNode_par : public NonOrderingFarm {
-  /* select implementation for line-based file reading */
-  using Worker = getline_textfile;
-  // using Worker = read_textfile;
-
  public:
-  ReadFromFileFFNode_par(int parallelism, std::string fname_) : fname(fname_) {
+  template <typename... Args>
+  ReadFromFileFFNode_par(int parallelism, std::string fname_,
+                         unsigned mb_size = 0,
+                         size_t chunk_size = FILE_CHUNK_SIZE, Args... args)
+      : fname(fname_) {
     std::vector<ff_node *> workers;
-    for (int i = 0; i < parallelism; ++i) workers.push_back(new Worker(fname));
-    auto e = new Partitioner(*this, fname, parallelism);
+    for (int i = 0; i < parallelism; ++i)
+#ifdef TRACE_PICO
+      workers.push_back(new chunk_timed<Worker>(fname, mb_size, args...));
+#else
+      workers.push_back(new Worker(fname, mb_size, args...));
+#endif
+    auto e = new Partitioner(*this, fname, parallelism, chunk_size);
     this->setEmitterF(e);
     this->add_workers(workers);
     this->setCollectorF(new ForwardingCollector(parallelism));
+    this->set_scheduling_ondemand();
     this->cleanup_all();
   }
 
@@ -230,14 +519,15 @@ class ReadFromFileFFNode_par : public NonOrderingFarm {
   class Partitioner : public base_emitter {
    public:
     Partitioner(const NonOrderingFarm &f_, std::string fname,
-                unsigned partitions_)
+                unsigned partitions_, size_t chunk_size_)
         : base_emitter(partitions_),  //
-          partitions(partitions_) {
-      fd = fopen(fname.c_str(), "rb");
-      assert(fd);  // todo - better reporting
+          partitions(partitions_),
+          chunk_size(chunk_size_) {
+      fd = open(fname.c_str(), O_RDONLY);
+      assert(fd >= 0);  // todo - better reporting
     }
 
-    ~Partitioner() { fclose(fd); }
+    ~Partitioner() { close(fd); }
 
     void begin_callback() {
       /* get a fresh tag */
@@ -245,31 +535,18 @@ class ReadFromFileFFNode_par : public NonOrderingFarm {
       begin_cstream(tag);
 
       /* get file size */
-      fseek(fd, 0, SEEK_END);
-      off_t fsize = ftell(fd);
-      off_t pstep = (off_t)std::ceil((float)fsize / partitions);
-      off_t rbegin = 0, rend;
-      char buf;
-      for (unsigned p = 0; p < partitions - 1 && rbegin < fsize; ++p) {
-        /* search for first \n after partition boundary (or EOF) */
-        rend = (p + 1) * pstep;
-
-        if (rend < fsize) {
-          /* rend within file boundary */
-          fseek(fd, rend - 1, SEEK_SET);
-          while ((buf = getc(fd))) {
-            if (buf == '\n') break;
-            ++rend;
-          }
-          if (rend > rbegin) {
-            wrap_and_send(NEW<prange>(rbegin, rend));
-            rbegin = rend;
-          }
-        } else
-          /* rend beyond file boundary */
-          break;
-      }
-      if (fsize > rbegin) wrap_and_send(NEW<prange>(rbegin, fsize));
+      struct stat st;
+      fstat(fd, &st);
+      off_t fsize = st.st_size;
+      /* no fewer chunks than workers, for small files */
+      off_t pstep = (fsize + partitions - 1) / partitions;
+      pstep = std::max<off_t>(std::min<off_t>(pstep, chunk_size), 1);
+
+      /* split points are searched directly on a mapping of the file */
+      mapped_range file(fd, 0, fsize, false);
+      file.for_each_chunk('\n', pstep, [&](off_t begin, off_t end) {
+        wrap_and_send(NEW<prange>(begin, end));
+      });
 
       end_cstream(tag);
     }
@@ -277,8 +554,9 @@ class ReadFromFileFFNode_par : public NonOrderingFarm {
     void kernel(pico::base_microbatch *) { assert(false); }
 
    private:
-    FILE *fd;
+    int fd;
     unsigned partitions;
+    size_t chunk_size;
     pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
 
     void wrap_and_send(prange *p) {
@@ -297,7 +575,8 @@ class ReadFromFileFFNode_seq : public base_filter {
   typedef pico::Microbatch<pico::Token<std::string>> mb_t;
 
  public:
-  ReadFromFileFFNode_seq(std::string fname_) : infile(fname_) {
+  ReadFromFileFFNode_seq(std::string fname_, unsigned mb_size = 0)
+      : infile(fname_), sizer(mb_size) {
     if (!infile.is_open()) {
       fprintf(stderr, "Unable to open input file %s\n", fname_.c_str());
       exit(1);
@@ -310,7 +589,7 @@ class ReadFromFileFFNode_seq : public base_filter {
     begin_cstream(tag);
 
     std::string line;
-    mb_t *mb = NEW<mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
+    mb_t *mb = NEW<mb_t>(tag, sizer.size());
     while (true) {
       /* initialize a new string within the micro-batch */
       std::string *line = new (mb->allocate()) std::string();
@@ -320,8 +599,8 @@ class ReadFromFileFFNode_seq : public base_filter {
         mb->commit();
         /* send out micro-batch if complete */
         if (mb->full()) {
-          send_mb(mb);
-          mb = NEW<mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
+          sizer.send(mb->size(), [&]() { send_mb(mb); });
+          mb = NEW<mb_t>(tag, sizer.size());
         }
       } else
         break;
@@ -343,12 +622,217 @@ class ReadFromFileFFNode_seq : public base_filter {
   pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
   std::string fname;
   std::ifstream infile;
+  pico::MicrobatchSizer sizer;
+};
+
+/**
+ * Sequential mmap-based ReadFromFile node.
+ */
+template <typename Line>
+class ReadFromFileFFNode_seq_mmap : public base_filter {
+  typedef pico::Microbatch<pico::Token<Line>> mb_t;
+
+ public:
+  ReadFromFileFFNode_seq_mmap(std::string fname_, unsigned mb_size = 0)
+      : sizer(mb_size) {
+    fd = open(fname_.c_str(), O_RDONLY);
+    if (fd < 0) {
+      fprintf(stderr, "Unable to open input file %s\n", fname_.c_str());
+      exit(1);
+    }
+  }
+
+  ~ReadFromFileFFNode_seq_mmap() { close(fd); }
+
+  void begin_callback() {
+    /* get a fresh tag */
+    tag = pico::base_microbatch::fresh_tag();
+    begin_cstream(tag);
+
+    struct stat st;
+    fstat(fd, &st);
+    mb_t *mb = NEW<mb_t>(tag, sizer.size());
+    {
+      mapped_range file(fd, 0, st.st_size);
+      file.for_each_line('\n', [&](pico::line_block *blk, const char *p,
+                                   size_t len) {
+        build_line(mb->allocate(), blk, p, len);
+        mb->commit();
+        /* send out micro-batch if complete */
+        if (mb->full()) {
+          sizer.send(mb->size(), [&]() { send_mb(mb); });
+          mb = NEW<mb_t>(tag, sizer.size());
+        }
+      });
+    }
+
+    /* send out the remainder micro-batch or destroy if spurious */
+    if (!mb->empty())
+      send_mb(mb);
+    else
+      DELETE(mb);
+
+    end_cstream(tag);
+  }
+
+  void kernel(pico::base_microbatch *) { assert(false); }
+
+ private:
+  pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
+  int fd;
+  pico::MicrobatchSizer sizer;
+};
+
+/**
+ * Sequential asynchronous ReadFromFile node.
+ */
+template <typename Line>
+class ReadFromFileFFNode_seq_aio : public base_filter {
+  typedef pico::Microbatch<pico::Token<Line>> mb_t;
+
+ public:
+  ReadFromFileFFNode_seq_aio(std::string fname_, unsigned mb_size,
+                             file_read_opts opts_)
+      : opts(opts_), sizer(mb_size) {
+    fd = async_open(fname_.c_str(), opts.direct);
+    if (fd < 0) {
+      fprintf(stderr, "Unable to open input file %s\n", fname_.c_str());
+      exit(1);
+    }
+  }
+
+  ~ReadFromFileFFNode_seq_aio() { close(fd); }
+
+  void begin_callback() {
+    /* get a fresh tag */
+    tag = pico::base_microbatch::fresh_tag();
+    begin_cstream(tag);
+
+    struct stat st;
+    fstat(fd, &st);
+    mb_t *mb = NEW<mb_t>(tag, sizer.size());
+    {
+      async_reader reader(fd, 0, st.st_size, opts.aio_depth, opts.aio_block,
+                          opts.direct);
+      auto next_f = [&](char *&p, size_t &len) { return reader.next(p, len); };
+      auto line_f = [&](pico::line_block *blk, const char *p, size_t len) {
+        build_line(mb->allocate(), blk, p, len);
+        mb->commit();
+        /* send out micro-batch if complete */
+        if (mb->full()) {
+          sizer.send(mb->size(), [&]() { send_mb(mb); });
+          mb = NEW<mb_t>(tag, sizer.size());
+        }
+      };
+      split_blocks('\n', next_f, line_f);
+    }
+
+    /* send out the remainder micro-batch or destroy if spurious */
+    if (!mb->empty())
+      send_mb(mb);
+    else
+      DELETE(mb);
+
+    end_cstream(tag);
+  }
+
+  void kernel(pico::base_microbatch *) { assert(false); }
+
+ private:
+  pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
+  int fd;
+  file_read_opts opts;
+  pico::MicrobatchSizer sizer;
+};
+
+/**
+ * Sequential ReadFromFile node, producing LineView lines.
+ */
+class ReadFromFileFFNode_seq_lv : public base_filter {
+  typedef pico::Microbatch<pico::Token<pico::LineView>> mb_t;
+
+ public:
+  ReadFromFileFFNode_seq_lv(std::string fname_, unsigned mb_size = 0)
+      : sizer(mb_size) {
+    fd = open(fname_.c_str(), O_RDONLY);
+    if (fd < 0) {
+      fprintf(stderr, "Unable to open input file %s\n", fname_.c_str());
+      exit(1);
+    }
+  }
+
+  void begin_callback() {
+    /* get a fresh tag */
+    tag = pico::base_microbatch::fresh_tag();
+    begin_cstream(tag);
+
+    mb_t *mb = NEW<mb_t>(tag, sizer.size());
+    auto read_f = [&](char *buf, size_t count) { return read(fd, buf, count); };
+    auto line_f = [&](pico::line_block *blk, const char *p, size_t len) {
+      new (mb->allocate()) pico::LineView(blk, p, len);
+      mb->commit();
+      /* send out micro-batch if complete */
+      if (mb->full()) {
+        sizer.send(mb->size(), [&]() { send_mb(mb); });
+        mb = NEW<mb_t>(tag, sizer.size());
+      }
+    };
+    split_lines('\n', read_f, line_f);
+    close(fd);
+
+    /* send out the remainder micro-batch or destroy if spurious */
+    if (!mb->empty())
+      send_mb(mb);
+    else
+      DELETE(mb);
+
+    end_cstream(tag);
+  }
+
+  void kernel(pico::base_microbatch *) { assert(false); }
+
+ private:
+  pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
+  int fd;
+  pico::MicrobatchSizer sizer;
 };
 
-static ff::ff_node *ReadFromFileFFNode(int par, std::string fname) {
-  if (par > 1) return new ReadFromFileFFNode_par(par, fname);
+template <typename Line>
+static ff::ff_node *ReadFromFileFFNode(int par, std::string fname,
+                                       unsigned mb_size = 0,
+                                       file_read_opts opts = {}) {
+  if (opts.aio_depth) {
+    if (par > 1)
+      return new ReadFromFileFFNode_par<aio_textfile<Line>>(
+          par, fname, mb_size, opts.chunk_size, opts);
+    assert(par == 1);
+    return new ReadFromFileFFNode_seq_aio<Line>(fname, mb_size, opts);
+  }
+
+  if (opts.mapped) {
+    if (par > 1)
+      return new ReadFromFileFFNode_par<mmap_textfile<Line>>(
+          par, fname, mb_size, opts.chunk_size);
+    assert(par == 1);
+    return new ReadFromFileFFNode_seq_mmap<Line>(fname, mb_size);
+  }
+
+  if constexpr (std::is_same<Line, pico::LineView>::value) {
+    if (par > 1)
+      return new ReadFromFileFFNode_par<lineview_textfile>(
+          par, fname, mb_size, opts.chunk_size);
+    assert(par == 1);
+    return new ReadFromFileFFNode_seq_lv(fname, mb_size);
+  }
+
+  /* select implementation for line-based file reading */
+  using Worker = getline_textfile;
+  // using Worker = read_textfile;
+  if (par > 1)
+    return new ReadFromFileFFNode_par<Worker>(par, fname, mb_size,
+                                              opts.chunk_size);
   assert(par == 1);
-  return new ReadFromFileFFNode_seq(fname);
+  return new ReadFromFileFFNode_seq(fname, mb_size);
 }
 
 #endif /* INTERNALS_FFOPERATORS_INOUT_READFROMFILEFFNODE_HPP_ */
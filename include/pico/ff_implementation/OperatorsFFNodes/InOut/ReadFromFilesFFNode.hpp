@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_INOUT_READFROMFILESFFNODE_HPP_
+#define INTERNALS_FFOPERATORS_INOUT_READFROMFILESFFNODE_HPP_
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <ff/farm.hpp>
+
+#include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
+#include "pico/Internals/Token.hpp"
+#include "pico/Internals/utils.hpp"
+#include "pico/LineView.hpp"
+#include "pico/ff_implementation/SupportFFNodes/collectors.hpp"
+#include "pico/ff_implementation/SupportFFNodes/farms.hpp"
+
+#include "pico/ff_implementation/SupportFFNodes/base_nodes.hpp"
+#include "pico/ff_implementation/ff_config.hpp"
+
+#include "mapped_range.hpp"
+
+/*
+ * Bounds on the size of the work units of multi-file reading.
+ */
+#define FILES_MIN_SPLIT (1 << 20)
+#define FILES_MAX_SPLIT (1 << 26)
+
+/*
+ * Expands input specifications into a list of regular files, each one being:
+ * - a directory, standing for its files (except hidden ones, e.g., _SUCCESS)
+ * - a glob pattern
+ * - a file name
+ */
+static std::vector<std::string> expand_inputs(
+    const std::vector<std::string> &inputs) {
+  std::vector<std::string> res;
+  struct stat st;
+  for (auto &in : inputs) {
+    if (!stat(in.c_str(), &st) && S_ISDIR(st.st_mode)) {
+      std::vector<std::string> dir_files;
+      DIR *dir = opendir(in.c_str());
+      for (dirent *e; dir && (e = readdir(dir));) {
+        if (e->d_name[0] == '.' || e->d_name[0] == '_') continue;
+        auto path = in + "/" + e->d_name;
+        if (!stat(path.c_str(), &st) && S_ISREG(st.st_mode))
+          dir_files.push_back(path);
+      }
+      if (dir) closedir(dir);
+      std::sort(dir_files.begin(), dir_files.end());
+      res.insert(res.end(), dir_files.begin(), dir_files.end());
+    } else if (in.find_first_of("*?[") != std::string::npos) {
+      glob_t g;
+      if (!glob(in.c_str(), 0, nullptr, &g))
+        for (size_t i = 0; i < g.gl_pathc; ++i)
+          if (!stat(g.gl_pathv[i], &st) && S_ISREG(st.st_mode))
+            res.push_back(g.gl_pathv[i]);
+      globfree(&g);
+    } else
+      res.push_back(in);
+  }
+  return res;
+}
+
+/*
+ * Opens an input file for reading, exiting on failure.
+ */
+static inline int open_input(const std::string &fname) {
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Unable to open input file %s: %s\n", fname.c_str(),
+            strerror(errno));
+    exit(1);
+  }
+  return fd;
+}
+
+/*
+ * file-range to be read, out of a list of files
+ */
+struct frange {
+  frange(unsigned file_, off_t begin_, off_t end_)
+      : file(file_), begin(begin_), end(end_) {}
+  unsigned file;
+  off_t begin, end;
+};
+
+/*
+ * A worker reading ranges of any of the files, through memory mappings.
+ *
+ * Since mappings outlive their descriptors, a worker keeps a single file open
+ * at a time, i.e., the one of the last range (the ranges of a file being
+ * scheduled one after the other).
+ */
+template <typename Line>
+class files_textfile : public base_filter {
+  typedef pico::Microbatch<pico::Token<Line>> mb_t;
+
+ public:
+  files_textfile(const std::vector<std::string> &files_, unsigned mb_size = 0)
+      : files(files_), sizer(mb_size) {}
+
+  ~files_textfile() { close_file(); }
+
+  void cstream_end_callback(pico::base_microbatch::tag_t) { close_file(); }
+
+  void kernel(pico::base_microbatch *wmb) {
+    auto r_ = reinterpret_cast<pico::mb_wrapped<frange> *>(wmb);
+    auto tag = wmb->tag();
+    frange *r = r_->get();
+    auto mb = NEW<mb_t>(tag, sizer.size());
+
+    mapped_range range(file_fd(r->file), r->begin, r->end);
+    range.for_each_line('\n', [&](pico::line_block *blk, const char *p,
+                                  size_t len) {
+      build_line(mb->allocate(), blk, p, len);
+      mb->commit();
+      if (mb->full()) {
+        send(mb);
+        mb = NEW<mb_t>(tag, sizer.size());
+      }
+    });
+
+    /* remainder micro-batch */
+    if (!mb->empty())
+      send(mb);
+    else
+      DELETE(mb);
+
+    /* clean up */
+    DELETE(r);
+    DELETE(r_);
+  }
+
+ private:
+  std::vector<std::string> files;
+  int fd = -1;       // of the file being read, if any
+  unsigned fd_file;  // index of the file being read
+  pico::MicrobatchSizer sizer;
+
+  int file_fd(unsigned i) {
+    if (fd >= 0 && fd_file == i) return fd;
+    close_file();
+    fd = open_input(files[i]);
+    fd_file = i;
+    return fd;
+  }
+
+  void close_file() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+  }
+
+  void send(mb_t *mb) {
+    sizer.send(mb->size(),
+               [&]() { ff_send_out(reinterpret_cast<void *>(mb)); });
+  }
+};
+
+/**
+ * The ReadFromFiles non-ordering farm.
+ *
+ * The emitter turns the whole input into a single pool of work units: small
+ * files are read as a whole, while large files are split into line-aligned
+ * ranges of about the same size, so that work is balanced across the workers
+ * regardless of how the input is partitioned into files.
+ * Units are pulled on demand by idle workers.
+ */
+template <typename Line>
+class ReadFromFilesFFNode : public NonOrderingFarm {
+ public:
+  ReadFromFilesFFNode(int parallelism, const std::vector<std::string> &inputs,
+                      unsigned mb_size = 0) {
+    auto files = expand_inputs(inputs);
+    std::vector<ff_node *> workers;
+    for (int i = 0; i < parallelism; ++i)
+      workers.push_back(new files_textfile<Line>(files, mb_size));
+    this->setEmitterF(new Scheduler(files, parallelism));
+    this->add_workers(workers);
+    this->setCollectorF(new ForwardingCollector(parallelism));
+    this->set_scheduling_ondemand();
+    this->cleanup_all();
+  }
+
+ private:
+  class Scheduler : public base_emitter {
+   public:
+    Scheduler(const std::vector<std::string> &files_, unsigned nworkers)
+        : base_emitter(nworkers), files(files_), nw(nworkers) {
+      struct stat st;
+      for (auto &f : files) {
+        if (stat(f.c_str(), &st)) {
+          fprintf(stderr, "Unable to open input file %s: %s\n", f.c_str(),
+                  strerror(errno));
+          exit(1);
+        }
+        sizes.push_back(st.st_size);
+      }
+    }
+
+    void begin_callback() {
+      /* get a fresh tag */
+      tag = pico::base_microbatch::fresh_tag();
+      begin_cstream(tag);
+
+      /* a few units per worker, to balance uneven units */
+      off_t total = 0;
+      for (auto s : sizes) total += s;
+      off_t split = std::min<off_t>(
+          std::max<off_t>(total / (4 * nw), FILES_MIN_SPLIT), FILES_MAX_SPLIT);
+
+      for (unsigned i = 0; i < files.size(); ++i) {
+        if (sizes[i] <= split) {
+          if (sizes[i]) send_unit(i, 0, sizes[i]);
+          continue;
+        }
+
+        /* split points are searched directly on a mapping of the file */
+        int fd = open_input(files[i]);
+        {
+          mapped_range file(fd, 0, sizes[i], false);
+          file.for_each_chunk('\n', split, [&](off_t begin, off_t end) {
+            send_unit(i, begin, end);
+          });
+        }
+        close(fd);
+      }
+
+      end_cstream(tag);
+    }
+
+    void kernel(pico::base_microbatch *) { assert(false); }
+
+   private:
+    std::vector<std::string> files;
+    std::vector<off_t> sizes;
+    unsigned nw;
+    pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
+
+    void send_unit(unsigned file, off_t begin, off_t end) {
+      auto r = NEW<frange>(file, begin, end);
+      ff_send_out(NEW<pico::mb_wrapped<frange>>(tag, r));
+    }
+  };
+};
+
+#endif /* INTERNALS_FFOPERATORS_INOUT_READFROMFILESFFNODE_HPP_ */
@@ -31,29 +31,57 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <cerrno>
+#include <type_traits>
+#ifdef TRACE_PICO
+#include <chrono>
+#endif
+
 #include <ff/node.hpp>
 
 #include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
 #include "pico/Internals/TimedToken.hpp"
 #include "pico/Internals/utils.hpp"
 
 #include "pico/ff_implementation/ff_config.hpp"
 
-#define CHUNK_SIZE 512
+#include "line_splitter.hpp"
+#include "mapped_range.hpp"
+
+/*
+ * Default size of the receive blocks, into which lines are split in place.
+ */
+#define SOCKET_BUFFER_SIZE (1 << 22)
 
 /*
  * reads a stream from a socket, maintains the order
+ *
+ * Bytes are received straight into large shared blocks (as many as available
+ * per system call) and split in place, so that each byte is copied at most
+ * once (i.e., not at all for LineView records).
  */
+template <typename TokenType>
 class ReadFromSocketFFNode : public base_filter {
-  typedef pico::Token<std::string> TokenType;
+  typedef typename TokenType::datatype DataType;
 
  public:
-  ReadFromSocketFFNode(std::string &server_name_, int port_, char delimiter_)
-      : server_name(server_name_), port(port_), delimiter(delimiter_) {
+  ReadFromSocketFFNode(std::string &server_name_, int port_, char delimiter_,
+                       unsigned mb_size_ = 0,
+                       size_t buffer_size_ = SOCKET_BUFFER_SIZE,
+                       int rcvbuf = 0)
+      : server_name(server_name_),
+        port(port_),
+        delimiter(delimiter_),
+        mb_size(pico::microbatch_size(mb_size_)),
+        buffer_size(buffer_size_) {
     int option = 1;
     sockfd = socket(AF_INET, SOCK_STREAM, 0);
     setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
     if (sockfd < 0) error("ERROR opening socket");
+    /* set before connecting, for the window scale to be negotiated */
+    if (rcvbuf > 0)
+      setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
     server = gethostbyname(server_name.c_str());
     if (server == NULL) {
       fprintf(stderr, "ERROR, no such host\n");
@@ -71,41 +99,16 @@ class ReadFromSocketFFNode : public base_filter {
     tag = pico::base_microbatch::fresh_tag();
     begin_cstream(tag);
 
-    std::string tail;
-    char buffer[CHUNK_SIZE];
     if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
       error("ERROR connecting");
     }
-    bzero(buffer, sizeof(buffer));
-    auto mb = NEW<mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
-    std::string *line = new (mb->allocate()) std::string();
-
-    while ((n = read(sockfd, buffer, sizeof(buffer))) > 0) {
-      tail.append(buffer, n);
-      std::istringstream f(tail);
-      /* initialize a new string within the micro-batch */
-      while (std::getline(f, *line, delimiter)) {
-        if (!f.eof()) {  // line contains another delimiter
-          mb->commit();
-          if (mb->full()) {
-            ff_send_out(reinterpret_cast<void *>(mb));
-            mb = NEW<mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
-          }
-          tail.clear();
-          line = new (mb->allocate()) std::string();
-        } else {  // trunked line, store for next parsing
-          tail.clear();
-          tail.append(*line);
-        }
-      }
-      bzero(buffer, sizeof(buffer));
-    }  // end while read
-
-    if (!mb->empty()) {
-      ff_send_out(reinterpret_cast<void *>(mb));
-    } else {
-      DELETE(mb);
-    }
+#ifdef TRACE_PICO
+    auto t0 = std::chrono::high_resolution_clock::now();
+#endif
+    read_lines();
+#ifdef TRACE_PICO
+    recvd += std::chrono::high_resolution_clock::now() - t0;
+#endif
 
     end_cstream(tag);
   }
@@ -118,16 +121,58 @@ class ReadFromSocketFFNode : public base_filter {
   typedef pico::Microbatch<TokenType> mb_t;
   std::string server_name;
   int port;
-  int sockfd = 0, n = 0;
+  int sockfd = 0;
   struct sockaddr_in serv_addr;
   struct hostent *server = nullptr;
   char delimiter;
+  const unsigned mb_size;
+  const size_t buffer_size;
   pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
 
+  void read_lines() {
+    auto mb = NEW<mb_t>(tag, mb_size);
+    auto recv_f = [&](char *buf, size_t count) {
+      ssize_t n;
+      while ((n = recv(sockfd, buf, count, 0)) < 0 && errno == EINTR)
+        ;
+      return n;
+    };
+    auto line_f = [&](pico::line_block *blk, const char *p, size_t len) {
+      build_line(mb->allocate(), blk, p, len);
+      mb->commit();
+#ifdef TRACE_PICO
+      ++lines;
+#endif
+      if (mb->full()) {
+        ff_send_out(reinterpret_cast<void *>(mb));
+        mb = NEW<mb_t>(tag, mb_size);
+      }
+    };
+    split_lines(delimiter, recv_f, line_f, buffer_size);
+
+    if (!mb->empty()) {
+      ff_send_out(reinterpret_cast<void *>(mb));
+    } else {
+      DELETE(mb);
+    }
+  }
+
   void error(const char *msg) {
     perror(msg);
     exit(0);
   }
+
+#ifdef TRACE_PICO
+  unsigned long long lines = 0;
+  std::chrono::duration<double> recvd{0};
+
+  void ffStats(std::ostream &os) {
+    base_node::ffStats(os);
+    os << "  PICO-lines    : " << lines << "\n";
+    if (recvd.count() > 0)
+      os << "  PICO-lines/s  : " << lines / recvd.count() << "\n";
+  }
+#endif
 };
 
 #endif /* INTERNALS_FFOPERATORS_INOUT_READFROMSOCKETFFNODE_HPP_ */
@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_INOUT_READFROMSOCKETSFFNODE_HPP_
+#define INTERNALS_FFOPERATORS_INOUT_READFROMSOCKETSFFNODE_HPP_
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ff/farm.hpp>
+
+#include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
+#include "pico/Internals/Token.hpp"
+#include "pico/Internals/utils.hpp"
+#include "pico/ff_implementation/SupportFFNodes/collectors.hpp"
+#include "pico/ff_implementation/SupportFFNodes/farms.hpp"
+
+#include "pico/ff_implementation/SupportFFNodes/base_nodes.hpp"
+#include "pico/ff_implementation/ff_config.hpp"
+
+#include "line_splitter.hpp"
+#include "mapped_range.hpp"
+
+/*
+ * Maximum number of connection events handled per epoll_wait.
+ */
+#define SOCKETS_MAX_EVENTS 64
+
+typedef std::vector<std::pair<std::string, int>> socket_endpoints;
+
+/*
+ * A connection, split into lines by a reader thread.
+ */
+struct socket_conn {
+  socket_conn(int fd_, char delimiter, size_t block_size)
+      : fd(fd_), splitter(delimiter, block_size) {}
+
+  ~socket_conn() { close(fd); }
+
+  int fd;
+  line_splitter splitter;
+};
+
+/*
+ * The connections of a reader thread, multiplexed by an epoll instance.
+ *
+ * Connections are added by the acceptor thread, that finally raises the done
+ * flag and wakes up the reader by an event descriptor.
+ */
+struct socket_readers {
+  struct reader {
+    int ep, ev;
+    std::atomic<unsigned> open{0};
+    std::atomic<bool> done{false};
+  };
+
+  socket_readers(unsigned n) : readers(n) {
+    for (auto &r : readers) {
+      r.ep = epoll_create1(0);
+      r.ev = eventfd(0, 0);
+      if (r.ep < 0 || r.ev < 0) {
+        perror("ERROR creating epoll instance");
+        exit(1);
+      }
+      epoll_event e;
+      e.events = EPOLLIN;
+      e.data.ptr = nullptr;  // the wake-up event
+      epoll_ctl(r.ep, EPOLL_CTL_ADD, r.ev, &e);
+    }
+  }
+
+  ~socket_readers() {
+    for (auto &r : readers) {
+      close(r.ep);
+      close(r.ev);
+    }
+  }
+
+  void add(unsigned i, socket_conn *c) {
+    auto &r = readers[i];
+    ++r.open;
+    epoll_event e;
+    e.events = EPOLLIN | EPOLLRDHUP;
+    e.data.ptr = c;
+    if (epoll_ctl(r.ep, EPOLL_CTL_ADD, c->fd, &e)) {
+      perror("ERROR adding connection");
+      exit(1);
+    }
+  }
+
+  void close_all() {
+    uint64_t one = 1;
+    for (auto &r : readers) {
+      r.done = true;
+      if (write(r.ev, &one, sizeof(one)) < 0) perror("ERROR waking reader");
+    }
+  }
+
+  std::vector<reader> readers;
+};
+
+/*
+ * A reader thread, splitting the lines of its connections as soon as they
+ * are received.
+ *
+ * Each connection is served by a single reader, so that its lines are
+ * emitted in order.
+ */
+template <typename TokenType>
+class socket_reader : public base_filter {
+  typedef typename TokenType::datatype DataType;
+  typedef pico::Microbatch<TokenType> mb_t;
+
+ public:
+  socket_reader(unsigned mb_size_ = 0)
+      : mb_size(pico::microbatch_size(mb_size_)) {}
+
+  void kernel(pico::base_microbatch *wmb) {
+    auto wr = reinterpret_cast<pico::mb_wrapped<socket_readers::reader> *>(wmb);
+    auto &r = *wr->get();
+    auto tag = wmb->tag();
+    auto mb = NEW<mb_t>(tag, mb_size);
+    auto line_f = [&](pico::line_block *blk, const char *p, size_t len) {
+      build_line(mb->allocate(), blk, p, len);
+      mb->commit();
+      if (mb->full()) {
+        ff_send_out(reinterpret_cast<void *>(mb));
+        mb = NEW<mb_t>(tag, mb_size);
+      }
+    };
+
+    epoll_event evs[SOCKETS_MAX_EVENTS];
+    while (!(r.done && r.open == 0)) {
+      /* do not hold lines while waiting for more */
+      int n = epoll_wait(r.ep, evs, SOCKETS_MAX_EVENTS, mb->empty() ? -1 : 0);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) {
+        perror("ERROR waiting for connections");
+        exit(1);
+      }
+      if (n == 0) {
+        ff_send_out(reinterpret_cast<void *>(mb));
+        mb = NEW<mb_t>(tag, mb_size);
+        continue;
+      }
+
+      for (int i = 0; i < n; ++i) {
+        auto c = reinterpret_cast<socket_conn *>(evs[i].data.ptr);
+        if (!c) {
+          uint64_t v;
+          if (read(r.ev, &v, sizeof(v)) < 0) perror("ERROR reading event");
+          continue;
+        }
+        auto recv_f = [&](char *buf, size_t count) {
+          return recv(c->fd, buf, count, 0);
+        };
+        ssize_t res = c->splitter.read(recv_f, line_f);
+        if (res > 0 || (res < 0 && (errno == EAGAIN || errno == EINTR)))
+          continue;
+
+        /* end of stream (or connection error) */
+        c->splitter.finish(line_f);
+        epoll_ctl(r.ep, EPOLL_CTL_DEL, c->fd, nullptr);
+        DELETE(c);
+        --r.open;
+      }
+    }
+
+    if (!mb->empty())
+      ff_send_out(reinterpret_cast<void *>(mb));
+    else
+      DELETE(mb);
+
+    DELETE(wr);
+  }
+
+ private:
+  const unsigned mb_size;
+};
+
+/**
+ * The ReadFromSockets non-ordering farm.
+ *
+ * The emitter establishes the connections (either by accepting them or by
+ * connecting to a list of endpoints) and hands them to the reader threads
+ * (i.e., the workers) in a round-robin fashion.
+ */
+template <typename TokenType>
+class ReadFromSocketsFFNode : public NonOrderingFarm {
+ public:
+  /* listens on a port, for a given number of connections */
+  ReadFromSocketsFFNode(int port, unsigned connections, char delimiter,
+                        int parallelism, unsigned mb_size = 0,
+                        size_t block_size = LINE_BLOCK_SIZE)
+      : readers(parallelism) {
+    auto acceptor = new Acceptor(readers, delimiter, block_size);
+    acceptor->listen_on(port, connections);
+    build(acceptor, parallelism, mb_size);
+  }
+
+  /* connects to a list of endpoints */
+  ReadFromSocketsFFNode(socket_endpoints endpoints, char delimiter,
+                        int parallelism, unsigned mb_size = 0,
+                        size_t block_size = LINE_BLOCK_SIZE)
+      : readers(parallelism) {
+    auto acceptor = new Acceptor(readers, delimiter, block_size);
+    acceptor->endpoints = endpoints;
+    build(acceptor, parallelism, mb_size);
+  }
+
+ private:
+  socket_readers readers;
+
+  void build(ff::ff_node *acceptor, int parallelism, unsigned mb_size) {
+    std::vector<ff_node *> workers;
+    for (int i = 0; i < parallelism; ++i)
+      workers.push_back(new socket_reader<TokenType>(mb_size));
+    this->setEmitterF(acceptor);
+    this->add_workers(workers);
+    this->setCollectorF(new ForwardingCollector(parallelism));
+    this->cleanup_all();
+  }
+
+  class Acceptor : public base_emitter {
+   public:
+    Acceptor(socket_readers &readers_, char delimiter_, size_t block_size_)
+        : base_emitter(readers_.readers.size()),
+          readers(readers_),
+          delimiter(delimiter_),
+          block_size(block_size_) {}
+
+    ~Acceptor() {
+      if (lfd >= 0) close(lfd);
+    }
+
+    /* binds early, so that producers may connect before the pipe runs */
+    void listen_on(int port, unsigned connections_) {
+      int option = 1;
+      sockaddr_in addr;
+      connections = connections_;
+      lfd = socket(AF_INET, SOCK_STREAM, 0);
+      if (lfd < 0) error("ERROR opening socket");
+      setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      addr.sin_port = htons(port);
+      if (bind(lfd, (sockaddr *)&addr, sizeof(addr)) < 0)
+        error("ERROR on binding");
+      if (listen(lfd, connections) < 0) error("ERROR on listening");
+    }
+
+    void begin_callback() {
+      /* get a fresh tag */
+      tag = pico::base_microbatch::fresh_tag();
+      begin_cstream(tag);
+
+      /* start the readers */
+      unsigned nw = readers.readers.size();
+      for (unsigned i = 0; i < nw; ++i) {
+        auto r = &readers.readers[i];
+        send_mb_to(NEW<pico::mb_wrapped<socket_readers::reader>>(tag, r), i);
+      }
+
+      /* hand out connections as soon as they are established */
+      unsigned next = 0;
+      auto add = [&](int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        readers.add(next, NEW<socket_conn>(fd, delimiter, block_size));
+        next = (next + 1) % nw;
+      };
+      if (lfd >= 0) {
+        for (unsigned i = 0; i < connections; ++i) {
+          int fd;
+          while ((fd = accept(lfd, nullptr, nullptr)) < 0 && errno == EINTR)
+            ;
+          if (fd < 0) error("ERROR on accept");
+          add(fd);
+        }
+      } else {
+        for (auto &e : endpoints) add(connect_to(e.first, e.second));
+      }
+      readers.close_all();
+
+      end_cstream(tag);
+    }
+
+    void kernel(pico::base_microbatch *) { assert(false); }
+
+    socket_endpoints endpoints;
+
+   private:
+    socket_readers &readers;
+    char delimiter;
+    size_t block_size;
+    int lfd = -1;
+    unsigned connections = 0;
+    pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
+
+    static int connect_to(const std::string &host, int port) {
+      addrinfo hints, *res;
+      memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_INET;
+      hints.ai_socktype = SOCK_STREAM;
+      auto service = std::to_string(port);
+      if (getaddrinfo(host.c_str(), service.c_str(), &hints, &res)) {
+        fprintf(stderr, "ERROR, no such host %s\n", host.c_str());
+        exit(1);
+      }
+      int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+      if (fd < 0) error("ERROR opening socket");
+      if (connect(fd, res->ai_addr, res->ai_addrlen) < 0)
+        error("ERROR connecting");
+      freeaddrinfo(res);
+      return fd;
+    }
+
+    static void error(const char *msg) {
+      perror(msg);
+      exit(1);
+    }
+  };
+};
+
+#endif /* INTERNALS_FFOPERATORS_INOUT_READFROMSOCKETSFFNODE_HPP_ */
@@ -24,14 +24,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
+#include <unistd.h>
 
+#include <type_traits>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <ff/farm.hpp>
 #include <ff/node.hpp>
 
 #include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
 #include "pico/Internals/utils.hpp"
+#include "pico/ff_implementation/SupportFFNodes/collectors.hpp"
+#include "pico/ff_implementation/SupportFFNodes/farms.hpp"
 
+#include "pico/ff_implementation/SupportFFNodes/base_nodes.hpp"
 #include "pico/ff_implementation/ff_config.hpp"
 
+#include "line_splitter.hpp"
+#include "mapped_range.hpp"
+
 #define CHUNK_SIZE 512
 
 /*
@@ -41,7 +56,8 @@
 template <typename TokenType>
 class ReadFromStdInFFNode : public base_filter {
  public:
-  ReadFromStdInFFNode(char delimiter_) : delimiter(delimiter_) {}
+  ReadFromStdInFFNode(char delimiter_, unsigned mb_size_ = 0)
+      : delimiter(delimiter_), mb_size(pico::microbatch_size(mb_size_)) {}
 
   void kernel(pico::base_microbatch *) { assert(false); }
 
@@ -49,15 +65,29 @@ class ReadFromStdInFFNode : public base_filter {
     /* get a fresh tag */
     tag = pico::base_microbatch::fresh_tag();
     begin_cstream(tag);
-    auto mb = NEW<mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
-    std::string str;
+    auto mb = NEW<mb_t>(tag, mb_size);
 
-    while (std::getline(std::cin, str, delimiter)) {
-      new (mb->allocate()) std::string(str);
-      mb->commit();
-      if (mb->full()) {
-        send_mb(mb);
-        mb = NEW<mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
+    if constexpr (std::is_same<DataType, pico::LineView>::value) {
+      /* zero-copy lines, backed by shared blocks read from descriptor 0 */
+      auto read_f = [](char *buf, size_t count) { return read(0, buf, count); };
+      auto line_f = [&](pico::line_block *blk, const char *p, size_t len) {
+        new (mb->allocate()) DataType(pico::LineView(blk, p, len));
+        mb->commit();
+        if (mb->full()) {
+          send_mb(mb);
+          mb = NEW<mb_t>(tag, mb_size);
+        }
+      };
+      split_lines(delimiter, read_f, line_f);
+    } else {
+      std::string str;
+      while (std::getline(std::cin, str, delimiter)) {
+        new (mb->allocate()) DataType(str);
+        mb->commit();
+        if (mb->full()) {
+          send_mb(mb);
+          mb = NEW<mb_t>(tag, mb_size);
+        }
       }
     }
 
@@ -71,7 +101,9 @@ class ReadFromStdInFFNode : public base_filter {
 
  private:
   typedef pico::Microbatch<TokenType> mb_t;
+  typedef typename TokenType::datatype DataType;
   char delimiter;
+  const unsigned mb_size;
   pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
 
   void error(const char *msg) {
@@ -80,4 +112,162 @@ class ReadFromStdInFFNode : public base_filter {
   }
 };
 
+/*
+ * Size of the blocks read from stdin by the parallel reader.
+ */
+#define STDIN_BLOCK_SIZE (1 << 22)
+
+/*
+ * A delimiter-aligned range of a stdin block, holding a block reference.
+ */
+struct stdin_range {
+  pico::line_block *blk;
+  const char *begin;
+  size_t len;
+};
+
+/*
+ * A worker splitting ranges of stdin blocks into lines.
+ */
+template <typename TokenType>
+class stdin_tokenizer : public base_filter {
+  typedef typename TokenType::datatype DataType;
+  typedef pico::Microbatch<TokenType> mb_t;
+
+ public:
+  stdin_tokenizer(char delimiter_, unsigned mb_size = 0)
+      : delimiter(delimiter_), sizer(mb_size) {}
+
+  void kernel(pico::base_microbatch *wmb) {
+    auto wr = reinterpret_cast<pico::mb_wrapped<stdin_range> *>(wmb);
+    auto tag = wmb->tag();
+    stdin_range *r = wr->get();
+    auto mb = NEW<mb_t>(tag, sizer.size());
+
+    auto line_f = [&](const char *p, size_t len) {
+      build_line(mb->allocate(), r->blk, p, len);
+      mb->commit();
+      if (mb->full()) {
+        send(mb);
+        mb = NEW<mb_t>(tag, sizer.size());
+      }
+    };
+    const char *p = r->begin, *end = p + r->len, *q;
+    while (p < end && (q = (const char *)memchr(p, delimiter, end - p))) {
+      line_f(p, q - p);
+      p = q + 1;
+    }
+    if (p < end) line_f(p, end - p);
+
+    /* remainder micro-batch */
+    if (!mb->empty())
+      send(mb);
+    else
+      DELETE(mb);
+
+    /* clean up */
+    r->blk->unref();
+    DELETE(r);
+    DELETE(wr);
+  }
+
+ private:
+  char delimiter;
+  pico::MicrobatchSizer sizer;
+
+  void send(mb_t *mb) {
+    sizer.send(mb->size(),
+               [&]() { ff_send_out(reinterpret_cast<void *>(mb)); });
+  }
+};
+
+/**
+ * The parallel ReadFromStdIn farm.
+ *
+ * The emitter reads large blocks from descriptor 0 and hands out
+ * delimiter-aligned ranges, as soon as they are read, to the workers, that
+ * tokenize them in parallel. Over an ordering farm (i.e., for streams) lines
+ * are emitted in input order.
+ */
+template <typename TokenType, typename Farm>
+class ReadFromStdInFFNode_par : public Farm {
+ public:
+  ReadFromStdInFFNode_par(int parallelism, char delimiter, unsigned mb_size = 0,
+                          size_t block_size = STDIN_BLOCK_SIZE) {
+    ff::ff_node *e;
+    if (this->isOFarm())
+      e = new Splitter<base_ord_emitter>(parallelism, delimiter, block_size);
+    else
+      e = new Splitter<base_emitter>(parallelism, delimiter, block_size);
+    std::vector<ff::ff_node *> workers;
+    for (int i = 0; i < parallelism; ++i)
+      workers.push_back(new stdin_tokenizer<TokenType>(delimiter, mb_size));
+    this->setEmitterF(e);
+    this->add_workers(workers);
+    this->setCollectorF(new ForwardingCollector(parallelism));
+    this->cleanup_all();
+  }
+
+ private:
+  template <typename Base>
+  class Splitter : public Base {
+   public:
+    Splitter(unsigned nworkers, char delimiter_, size_t block_size_)
+        : Base(nworkers), delimiter(delimiter_), block_size(block_size_) {}
+
+    void begin_callback() {
+      /* get a fresh tag */
+      tag = pico::base_microbatch::fresh_tag();
+      this->begin_cstream(tag);
+
+      auto blk = pico::line_block::make(block_size);
+      size_t fill = 0, start = 0;
+      while (true) {
+        if (fill == blk->capacity()) {
+          /* move the partial line to a fresh block */
+          size_t partial = fill - start;
+          auto next = pico::line_block::make(std::max(block_size, 2 * partial));
+          memcpy(next->data(), blk->data() + start, partial);
+          blk->unref();
+          blk = next;
+          fill = partial;
+          start = 0;
+        }
+
+        ssize_t n = read(0, blk->data() + fill, blk->capacity() - fill);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        /* hand out the lines completed by the new bytes */
+        char *base = blk->data();
+        auto last = (char *)memrchr(base + fill, delimiter, n);
+        fill += n;
+        if (last) {
+          send_range(blk, base + start, last + 1 - (base + start));
+          start = last + 1 - base;
+        }
+      }
+
+      /* last line, not terminated by a delimiter */
+      if (fill > start) send_range(blk, blk->data() + start, fill - start);
+      blk->unref();
+
+      this->end_cstream(tag);
+    }
+
+    void kernel(pico::base_microbatch *) { assert(false); }
+
+   private:
+    char delimiter;
+    size_t block_size;
+    pico::base_microbatch::tag_t tag = 0;  // a tag for the generated collection
+
+    void send_range(pico::line_block *blk, const char *p, size_t len) {
+      blk->ref();
+      auto r = NEW<stdin_range>(stdin_range{blk, p, len});
+      this->ff_send_out(NEW<pico::mb_wrapped<stdin_range>>(tag, r));
+    }
+  };
+};
+
 #endif /* INTERNALS_FFOPERATORS_INOUT_READFROMSTDINFFNODE_HPP_ */
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_INOUT_WRITETOBINARYFILEFFNODE_HPP_
+#define INTERNALS_FFOPERATORS_INOUT_WRITETOBINARYFILEFFNODE_HPP_
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <ff/node.hpp>
+
+#include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/Token.hpp"
+#include "pico/Internals/utils.hpp"
+
+#include "pico/ff_implementation/SupportFFNodes/base_nodes.hpp"
+
+#include "binary_record.hpp"
+
+/*
+ * Size of the output buffer of binary sinks.
+ */
+#define BINARY_WRITE_BUFFER (1 << 20)
+
+/*
+ * Writes fixed-size binary records, buffered by large writes.
+ */
+template <typename In>
+class WriteToBinaryFileFFNode : public base_filter {
+  static constexpr size_t rsize = binary_record<In>::size;
+
+ public:
+  WriteToBinaryFileFFNode(std::string fname)
+      : buf(std::max(BINARY_WRITE_BUFFER / rsize, (size_t)1) * rsize) {
+    fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      fprintf(stderr, "Unable to open output file %s\n", fname.c_str());
+      exit(1);
+    }
+  }
+
+  ~WriteToBinaryFileFFNode() {
+    flush();
+    close(fd);
+  }
+
+  /* sink node */
+  bool propagate_cstream_sync() { return false; }
+
+  void kernel(pico::base_microbatch* in_mb) {
+    auto mb = reinterpret_cast<pico::Microbatch<pico::Token<In>>*>(in_mb);
+    for (In& in : *mb) {
+      if (fill == buf.size()) flush();
+      binary_record<In>::store(buf.data() + fill, in);
+      fill += rsize;
+    }
+    DELETE(mb);
+  }
+
+  void cstream_end_callback(pico::base_microbatch::tag_t) { flush(); }
+
+ private:
+  int fd;
+  std::vector<char> buf;
+  size_t fill = 0;
+
+  void flush() {
+    const char* p = buf.data();
+    while (fill) {
+      ssize_t r = write(fd, p, fill);
+      if (r <= 0) {
+        fprintf(stderr, "Unable to write binary records\n");
+        exit(1);
+      }
+      p += r;
+      fill -= r;
+    }
+  }
+};
+
+#endif /* INTERNALS_FFOPERATORS_INOUT_WRITETOBINARYFILEFFNODE_HPP_ */
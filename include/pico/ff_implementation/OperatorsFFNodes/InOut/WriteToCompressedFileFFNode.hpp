@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_INOUT_WRITETOCOMPRESSEDFILEFFNODE_HPP_
+#define INTERNALS_FFOPERATORS_INOUT_WRITETOCOMPRESSEDFILEFFNODE_HPP_
+
+#include <functional>
+#include <sstream>
+#include <string>
+
+#include <ff/node.hpp>
+
+#include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/Token.hpp"
+#include "pico/Internals/utils.hpp"
+
+#include "pico/ff_implementation/SupportFFNodes/base_nodes.hpp"
+
+#include "zblock_file.hpp"
+
+/*
+ * Writes lines to a block-compressed file, either produced by a user kernel
+ * or by ostream.
+ */
+template <typename In>
+class WriteToCompressedFileFFNode : public base_filter {
+ public:
+  WriteToCompressedFileFFNode(std::string fname,
+                              std::function<std::string(In)> kernel_,
+                              size_t block_size)
+      : wkernel(kernel_), outfile(fname, block_size) {}
+
+  /* sink node */
+  bool propagate_cstream_sync() { return false; }
+
+  void kernel(pico::base_microbatch* in_mb) {
+    auto mb = reinterpret_cast<pico::Microbatch<pico::Token<In>>*>(in_mb);
+    for (In& in : *mb) {
+      if (wkernel)
+        outfile.write_line(wkernel(in));
+      else {
+        line.str("");
+        line << in;
+        outfile.write_line(line.str());
+      }
+    }
+    DELETE(mb);
+  }
+
+  /* the file is complete once the collection is over */
+  void cstream_end_callback(pico::base_microbatch::tag_t) { outfile.finish(); }
+
+ private:
+  std::function<std::string(In)> wkernel;
+  zblock::writer outfile;
+  std::ostringstream line;
+};
+
+#endif /* INTERNALS_FFOPERATORS_INOUT_WRITETOCOMPRESSEDFILEFFNODE_HPP_ */
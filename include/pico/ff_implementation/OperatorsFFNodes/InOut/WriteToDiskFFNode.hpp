@@ -21,6 +21,20 @@
 #ifndef INTERNALS_FFOPERATORS_INOUT_WRITETODISKFFNODE_HPP_
 #define INTERNALS_FFOPERATORS_INOUT_WRITETODISKFFNODE_HPP_
 
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <ff/farm.hpp>
 #include <ff/node.hpp>
 
 #include "pico/Internals/Microbatch.hpp"
@@ -28,57 +42,171 @@
 #include "pico/Internals/utils.hpp"
 
 #include "pico/ff_implementation/SupportFFNodes/base_nodes.hpp"
+#include "pico/ff_implementation/SupportFFNodes/collectors.hpp"
+#include "pico/ff_implementation/SupportFFNodes/emitters.hpp"
+#include "pico/ff_implementation/SupportFFNodes/farms.hpp"
+
+#include "sink_buffer.hpp"
 
 /*
  * TODO only works with non-decorating token
+ *
+ * Lines are formatted into a large output buffer (see sink_buffer), that is
+ * written out once full and at the end of the collection.
+ *
+ * A writer either owns its output file or shares it with other writers in a
+ * parallel sink, each microbatch being written to the region following the
+ * one of its predecessor in the stream (see shared_output).
  */
 
 template <typename In>
 class WriteToDiskFFNode : public base_filter {
  public:
-  WriteToDiskFFNode(std::string fname, std::function<std::string(In)> kernel_)
-      : wkernel(kernel_), outfile(fname) {
-    if (!outfile.is_open()) {
-      std::cerr << "Unable to open output file\n";
-      assert(false);
-    }
-  }
+  WriteToDiskFFNode(std::string fname, std::function<std::string(In)> kernel_,
+                    bool async = false)
+      : wkernel(kernel_), buf(open_output(fname), true, async), outfile(&buf) {}
+
+  WriteToDiskFFNode(std::shared_ptr<shared_output> out_, unsigned rank,
+                    std::function<std::string(In)> kernel_, bool async = false)
+      : wkernel(kernel_),
+        out(out_),
+        buf(out.get(), rank, async),
+        outfile(&buf) {}
 
   /* sink node */
   bool propagate_cstream_sync() { return false; }
 
   void kernel(pico::base_microbatch* in_mb) {
     auto mb = reinterpret_cast<pico::Microbatch<pico::Token<In>>*>(in_mb);
-    for (In& in : *mb) outfile << wkernel(in) << std::endl;
+    for (In& in : *mb) outfile << wkernel(in) << '\n';
+    buf.commit();
     DELETE(mb);
   }
 
+  void cstream_end_callback(pico::base_microbatch::tag_t) { buf.flush(); }
+
  private:
   std::function<std::string(In)> wkernel;
-  std::ofstream outfile;
+  std::shared_ptr<shared_output> out;
+  sink_buffer buf;
+  std::ostream outfile;
 };
 
 template <typename In>
 class WriteToDiskFFNode_ostream : public base_filter {
  public:
-  WriteToDiskFFNode_ostream(std::string fname) : outfile(fname) {
-    if (!outfile.is_open()) {
-      std::cerr << "Unable to open output file\n";
-      assert(false);
-    }
-  }
+  WriteToDiskFFNode_ostream(std::string fname, bool async = false)
+      : buf(open_output(fname), true, async), outfile(&buf) {}
+
+  WriteToDiskFFNode_ostream(std::shared_ptr<shared_output> out_,
+                            unsigned rank, bool async = false)
+      : out(out_), buf(out.get(), rank, async), outfile(&buf) {}
 
   /* sink node */
   bool propagate_cstream_sync() { return false; }
 
   void kernel(pico::base_microbatch* in_mb) {
     auto mb = reinterpret_cast<pico::Microbatch<pico::Token<In>>*>(in_mb);
-    for (In& in : *mb) outfile << in << std::endl;
+    for (In& in : *mb) outfile << in << '\n';
+    buf.commit();
     DELETE(mb);
   }
 
+  void cstream_end_callback(pico::base_microbatch::tag_t) { buf.flush(); }
+
+ private:
+  std::shared_ptr<shared_output> out;
+  sink_buffer buf;
+  std::ostream outfile;
+};
+
+/*
+ * Deals data microbatches to the writers round-robin (see shared_output).
+ */
+class WriteToDiskEmitter : public base_emitter {
+ public:
+  WriteToDiskEmitter(unsigned nw_) : base_emitter(nw_), nw(nw_) {}
+
+  void kernel(pico::base_microbatch* mb) {
+    send_mb_to(mb, next);
+    next = (next + 1) % nw;
+  }
+
  private:
-  std::ofstream outfile;
+  unsigned nw, next = 0;
 };
 
+/*
+ * A parallel sink, as a farm of writers.
+ */
+class WriteToDiskFFNode_par : public NonOrderingFarm {
+ public:
+  WriteToDiskFFNode_par(std::vector<ff::ff_node*> writers, bool round_robin) {
+    unsigned nw = writers.size();
+    if (round_robin)
+      this->setEmitterF(new WriteToDiskEmitter(nw));
+    else
+      this->setEmitterF(new ForwardingEmitter(nw));
+    this->setCollectorF(new ForwardingCollector(nw));
+    this->add_workers(writers);
+    this->cleanup_all();
+  }
+};
+
+/*
+ * Removes the shards (i.e., the part-* files) left in dir by a former run,
+ * that might have been written by more writers.
+ */
+static void WriteToDiskFFNode_clear_shards(const std::string& dir) {
+  DIR* d = opendir(dir.c_str());
+  if (!d) {
+    fprintf(stderr, "Unable to open output directory %s: %s\n", dir.c_str(),
+            strerror(errno));
+    exit(1);
+  }
+  while (struct dirent* e = readdir(d)) {
+    if (strncmp(e->d_name, "part-", 5)) continue;
+    std::string path = dir + "/" + e->d_name;
+    if (unlink(path.c_str())) {
+      fprintf(stderr, "Unable to remove stale output file %s: %s\n",
+              path.c_str(), strerror(errno));
+      exit(1);
+    }
+  }
+  closedir(d);
+}
+
+/*
+ * Builds a sink with par writers of type Writer, either:
+ * - writing a single file (in stream order, see shared_output)
+ * - writing par shards (i.e., fname/part-00000 and so on), replacing the
+ *   shards in fname, if any
+ * Further arguments are forwarded to the writers.
+ */
+template <typename Writer, typename... Args>
+static ff::ff_node* WriteToDiskFFNode_make(int par, std::string fname,
+                                           bool sharded, bool async,
+                                           Args... args) {
+  if (par == 1 && !sharded) return new Writer(fname, args..., async);
+
+  std::vector<ff::ff_node*> writers;
+  if (sharded) {
+    if (mkdir(fname.c_str(), 0755) && errno != EEXIST) {
+      fprintf(stderr, "Unable to create output directory %s\n", fname.c_str());
+      exit(1);
+    }
+    WriteToDiskFFNode_clear_shards(fname);
+    char part[16];
+    for (int i = 0; i < par; ++i) {
+      snprintf(part, sizeof(part), "/part-%05d", i);
+      writers.push_back(new Writer(fname + part, args..., async));
+    }
+  } else {
+    auto out = std::make_shared<shared_output>(fname, par);
+    for (int i = 0; i < par; ++i)
+      writers.push_back(new Writer(out, i, args..., async));
+  }
+  return new WriteToDiskFFNode_par(writers, !sharded);
+}
+
 #endif /* INTERNALS_FFOPERATORS_INOUT_WRITETODISKFFNODE_HPP_ */
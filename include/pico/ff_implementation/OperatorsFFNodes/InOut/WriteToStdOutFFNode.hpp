@@ -21,6 +21,11 @@
 #ifndef INTERNALS_FFOPERATORS_INOUT_WRITETOSTDOUTFFNODE_HPP_
 #define INTERNALS_FFOPERATORS_INOUT_WRITETOSTDOUTFFNODE_HPP_
 
+#include <functional>
+#include <iostream>
+#include <ostream>
+#include <string>
+
 #include <ff/node.hpp>
 
 #include "pico/Internals/Microbatch.hpp"
@@ -28,40 +33,62 @@
 #include "pico/Internals/Token.hpp"
 #include "pico/Internals/utils.hpp"
 
+#include "sink_buffer.hpp"
+
 /*
  * TODO only works with non-decorating token
+ *
+ * Lines are formatted into a large output buffer (see sink_buffer), that is
+ * handed out at the end of each microbatch, so that streams are printed with
+ * no per-record flush but with no extra delay.
  */
 
 template <typename In, typename TokenType>
 class WriteToStdOutFFNode : public base_filter {
  public:
-  WriteToStdOutFFNode(std::function<std::string(In&)> kernel_)
-      : wkernel(kernel_) {}
+  WriteToStdOutFFNode(std::function<std::string(In&)> kernel_,
+                      bool async = false)
+      : wkernel(kernel_), buf(std::cout.rdbuf(), async), out(&buf) {}
 
   /* sink node */
   bool propagate_cstream_sync() { return false; }
 
   void kernel(pico::base_microbatch* in_mb) {
     auto in_microbatch = reinterpret_cast<pico::Microbatch<TokenType>*>(in_mb);
-    for (In& tt : *in_microbatch) std::cout << wkernel(tt) << std::endl;
+    for (In& tt : *in_microbatch) out << wkernel(tt) << '\n';
+    buf.push();
     DELETE(in_microbatch);
   }
 
+  void cstream_end_callback(pico::base_microbatch::tag_t) { buf.flush(); }
+
  private:
   std::function<std::string(In&)> wkernel;
+  sink_buffer buf;
+  std::ostream out;
 };
 
 template <typename In, typename TokenType>
 class WriteToStdOutFFNode_ostream : public base_filter {
  public:
+  WriteToStdOutFFNode_ostream(bool async = false)
+      : buf(std::cout.rdbuf(), async), out(&buf) {}
+
   /* sink node */
   bool propagate_cstream_sync() { return false; }
 
   void kernel(pico::base_microbatch* in_mb) {
     auto in_microbatch = reinterpret_cast<pico::Microbatch<TokenType>*>(in_mb);
-    for (In& tt : *in_microbatch) std::cout << tt << std::endl;
+    for (In& tt : *in_microbatch) out << tt << '\n';
+    buf.push();
     DELETE(in_microbatch);
   }
+
+  void cstream_end_callback(pico::base_microbatch::tag_t) { buf.flush(); }
+
+ private:
+  sink_buffer buf;
+  std::ostream out;
 };
 
 #endif /* INTERNALS_FFOPERATORS_INOUT_WRITETOSTDOUTFFNODE_HPP_ */
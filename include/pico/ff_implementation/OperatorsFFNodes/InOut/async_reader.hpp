@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_INOUT_ASYNCREADER_HPP_
+#define INTERNALS_FFOPERATORS_INOUT_ASYNCREADER_HPP_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if __has_include(<linux/io_uring.h>) && !defined(PICO_NO_IO_URING)
+#include <linux/io_uring.h>
+#define PICO_IO_URING
+#endif
+
+#include "pico/LineView.hpp"
+
+/*
+ * Default number of reads in flight, per file range.
+ */
+#define ASYNC_IO_DEPTH 4
+
+/*
+ * Default size of each read.
+ */
+#define ASYNC_IO_BLOCK_SIZE (4 << 20)
+
+/*
+ * Alignment of buffers, offsets and lengths for direct I/O.
+ */
+#define ASYNC_IO_ALIGN 4096
+
+/*
+ * Number of threads serving reads when io_uring is not available.
+ */
+#define ASYNC_IO_THREADS 8
+
+/*
+ * A pool of I/O threads, performing blocking reads on behalf of the async
+ * readers when io_uring is not available.
+ */
+class io_thread_pool {
+ public:
+  static io_thread_pool &get() {
+    static io_thread_pool pool(ASYNC_IO_THREADS);
+    return pool;
+  }
+
+  void submit(std::function<void()> f) {
+    std::lock_guard<std::mutex> lock(mtx);
+    tasks.push_back(std::move(f));
+    cv.notify_one();
+  }
+
+  ~io_thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stop = true;
+    }
+    cv.notify_all();
+    for (auto &t : threads) t.join();
+  }
+
+ private:
+  explicit io_thread_pool(unsigned n) {
+    for (unsigned i = 0; i < n; ++i) threads.emplace_back([this]() { loop(); });
+  }
+
+  void loop() {
+    while (true) {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [this]() { return stop || !tasks.empty(); });
+      if (tasks.empty()) return;
+      auto f = std::move(tasks.front());
+      tasks.pop_front();
+      lock.unlock();
+      f();
+    }
+  }
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::deque<std::function<void()>> tasks;
+  std::vector<std::thread> threads;
+  bool stop = false;
+};
+
+#ifdef PICO_IO_URING
+/*
+ * A minimal io_uring instance, driven by raw system calls (i.e., without
+ * liburing), for submitting reads and reaping their completions.
+ *
+ * The instance is not thread-safe: it is owned by a single reader.
+ */
+class io_uring_queue {
+ public:
+  explicit io_uring_queue(unsigned entries) {
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring_fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (ring_fd < 0) return;
+
+    /* map the submission and completion rings */
+    sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) sq_len = cq_len = std::max(sq_len, cq_len);
+    sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+    sq_ring = map(sq_len, IORING_OFF_SQ_RING);
+    cq_ring = single_mmap ? sq_ring : map(cq_len, IORING_OFF_CQ_RING);
+    sqes = (io_uring_sqe *)map(sqes_len, IORING_OFF_SQES);
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+      release();
+      return;
+    }
+
+    char *sq = (char *)sq_ring, *cq = (char *)cq_ring;
+    sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+    sq_array = (unsigned *)(sq + p.sq_off.array);
+    cq_head = (unsigned *)(cq + p.cq_off.head);
+    cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+    cqes = (io_uring_cqe *)(cq + p.cq_off.cqes);
+  }
+
+  io_uring_queue(const io_uring_queue &) = delete;
+  io_uring_queue &operator=(const io_uring_queue &) = delete;
+
+  ~io_uring_queue() { release(); }
+
+  bool ok() const { return ring_fd >= 0; }
+
+  /*
+   * submits a vectored read, tagged by user_data
+   */
+  void read(int fd, const iovec *iov, off_t off, uint64_t user_data) {
+    unsigned tail = *sq_tail;
+    unsigned idx = tail & sq_mask;
+    io_uring_sqe *sqe = sqes + idx;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)iov;
+    sqe->len = 1;
+    sqe->off = off;
+    sqe->user_data = user_data;
+    sq_array[idx] = idx;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    while (enter(1, 0, 0) < 0 && (errno == EINTR || errno == EAGAIN))
+      ;
+  }
+
+  /*
+   * waits for a completion, returning its tag and result
+   */
+  void wait(uint64_t &user_data, int &res) {
+    unsigned head = *cq_head;
+    while (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+      enter(0, 1, IORING_ENTER_GETEVENTS);
+    io_uring_cqe *cqe = cqes + (head & cq_mask);
+    user_data = cqe->user_data;
+    res = cqe->res;
+    __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+  }
+
+ private:
+  int ring_fd;
+  bool single_mmap = false;
+  size_t sq_len = 0, cq_len = 0, sqes_len = 0;
+  void *sq_ring = MAP_FAILED, *cq_ring = MAP_FAILED;
+  io_uring_sqe *sqes = (io_uring_sqe *)MAP_FAILED;
+  unsigned *sq_tail, *sq_array, sq_mask;
+  unsigned *cq_head, *cq_tail, cq_mask;
+  io_uring_cqe *cqes;
+
+  void *map(size_t len, off_t off) {
+    return mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring_fd, off);
+  }
+
+  int enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                        flags, nullptr, 0);
+  }
+
+  void release() {
+    if (ring_fd < 0) return;
+    if (sqes != MAP_FAILED) munmap(sqes, sqes_len);
+    if (!single_mmap && cq_ring != MAP_FAILED) munmap(cq_ring, cq_len);
+    if (sq_ring != MAP_FAILED) munmap(sq_ring, sq_len);
+    close(ring_fd);
+    ring_fd = -1;
+  }
+};
+#endif
+
+/*
+ * Opens a file for asynchronous reading, with direct I/O if requested and
+ * supported by the file system.
+ * On return, direct tells whether direct I/O is in use.
+ */
+static inline int async_open(const char *fname, bool &direct) {
+  if (direct) {
+    int fd = open(fname, O_RDONLY | O_DIRECT);
+    if (fd >= 0) return fd;
+    direct = false;
+  }
+  return open(fname, O_RDONLY);
+}
+
+/*
+ * Reads the file range [begin, end) by large blocks, keeping a number of reads
+ * in flight (i.e., the depth) so that the device works ahead of the consumer.
+ *
+ * Reads are submitted to io_uring if available, or else served by a pool of
+ * I/O threads. Blocks are returned in file order, each by a fresh line block.
+ *
+ * With direct I/O, buffers, offsets and lengths are aligned: the range is
+ * read from the aligned offset preceding its begin, and the leading bytes are
+ * skipped.
+ */
+class async_reader {
+  struct slot {
+    pico::line_block *blk = nullptr;
+    iovec iov;
+    off_t off;
+    size_t skip, want;
+    ssize_t res;
+    bool done;
+  };
+
+ public:
+  async_reader(int fd_, off_t begin, off_t end_, unsigned depth,
+               size_t block_size_, bool direct)
+      : fd(fd_),
+        end(end_),
+        align(direct ? ASYNC_IO_ALIGN : 1),
+        block_size((std::max<size_t>(block_size_, 1) + align - 1) / align *
+                   align),
+        slots(std::max(depth, 1u)) {
+    next_off = begin / align * align;
+    skip = begin - next_off;
+#ifdef PICO_IO_URING
+    ring = new io_uring_queue(slots.size());
+    if (!ring->ok()) {
+      delete ring;
+      ring = nullptr;
+    }
+#endif
+    for (auto &s : slots) issue(s);
+  }
+
+  async_reader(const async_reader &) = delete;
+  async_reader &operator=(const async_reader &) = delete;
+
+  ~async_reader() {
+    /* drain the reads in flight */
+    for (auto &s : slots)
+      if (s.blk) {
+        wait(s);
+        s.blk->unref();
+      }
+#ifdef PICO_IO_URING
+    delete ring;
+#endif
+  }
+
+  /*
+   * Returns the next block and its bytes within the range, or nullptr at the
+   * end of the range. The caller owns a reference to the returned block.
+   */
+  pico::line_block *next(char *&data, size_t &len) {
+    auto &s = slots[head];
+    if (!s.blk) return nullptr;
+    wait(s);
+    if (s.res < 0) {
+      fprintf(stderr, "Unable to read input file: %s\n", strerror(-s.res));
+      exit(1);
+    }
+
+    /*
+     * Complete short reads synchronously. With direct I/O, the remainder is
+     * read again from the aligned offset preceding it.
+     */
+    size_t got = s.res;
+    while (got < s.want) {
+      size_t from = got / align * align;
+      ssize_t r = pread(fd, s.blk->data() + from, s.iov.iov_len - from,
+                        s.off + from);
+      if (r < 0 && errno == EINTR) continue;
+      if (r < 0) {
+        fprintf(stderr, "Unable to read input file: %s\n", strerror(errno));
+        exit(1);
+      }
+      if (from + r <= got) break;  // end of file
+      got = from + r;
+    }
+
+    auto res = s.blk;
+    data = res->data() + s.skip;
+    len = std::min(got, s.want) - std::min(got, s.skip);
+    s.blk = nullptr;
+
+    /* refill the slot, that becomes the last in file order */
+    issue(s);
+    head = (head + 1) % slots.size();
+    return res;
+  }
+
+ private:
+  int fd;
+  off_t end, next_off;
+  size_t align, block_size, skip;
+  std::vector<slot> slots;
+  unsigned head = 0;
+#ifdef PICO_IO_URING
+  io_uring_queue *ring = nullptr;
+#endif
+
+  /* completion of thread-pool reads */
+  std::mutex mtx;
+  std::condition_variable cv;
+
+  pico::line_block *make_block(size_t len) {
+    if (align == 1) return pico::line_block::make(len);
+    void *buf;
+    if (posix_memalign(&buf, align, len)) {
+      fprintf(stderr, "Unable to allocate aligned buffer\n");
+      exit(1);
+    }
+    auto release = [](pico::line_block *b) { free(b->data()); };
+    return pico::line_block::wrap((char *)buf, len, release);
+  }
+
+  void issue(slot &s) {
+    if (next_off >= end) return;
+    s.off = next_off;
+    s.skip = skip;
+    s.want = std::min<off_t>(block_size, end - next_off);
+    size_t len = (s.want + align - 1) / align * align;
+    s.blk = make_block(len);
+    s.iov.iov_base = s.blk->data();
+    s.iov.iov_len = len;
+    s.done = false;
+    next_off += s.want;
+    skip = 0;
+
+#ifdef PICO_IO_URING
+    if (ring) {
+      ring->read(fd, &s.iov, s.off, &s - slots.data());
+      return;
+    }
+#endif
+    io_thread_pool::get().submit([this, &s]() {
+      ssize_t r = pread(fd, s.iov.iov_base, s.iov.iov_len, s.off);
+      if (r < 0) r = -errno;
+      std::lock_guard<std::mutex> lock(mtx);
+      s.res = r;
+      s.done = true;
+      cv.notify_all();
+    });
+  }
+
+  void wait(slot &s) {
+#ifdef PICO_IO_URING
+    if (ring) {
+      while (!s.done) {
+        uint64_t i;
+        int res;
+        ring->wait(i, res);
+        slots[i].res = res;
+        slots[i].done = true;
+      }
+      return;
+    }
+#endif
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&s]() { return s.done; });
+  }
+};
+
+#endif /* INTERNALS_FFOPERATORS_INOUT_ASYNCREADER_HPP_ */
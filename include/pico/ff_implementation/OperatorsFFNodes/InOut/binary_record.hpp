@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_INOUT_BINARYRECORD_HPP_
+#define INTERNALS_FFOPERATORS_INOUT_BINARYRECORD_HPP_
+
+#include <unistd.h>
+
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+#include "pico/KeyValue.hpp"
+
+/*
+ * Fixed-size binary encoding of collection items.
+ *
+ * Trivially-copyable items are stored by their object representation, while
+ * key-value pairs with trivially-copyable keys and values are stored as a
+ * plain key-value struct.
+ * Records are stored in host byte order and layout.
+ */
+template <typename T>
+struct binary_record {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "binary records require trivially-copyable types");
+
+  static constexpr size_t size = sizeof(T);
+
+  static inline void store(char *dst, const T &x) { memcpy(dst, &x, size); }
+
+  /* builds an item at the given (uninitialized) slot */
+  static inline void load(T *slot, const char *src) { memcpy(slot, src, size); }
+};
+
+template <typename K, typename V>
+struct binary_record<pico::KeyValue<K, V>> {
+  static_assert(std::is_trivially_copyable<K>::value &&
+                    std::is_trivially_copyable<V>::value,
+                "binary records require trivially-copyable keys and values");
+
+  struct kv_record {
+    K key;
+    V value;
+  };
+
+  static constexpr size_t size = sizeof(kv_record);
+
+  static inline void store(char *dst, const pico::KeyValue<K, V> &kv) {
+    kv_record r{kv.Key(), kv.Value()};
+    memcpy(dst, &r, size);
+  }
+
+  static inline void load(pico::KeyValue<K, V> *slot, const char *src) {
+    kv_record r;
+    memcpy(&r, src, size);
+    new (slot) pico::KeyValue<K, V>(r.key, r.value);
+  }
+};
+
+#endif /* INTERNALS_FFOPERATORS_INOUT_BINARYRECORD_HPP_ */
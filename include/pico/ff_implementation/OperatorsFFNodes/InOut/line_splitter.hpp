@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_INOUT_LINESPLITTER_HPP_
+#define INTERNALS_FFOPERATORS_INOUT_LINESPLITTER_HPP_
+
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "pico/LineView.hpp"
+
+/*
+ * Size of the shared blocks backing LineView records.
+ */
+#define LINE_BLOCK_SIZE (1 << 20)
+
+/*
+ * Splits a byte stream into delimited lines, backed by shared line blocks.
+ *
+ * Bytes are read into the current block by read_f(buf, count), returning the
+ * number of read bytes (0 at end of stream, negative on error).
+ * Each line is passed to line_f(block, begin, length), that is expected to
+ * take its own reference to the block (e.g., by building a LineView).
+ * A line crossing the end of a block is moved at the head of the next block,
+ * that is enlarged if the line does not fit.
+ *
+ * The splitter is resumable, so that many streams (e.g., non-blocking
+ * sockets) can be split in an interleaved fashion.
+ */
+class line_splitter {
+ public:
+  line_splitter(char delimiter_, size_t block_size_ = LINE_BLOCK_SIZE)
+      : delimiter(delimiter_),
+        block_size(block_size_),
+        blk(pico::line_block::make(block_size_)) {}
+
+  line_splitter(const line_splitter &) = delete;
+  line_splitter &operator=(const line_splitter &) = delete;
+
+  ~line_splitter() { blk->unref(); }
+
+  /*
+   * reads once and splits the read bytes, returning the result of read_f
+   */
+  template <typename ReadF, typename LineF>
+  ssize_t read(ReadF &&read_f, LineF &&line_f) {
+    if (fill == blk->capacity()) {
+      /* move the partial line to a fresh block */
+      size_t partial = fill - start;
+      auto next = pico::line_block::make(std::max(block_size, 2 * partial));
+      memcpy(next->data(), blk->data() + start, partial);
+      blk->unref();
+      blk = next;
+      fill = partial;
+      start = 0;
+    }
+
+    ssize_t n = read_f(blk->data() + fill, blk->capacity() - fill);
+    if (n <= 0) return n;
+
+    /* scan the new bytes for delimiters */
+    char *base = blk->data(), *scan = base + fill, *end = scan + n;
+    char *p;
+    while ((p = (char *)memchr(scan, delimiter, end - scan))) {
+      line_f(blk, base + start, p - (base + start));
+      start = p + 1 - base;
+      scan = p + 1;
+    }
+    fill += n;
+    return n;
+  }
+
+  /*
+   * passes the last line, not terminated by a delimiter
+   */
+  template <typename LineF>
+  void finish(LineF &&line_f) {
+    if (fill > start) line_f(blk, blk->data() + start, fill - start);
+    start = fill;
+  }
+
+ private:
+  char delimiter;
+  size_t block_size;
+  pico::line_block *blk;
+  size_t fill = 0, start = 0;
+};
+
+template <typename ReadF, typename LineF>
+static void split_lines(char delimiter, ReadF &&read_f, LineF &&line_f,
+                        size_t block_size = LINE_BLOCK_SIZE) {
+  line_splitter splitter(delimiter, block_size);
+  while (splitter.read(read_f, line_f) > 0)
+    ;
+  splitter.finish(line_f);
+}
+
+/*
+ * Splits a sequence of filled blocks into delimited lines.
+ *
+ * Blocks are obtained by next_f(begin, length), returning nullptr at the end
+ * of the stream, each one with a reference that is dropped once it is split.
+ * Lines are passed to line_f as in split_lines: lines within a block point
+ * into it, while a line crossing block boundaries is assembled into a
+ * dedicated block.
+ */
+template <typename NextF, typename LineF>
+static void split_blocks(char delimiter, NextF &&next_f, LineF &&line_f) {
+  std::string partial;  // a line crossing block boundaries
+  auto join_f = [&](const char *p, size_t len) {
+    auto blk = pico::line_block::make(partial.size() + len);
+    memcpy(blk->data(), partial.data(), partial.size());
+    memcpy(blk->data() + partial.size(), p, len);
+    line_f(blk, blk->data(), partial.size() + len);
+    blk->unref();
+    partial.clear();
+  };
+
+  char *p;
+  size_t len;
+  pico::line_block *blk;
+  while ((blk = next_f(p, len))) {
+    char *end = p + len, *q;
+    while ((q = (char *)memchr(p, delimiter, end - p))) {
+      if (partial.empty())
+        line_f(blk, p, q - p);
+      else
+        join_f(p, q - p);
+      p = q + 1;
+    }
+    partial.append(p, end - p);
+    blk->unref();
+  }
+
+  /* last line, not terminated by a delimiter */
+  if (!partial.empty()) join_f("", 0);
+}
+
+#endif /* INTERNALS_FFOPERATORS_INOUT_LINESPLITTER_HPP_ */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_INOUT_MAPPEDRANGE_HPP_
+#define INTERNALS_FFOPERATORS_INOUT_MAPPEDRANGE_HPP_
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+
+#include "pico/LineView.hpp"
+
+/*
+ * A read-only mapping of the file range [begin, end).
+ *
+ * The mapping is owned by a line block, so that it is unmapped when the last
+ * line pointing into it is destroyed.
+ * The page cache is hinted either for a sequential scan with read-ahead, or
+ * for random accesses (e.g., for probing a few split points).
+ */
+struct mapped_range {
+  mapped_range(int fd, off_t begin, off_t end, bool sequential = true) {
+    if (end <= begin) return;
+    off_t page = sysconf(_SC_PAGESIZE);
+    off_t map_begin = begin / page * page;
+    size_t map_len = end - map_begin;
+    void *base = mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fd, map_begin);
+    if (base == MAP_FAILED) {
+      fprintf(stderr, "Unable to map input file range [%lld, %lld)\n",
+              (long long)begin, (long long)end);
+      exit(1);
+    }
+    if (sequential) {
+      madvise(base, map_len, MADV_SEQUENTIAL);
+      madvise(base, map_len, MADV_WILLNEED);
+    } else
+      madvise(base, map_len, MADV_RANDOM);
+    auto unmap = [](pico::line_block *b) { munmap(b->data(), b->capacity()); };
+    blk = pico::line_block::wrap((char *)base, map_len, unmap);
+    first = (char *)base + (begin - map_begin);
+    last = (char *)base + map_len;
+  }
+
+  mapped_range(const mapped_range &) = delete;
+  mapped_range &operator=(const mapped_range &) = delete;
+
+  ~mapped_range() {
+    if (blk) blk->unref();
+  }
+
+  /*
+   * Calls line_f(block, begin, length) for each line.
+   *
+   * Delimiters are searched by memchr, that is vectorized by the C library
+   * (e.g., SSE2/AVX2 on x86-64).
+   */
+  template <typename LineF>
+  void for_each_line(char delimiter, LineF &&line_f) const {
+    const char *p = first, *q;
+    while (p < last && (q = (const char *)memchr(p, delimiter, last - p))) {
+      line_f(blk, p, q - p);
+      p = q + 1;
+    }
+    if (p < last) line_f(blk, p, last - p);
+  }
+
+  /*
+   * Calls chunk_f(begin, end) for consecutive chunks covering the range, given
+   * as offsets from its beginning. Each chunk spans at least step bytes
+   * (except the last one) and ends right after a delimiter.
+   */
+  template <typename ChunkF>
+  void for_each_chunk(char delimiter, size_t step, ChunkF &&chunk_f) const {
+    size_t size = last - first, begin = 0;
+    assert(step > 0);
+    while (size - begin > step) {
+      const char *from = first + begin + step - 1;
+      auto nl = (const char *)memchr(from, delimiter, last - from);
+      if (!nl) break;
+      size_t end = nl + 1 - first;
+      chunk_f(begin, end);
+      begin = end;
+    }
+    if (size > begin) chunk_f(begin, size);
+  }
+
+  const char *data() const { return first; }
+
+  size_t size() const { return last - first; }
+
+  pico::line_block *blk = nullptr;
+  const char *first = nullptr, *last = nullptr;
+};
+
+/*
+ * builds a line at the given slot, either by copy or as a view
+ */
+template <typename Line>
+static inline void build_line(Line *slot, pico::line_block *blk,
+                              const char *p, size_t len) {
+  if constexpr (std::is_same<Line, pico::LineView>::value)
+    new (slot) pico::LineView(blk, p, len);
+  else
+    new (slot) Line(p, len);
+}
+
+#endif /* INTERNALS_FFOPERATORS_INOUT_MAPPEDRANGE_HPP_ */
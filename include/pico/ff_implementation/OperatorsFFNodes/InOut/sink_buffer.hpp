@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_INOUT_SINKBUFFER_HPP_
+#define INTERNALS_FFOPERATORS_INOUT_SINKBUFFER_HPP_
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+
+#include "pico/ff_implementation/ff_config.hpp"
+
+/*
+ * Size of the output buffers of sink nodes.
+ */
+#define SINK_BUFFER_SIZE (1 << 20)
+
+/*
+ * Opens (and truncates) an output file, exiting on failure.
+ */
+static inline int open_output(const std::string &fname) {
+  int fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Unable to open output file %s\n", fname.c_str());
+    exit(1);
+  }
+  return fd;
+}
+
+/*
+ * An output file written in parallel by nwriters sink buffers.
+ *
+ * Microbatches are dealt to the writers round-robin, thus the j-th microbatch
+ * of the i-th writer is the (j * nwriters + i)-th one of the stream.
+ * Each microbatch is written to the region following the one of its
+ * predecessor in the stream (i.e., at the prefix sum of the formatted sizes),
+ * so that the file holds the records in stream order.
+ */
+struct shared_output {
+  shared_output(const std::string &fname, unsigned nwriters_)
+      : fd(open_output(fname)), nwriters(nwriters_) {}
+
+  ~shared_output() { close(fd); }
+
+  /*
+   * Reserves n bytes for the seq-th microbatch, once all the previous ones
+   * have reserved theirs, and returns the offset of the region.
+   */
+  off_t reserve(unsigned long long seq, size_t n) {
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [&]() { return next_seq == seq; });
+    off_t res = offset;
+    offset += n;
+    ++next_seq;
+    cv.notify_all();
+    return res;
+  }
+
+  const int fd;
+  const unsigned nwriters;
+
+ private:
+  std::mutex mtx;
+  std::condition_variable cv;
+  unsigned long long next_seq = 0;
+  off_t offset = 0;
+};
+
+/*
+ * A user-space output buffer for sink nodes, to be used as the streambuf of
+ * a std::ostream.
+ *
+ * Records are formatted into a large contiguous buffer, that is written out
+ * by a single write once full, so that no flush (nor system call) is issued
+ * per record.
+ *
+ * With an asynchronous writer, full buffers are handed to a dedicated thread
+ * and formatting goes on into a second buffer, so that the kernel writes one
+ * buffer while the next one is being filled.
+ *
+ * With a target stream buffer (e.g., the one of std::cout), buffers are written
+ * to it rather than to a file descriptor, so that redirections are honoured.
+ *
+ * With a shared output, a whole microbatch is formatted into the buffer
+ * (grown as needed) and, once committed, written (by pwrite) at the region
+ * reserved for it in the shared file.
+ */
+class sink_buffer : public std::streambuf {
+ public:
+  sink_buffer(int fd_, bool owned_, bool async, size_t size_ = SINK_BUFFER_SIZE)
+      : fd(fd_), owned(owned_), size(size_) {
+    init(async);
+  }
+
+  sink_buffer(std::streambuf *sink_, bool async,
+              size_t size_ = SINK_BUFFER_SIZE)
+      : fd(-1), owned(false), size(size_), sink(sink_) {
+    init(async);
+  }
+
+  sink_buffer(shared_output *shared_, unsigned rank, bool async,
+              size_t size_ = SINK_BUFFER_SIZE)
+      : fd(shared_->fd),
+        owned(false),
+        size(size_),
+        shared(shared_),
+        seq(rank) {
+    init(async);
+  }
+
+  sink_buffer(const sink_buffer &) = delete;
+  sink_buffer &operator=(const sink_buffer &) = delete;
+
+  ~sink_buffer() {
+    flush();
+    if (writer.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+      }
+      cv.notify_all();
+      writer.join();
+    }
+    FREE(bufs[0]);
+    if (bufs[1]) FREE(bufs[1]);
+    if (owned) close(fd);
+  }
+
+  /*
+   * hands out the buffered bytes, without waiting for them to be written
+   * (with a shared output, bytes are only handed out by commit)
+   */
+  void push() {
+    size_t n = pptr() - pbase();
+    if (!n || shared) return;
+    hand_out(n, 0);
+  }
+
+  /*
+   * ends a microbatch: with a shared output, the buffered bytes are handed
+   * out to the region reserved for the microbatch
+   */
+  void commit() {
+    if (!shared) return;
+    size_t n = pptr() - pbase();
+    off_t off = shared->reserve(seq, n);
+    seq += shared->nwriters;
+    if (n) hand_out(n, off);
+  }
+
+  /*
+   * writes out all the buffered bytes
+   */
+  void flush() {
+    push();
+    if (writer.joinable()) {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [this]() { return !pending; });
+    }
+    if (sink && dirty) {
+      sink->pubsync();
+      dirty = false;
+    }
+  }
+
+ protected:
+  int_type overflow(int_type c) {
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+      return traits_type::not_eof(c);
+    make_room();
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+  }
+
+  std::streamsize xsputn(const char *s, std::streamsize n) {
+    std::streamsize res = n;
+    while (n) {
+      if (pptr() == epptr()) make_room();
+      std::streamsize chunk = std::min<std::streamsize>(n, epptr() - pptr());
+      memcpy(pptr(), s, chunk);
+      pbump((int)chunk);
+      s += chunk;
+      n -= chunk;
+    }
+    return res;
+  }
+
+  int sync() {
+    flush();
+    return 0;
+  }
+
+ private:
+  int fd;
+  bool owned;
+  size_t size;
+  shared_output *shared = nullptr;
+  unsigned long long seq = 0;  // of the next microbatch, if shared
+  std::streambuf *sink = nullptr;
+  bool dirty = false;  // written to the sink since last sync
+  char *bufs[2];
+
+  /* asynchronous writer */
+  std::thread writer;
+  std::mutex mtx;
+  std::condition_variable cv;
+  char *pending = nullptr;
+  size_t pending_len = 0;
+  off_t pending_off = 0;
+  bool stop = false;
+
+  void init(bool async) {
+    bufs[0] = (char *)MALLOC(size);
+    bufs[1] = async ? (char *)MALLOC(size) : nullptr;
+    setp(bufs[0], bufs[0] + size);
+    if (async) writer = std::thread([this]() { write_loop(); });
+  }
+
+  /*
+   * makes room in a full buffer: the buffered microbatch is kept whole if the
+   * output is shared
+   */
+  void make_room() {
+    if (shared)
+      grow();
+    else
+      push();
+  }
+
+  /*
+   * hands out the n buffered bytes (to be written at off, if shared)
+   */
+  void hand_out(size_t n, off_t off) {
+    if (!writer.joinable()) {
+      write_all(pbase(), n, off);
+      setp(pbase(), epptr());
+      return;
+    }
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this]() { return !pending; });
+    pending = pbase();
+    pending_len = n;
+    pending_off = off;
+    cv.notify_all();
+    char *next = pbase() == bufs[0] ? bufs[1] : bufs[0];
+    setp(next, next + size);
+  }
+
+  /*
+   * doubles the buffers, keeping the buffered bytes
+   */
+  void grow() {
+    if (writer.joinable()) {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [this]() { return !pending; });
+    }
+    size_t n = pptr() - pbase();
+    for (auto &b : bufs) {
+      if (!b) continue;
+      char *nb = (char *)MALLOC(2 * size);
+      if (b == pbase()) {
+        memcpy(nb, b, n);
+        setp(nb, nb + 2 * size);
+        pbump((int)n);
+      }
+      FREE(b);
+      b = nb;
+    }
+    size *= 2;
+  }
+
+  void write_all(const char *p, size_t n, off_t off) {
+    if (sink) {
+      if (sink->sputn(p, n) != (std::streamsize)n) {
+        fprintf(stderr, "Unable to write output\n");
+        exit(1);
+      }
+      dirty = true;
+      return;
+    }
+    while (n) {
+      ssize_t r = shared ? pwrite(fd, p, n, off) : write(fd, p, n);
+      if (r <= 0) {
+        fprintf(stderr, "Unable to write output\n");
+        exit(1);
+      }
+      p += r;
+      off += r;
+      n -= r;
+    }
+  }
+
+  void write_loop() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+      cv.wait(lock, [this]() { return pending || stop; });
+      if (!pending) return;
+      auto p = pending;
+      auto n = pending_len;
+      auto off = pending_off;
+      lock.unlock();
+      write_all(p, n, off);
+      lock.lock();
+      pending = nullptr;
+      cv.notify_all();
+    }
+  }
+};
+
+#endif /* INTERNALS_FFOPERATORS_INOUT_SINKBUFFER_HPP_ */
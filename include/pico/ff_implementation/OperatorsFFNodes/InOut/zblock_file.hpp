@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_INOUT_ZBLOCKFILE_HPP_
+#define INTERNALS_FFOPERATORS_INOUT_ZBLOCKFILE_HPP_
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "pico/LineView.hpp"
+
+/*
+ * Default size (in uncompressed bytes) of the blocks of compressed files.
+ */
+#define ZBLOCK_SIZE (1 << 20)
+
+/*
+ * Block-compressed text files.
+ *
+ * A file is a sequence of independently compressed blocks, followed by an
+ * index of the blocks and a fixed-size trailer:
+ *
+ *   file    := "PICOZB01" block* index trailer
+ *   block   := zlib stream of whole lines, each terminated by '\n'
+ *   index   := { u64 offset, u32 compressed size, u32 size } per block
+ *   trailer := u64 number of blocks, u64 index offset, "PICOZIX1"
+ *
+ * Integers are stored in little-endian byte order, whatever the host one.
+ * Block sizes are 32-bit, thus blocks larger than 4GB (e.g., holding a huge
+ * line) are rejected.
+ * Since no line crosses block boundaries, each block can be decompressed and
+ * split into lines independently of the others.
+ */
+namespace zblock {
+
+static constexpr char file_magic[8] = {'P', 'I', 'C', 'O', 'Z', 'B', '0', '1'};
+static constexpr char index_magic[8] = {'P', 'I', 'C', 'O',
+                                        'Z', 'I', 'X', '1'};
+
+struct entry {
+  uint64_t offset;
+  uint32_t csize, size;
+};
+
+/* on-disk sizes */
+static constexpr size_t entry_bytes = 16;
+static constexpr size_t trailer_bytes = 24;
+
+static inline void put_le(char *p, uint64_t v, unsigned bytes) {
+  for (unsigned i = 0; i < bytes; ++i) p[i] = (char)(v >> (8 * i));
+}
+
+static inline uint64_t get_le(const char *p, unsigned bytes) {
+  uint64_t v = 0;
+  for (unsigned i = 0; i < bytes; ++i)
+    v |= (uint64_t)(unsigned char)p[i] << (8 * i);
+  return v;
+}
+
+static inline bool pread_all(int fd, void *buf, size_t len, off_t off) {
+  char *p = (char *)buf;
+  while (len) {
+    ssize_t r = pread(fd, p, len, off);
+    if (r <= 0) return false;
+    p += r;
+    off += r;
+    len -= r;
+  }
+  return true;
+}
+
+static inline bool write_all(int fd, const void *buf, size_t len) {
+  const char *p = (const char *)buf;
+  while (len) {
+    ssize_t r = write(fd, p, len);
+    if (r <= 0) return false;
+    p += r;
+    len -= r;
+  }
+  return true;
+}
+
+/*
+ * Loads the block index of a compressed file.
+ * Returns false if the file is not a valid block-compressed file.
+ */
+static inline bool read_index(int fd, std::vector<entry> &index) {
+  struct stat st;
+  char magic[8], t[trailer_bytes];
+  if (fstat(fd, &st) || st.st_size < (off_t)(sizeof(magic) + trailer_bytes))
+    return false;
+  if (!pread_all(fd, magic, sizeof(magic), 0) ||
+      memcmp(magic, file_magic, sizeof(magic)))
+    return false;
+  if (!pread_all(fd, t, trailer_bytes, st.st_size - trailer_bytes) ||
+      memcmp(t + 16, index_magic, sizeof(index_magic)))
+    return false;
+  uint64_t n_blocks = get_le(t, 8), index_offset = get_le(t + 8, 8);
+  if (n_blocks > (uint64_t)st.st_size / entry_bytes ||
+      index_offset + n_blocks * entry_bytes + trailer_bytes !=
+          (uint64_t)st.st_size)
+    return false;
+  std::vector<char> raw(n_blocks * entry_bytes);
+  if (!pread_all(fd, raw.data(), raw.size(), index_offset)) return false;
+  index.resize(n_blocks);
+  for (uint64_t i = 0; i < n_blocks; ++i) {
+    const char *p = raw.data() + i * entry_bytes;
+    index[i] = entry{get_le(p, 8), (uint32_t)get_le(p + 8, 4),
+                     (uint32_t)get_le(p + 12, 4)};
+  }
+  return true;
+}
+
+/*
+ * Reads and decompresses a block into a fresh line block.
+ * The caller owns a reference to the returned block.
+ */
+static inline pico::line_block *read_block(int fd, const entry &e,
+                                           std::string &cbuf) {
+  cbuf.resize(e.csize);
+  auto blk = pico::line_block::make(e.size);
+  uLongf len = e.size;
+  if (!pread_all(fd, &cbuf[0], e.csize, e.offset) ||
+      uncompress((Bytef *)blk->data(), &len, (const Bytef *)cbuf.data(),
+                 e.csize) != Z_OK ||
+      len != e.size) {
+    fprintf(stderr, "Corrupted compressed block at offset %llu\n",
+            (unsigned long long)e.offset);
+    exit(1);
+  }
+  return blk;
+}
+
+/*
+ * Calls line_f(block, begin, length) for each line of a decompressed block.
+ */
+template <typename LineF>
+static void for_each_line(pico::line_block *blk, size_t size,
+                          LineF &&line_f) {
+  const char *p = blk->data(), *end = p + size, *q;
+  while (p < end && (q = (const char *)memchr(p, '\n', end - p))) {
+    line_f(blk, p, q - p);
+    p = q + 1;
+  }
+  if (p < end) line_f(blk, p, end - p);
+}
+
+/*
+ * Writes a block-compressed file, line by line.
+ */
+class writer {
+ public:
+  writer(const std::string &fname, size_t block_size_ = ZBLOCK_SIZE,
+         int level_ = Z_DEFAULT_COMPRESSION)
+      : block_size(block_size_), level(level_) {
+    fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || !write_all(fd, file_magic, sizeof(file_magic))) {
+      fprintf(stderr, "Unable to open output file %s\n", fname.c_str());
+      exit(1);
+    }
+    offset = sizeof(file_magic);
+    buf.reserve(block_size);
+  }
+
+  writer(const writer &) = delete;
+  writer &operator=(const writer &) = delete;
+
+  ~writer() { finish(); }
+
+  /*
+   * flushes the last block, writes the index and closes the file
+   */
+  void finish() {
+    if (fd < 0) return;
+    flush();
+    std::vector<char> raw(index.size() * entry_bytes + trailer_bytes);
+    char *p = raw.data();
+    for (auto &e : index) {
+      put_le(p, e.offset, 8);
+      put_le(p + 8, e.csize, 4);
+      put_le(p + 12, e.size, 4);
+      p += entry_bytes;
+    }
+    put_le(p, index.size(), 8);
+    put_le(p + 8, offset, 8);
+    memcpy(p + 16, index_magic, sizeof(index_magic));
+    if (!write_all(fd, raw.data(), raw.size()))
+      fprintf(stderr, "Unable to write compressed file index\n");
+    close(fd);
+    fd = -1;
+  }
+
+  /*
+   * appends a line (without delimiter), starting a new block if the current
+   * one would overflow
+   */
+  void write_line(const char *p, size_t len) {
+    assert(fd >= 0);
+    if (!buf.empty() && buf.size() + len + 1 > block_size) flush();
+    buf.append(p, len);
+    buf.push_back('\n');
+  }
+
+  void write_line(const std::string &s) { write_line(s.data(), s.size()); }
+
+  /*
+   * compresses and writes the current block
+   */
+  void flush() {
+    if (buf.empty()) return;
+    if (buf.size() > UINT32_MAX || compressBound(buf.size()) > UINT32_MAX) {
+      fprintf(stderr, "Compressed block too large (%zu bytes)\n", buf.size());
+      exit(1);
+    }
+    uLongf clen = compressBound(buf.size());
+    cbuf.resize(clen);
+    if (compress2((Bytef *)&cbuf[0], &clen, (const Bytef *)buf.data(),
+                  buf.size(), level) != Z_OK ||
+        !write_all(fd, cbuf.data(), clen)) {
+      fprintf(stderr, "Unable to write compressed block\n");
+      exit(1);
+    }
+    index.push_back(entry{offset, (uint32_t)clen, (uint32_t)buf.size()});
+    offset += clen;
+    buf.clear();
+  }
+
+ private:
+  int fd;
+  const size_t block_size;
+  const int level;
+  uint64_t offset;
+  std::string buf, cbuf;
+  std::vector<entry> index;
+};
+
+} /* namespace zblock */
+
+#endif /* INTERNALS_FFOPERATORS_INOUT_ZBLOCKFILE_HPP_ */
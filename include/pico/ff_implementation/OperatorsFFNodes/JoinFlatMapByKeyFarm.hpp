@@ -21,11 +21,18 @@
 #ifndef INTERNALS_FFOPERATORS_BINARYMAPFARM_HPP_
 #define INTERNALS_FFOPERATORS_BINARYMAPFARM_HPP_
 
+#include <memory>
+#include <ostream>
 #include <unordered_map>
+#include <vector>
 
 #include "pico/FlatMapCollector.hpp"
+#include "pico/Internals/JoinTable.hpp"
+#include "pico/Internals/KVMicrobatch.hpp"
 #include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
 
+#include "pico/ff_implementation/SupportFFNodes/MapSideCombiner.hpp"
 #include "pico/ff_implementation/SupportFFNodes/PairFarm.hpp"
 #include "pico/ff_implementation/SupportFFNodes/RBKOptFarm.hpp"
 
@@ -51,13 +58,15 @@ class base_JFMBK_Farm : public NonOrderingFarm {
   /*
    * The emitter dispatches microbatch items based on key and
    * keep tracking the origin.
+   * Items are buffered into a single (full-size) micro-batch per worker,
+   * holding items with different keys.
    */
   typedef base_emitter emitter_t;
   class Emitter : public emitter_t {
     typedef pico::base_microbatch::tag_t tag_t;
 
    public:
-    Emitter(unsigned nworkers_, unsigned mbsize_, NonOrderingFarm &farm_)
+    Emitter(unsigned nworkers_, unsigned mbsize_)
         : emitter_t(nworkers_),  //
           nworkers(nworkers_),
           mbsize(mbsize_),
@@ -78,12 +87,12 @@ class base_JFMBK_Farm : public NonOrderingFarm {
       if (origin_mb->payload() == PICO_CSTREAM_FROM_LEFT) {
         send_mb(make_sync(cstream_begin_tag, PICO_CSTREAM_FROM_LEFT));
         s.from_left = true;
-        s.mb2w_from_left = std::vector<key_state1>(nworkers);
+        s.mb2w_from_left = std::vector<mb_in1 *>(nworkers, nullptr);
       } else {
         assert(origin_mb->payload() == PICO_CSTREAM_FROM_RIGHT);
         send_mb(make_sync(cstream_begin_tag, PICO_CSTREAM_FROM_RIGHT));
         s.from_left = false;
-        s.mb2w_from_right = std::vector<key_state2>(nworkers);
+        s.mb2w_from_right = std::vector<mb_in2 *>(nworkers, nullptr);
       }
 
       /* cleanup */
@@ -108,11 +117,12 @@ class base_JFMBK_Farm : public NonOrderingFarm {
       if (s.from_left) {
         auto in_mb = reinterpret_cast<mb_in1 *>(in_mb_);
         dispatch(in_mb, s.mb2w_from_left);
+        DELETE(in_mb);
       } else {
         auto in_mb = reinterpret_cast<mb_in2 *>(in_mb_);
         dispatch(in_mb, s.mb2w_from_right);
+        DELETE(in_mb);
       }
-      DELETE(in_mb_);
     }
 
     /* on finalizing, flush remainder micro-batches */
@@ -132,42 +142,34 @@ class base_JFMBK_Farm : public NonOrderingFarm {
     void dispatch(mb_t *in_mb, mb2w_t &mb2w) {
       using In = typename mb_t::DataType;
       auto tag = in_mb->tag();
-      for (auto tt : *in_mb) {
-        auto k = tt.Key();
-        auto dst = key_to_worker(k);
-        // create k-dst microbatch if not existing
-        if (mb2w[dst].find(k) == mb2w[dst].end())
-          mb2w[dst][k] = NEW<mb_t>(tag, mbsize);
+      for (auto &tt : *in_mb) {
+        auto dst = key_to_worker(tt.Key());
+        // create dst microbatch if not existing
+        if (!mb2w[dst]) mb2w[dst] = NEW<mb_t>(tag, mbsize);
         // copy token into dst's microbatch
-        new (mb2w[dst][k]->allocate()) In(tt);
-        mb2w[dst][k]->commit();
-        if (mb2w[dst][k]->full()) {
-          send_mb_to(mb2w[dst][k], dst);
-          mb2w[dst][k] = NEW<mb_t>(tag, mbsize);
+        new (mb2w[dst]->allocate()) In(tt);
+        mb2w[dst]->commit();
+        if (mb2w[dst]->full()) {
+          send_mb_to(mb2w[dst], dst);
+          mb2w[dst] = nullptr;
         }
       }
     }
 
-    /* stream out (or delete) incomplete microbatch */
+    /* stream out incomplete microbatches */
     template <typename mb2w_t>
     void flush_remainder(mb2w_t &mb2w) {
       for (unsigned dst = 0; dst < nworkers; ++dst)
-        for (auto &k_mb : mb2w[dst])
-          if (!k_mb.second->empty())
-            send_mb_to(k_mb.second, dst);
-          else
-            DELETE(k_mb.second);  // spurious microbatch
+        if (mb2w[dst]) send_mb_to(mb2w[dst], dst);
     }
 
     unsigned nworkers;
     const unsigned mbsize;
 
-    typedef std::unordered_map<K, mb_in1 *> key_state1;
-    typedef std::unordered_map<K, mb_in2 *> key_state2;
     struct origin_state {
-      /* for both origins, one per-key microbatch for each worker */
-      std::vector<key_state1> mb2w_from_left;
-      std::vector<key_state2> mb2w_from_right;
+      /* for both origins, one microbatch (if any) for each worker */
+      std::vector<mb_in1 *> mb2w_from_left;
+      std::vector<mb_in2 *> mb2w_from_right;
       bool from_left;
     };
     std::unordered_map<pico::base_microbatch::tag_t, origin_state> tag_state;
@@ -199,9 +201,16 @@ class base_JFMBK_Farm : public NonOrderingFarm {
  * The collection tag to be cached is statically determined decided as follows:
  * - if one input pipe has input, the tag from the other pipe is cached
  * - if both input pipes are input-less, the tag from the left pipe is cached
+ *
+ * Collections are stored as build tables (see join_table), by copying the
+ * items of incoming micro-batches, that are then released.
+ *
+ * Workers are single-output nodes by default, or senders of a shuffle stage
+ * if Base is base_shuffler (constructed from the trailing arguments).
  */
-template <typename TokenTypeIn1, typename TokenTypeIn2, typename TokenTypeOut>
-class base_JFMBK_worker : public base_filter {
+template <typename TokenTypeIn1, typename TokenTypeIn2, typename TokenTypeOut,
+          typename Base = base_filter>
+class base_JFMBK_worker : public Base {
   typedef typename TokenTypeIn1::datatype In1;
   typedef typename TokenTypeIn2::datatype In2;
   typedef typename TokenTypeOut::datatype Out;
@@ -214,18 +223,22 @@ class base_JFMBK_worker : public base_filter {
   typedef pico::base_microbatch::tag_t tag_t;
 
   typedef typename pico::TokenCollector<Out>::cnode cnode_t;
-  typedef std::unordered_map<K, std::vector<mb_in1 *>> key_state_left;
-  typedef std::unordered_map<K, std::vector<mb_in2 *>> key_state_right;
+  typedef pico::join_table<In1> table_left;
+  typedef pico::join_table<In2> table_right;
   struct origin_state {
-    key_state_left kmb_from_left;
-    key_state_right kmb_from_right;
+    table_left from_left_table;
+    table_right from_right_table;
     bool from_left, cached;
   };
   typedef std::unordered_map<tag_t, origin_state> tag_state_t;
 
  public:
-  base_JFMBK_worker(kernel_t kernel_, bool left_input_)
-      : fkernel(kernel_),
+  template <typename... BaseArgs>
+  base_JFMBK_worker(kernel_t kernel_, bool left_input_, unsigned mb_size = 0,
+                    BaseArgs... base_args)
+      : Base(base_args...),
+        collector(mb_size),
+        fkernel(kernel_),
         cache_from_left(!left_input_),
         cstream_begin_rcv(false) {}
 
@@ -251,7 +264,7 @@ class base_JFMBK_worker : public base_filter {
 
     /* propagate begin if not cached */
     if (!s.cached) {
-      send_mb(make_sync(cstream_begin_tag, PICO_CSTREAM_BEGIN));
+      this->send_mb(make_sync(cstream_begin_tag, PICO_CSTREAM_BEGIN));
       non_cached_tags.push_back(cstream_begin_tag);
     } else {
       assert(cached_tag == pico::base_microbatch::nil_tag());
@@ -315,6 +328,15 @@ class base_JFMBK_worker : public base_filter {
     }
   }
 
+ protected:
+  /* the number of items stored for the given tag */
+  size_t stored(tag_t tag) const {
+    auto st = tag_state.find(tag);
+    if (st == tag_state.end()) return 0;
+    return st->second.from_left_table.size() +
+           st->second.from_right_table.size();
+  }
+
  private:
   virtual void finalize_output_tag(tag_t) = 0;
   virtual void handle_output(tag_t, cnode_t *) = 0;
@@ -333,60 +355,57 @@ class base_JFMBK_worker : public base_filter {
    */
   void from_left(mb_in1 *in_mb) {
     auto tag = in_mb->tag();
-    auto k = (*in_mb->begin()).Key();
     auto &s(tag_state[tag]);
 
     if (!s.cached && cached_tag != pico::base_microbatch::nil_tag()) {
-      auto &match_kmbs = tag_state[cached_tag].kmb_from_right[k];
-      from_left_(in_mb, match_kmbs, tag);
+      auto &match_table = tag_state[cached_tag].from_right_table;
+      from_left_(in_mb, match_table, tag);
     } else if (s.cached) {
       for (auto match_tag : non_cached_tags) {
-        auto &match_kmbs = tag_state[match_tag].kmb_from_right[k];
-        from_left_(in_mb, match_kmbs, match_tag);
+        auto &match_table = tag_state[match_tag].from_right_table;
+        from_left_(in_mb, match_table, match_tag);
       }
     }
 
-    /* store */
-    s.kmb_from_left[k].push_back(in_mb);
+    /* store, unless no cached items are left to be joined with */
+    if (s.cached || !cache_complete) s.from_left_table.insert_all(*in_mb);
+    DELETE(in_mb);
   }
 
   void from_right(mb_in2 *in_mb) {
     auto tag = in_mb->tag();
-    auto k = (*in_mb->begin()).Key();
     auto &s(tag_state[tag]);
 
     if (!s.cached && cached_tag != pico::base_microbatch::nil_tag()) {
-      auto &match_kmbs = tag_state[cached_tag].kmb_from_left[k];
-      from_right_(in_mb, match_kmbs, tag);
+      auto &match_table = tag_state[cached_tag].from_left_table;
+      from_right_(in_mb, match_table, tag);
     } else if (s.cached) {
       for (auto match_tag : non_cached_tags) {
-        auto &match_kmbs = tag_state[match_tag].kmb_from_left[k];
-        from_right_(in_mb, match_kmbs, match_tag);
+        auto &match_table = tag_state[match_tag].from_left_table;
+        from_right_(in_mb, match_table, match_tag);
       }
     }
 
-    /* store */
-    s.kmb_from_right[k].push_back(in_mb);
+    /* store, unless no cached items are left to be joined with */
+    if (s.cached || !cache_complete) s.from_right_table.insert_all(*in_mb);
+    DELETE(in_mb);
   }
 
-  void from_left_(mb_in1 *in_mb_ptr, std::vector<mb_in2 *> &ms, tag_t otag) {
+  void from_left_(mb_in1 *in_mb, table_right &t, tag_t otag) {
     collector.tag(otag);
-    for (auto &match_kmb_ptr : ms)
-      for (auto &in_kv : *in_mb_ptr)
-        for (auto &match_kv : *match_kmb_ptr)
-          fkernel(in_kv, match_kv, collector);
+    t.probe(*in_mb, [this](In1 &in_kv, In2 &match_kv) {
+      fkernel(in_kv, match_kv, collector);
+    });
     auto cb = collector.begin();
     if (cb) handle_output(otag, cb);
     collector.clear();
   }
 
-  void from_right_(mb_in2 *in_mb, std::vector<mb_in1 *> &ms, tag_t otag) {
+  void from_right_(mb_in2 *in_mb, table_left &t, tag_t otag) {
     collector.tag(otag);
-    for (auto &in_kv : *in_mb) {
-      for (auto &match_kmb_ptr : ms)
-        for (auto &match_kv : *match_kmb_ptr)
-          fkernel(match_kv, in_kv, collector);
-    }
+    t.probe(*in_mb, [this](In2 &in_kv, In1 &match_kv) {
+      fkernel(match_kv, in_kv, collector);
+    });
     auto cb = collector.begin();
     if (cb) handle_output(otag, cb);
     collector.clear();
@@ -394,13 +413,11 @@ class base_JFMBK_worker : public base_filter {
 
   void clear_tag_state(origin_state &s) {
     if (s.from_left) {
-      for (auto kmb : s.kmb_from_left)
-        for (auto mb_ptr : kmb.second) DELETE(mb_ptr);
-      assert(s.kmb_from_right.empty());
+      s.from_left_table.clear();
+      assert(s.from_right_table.empty());
     } else {
-      for (auto kmb : s.kmb_from_right)
-        for (auto mb_ptr : kmb.second) DELETE(mb_ptr);
-      assert(s.kmb_from_left.empty());
+      s.from_right_table.clear();
+      assert(s.from_left_table.empty());
     }
   }
 
@@ -456,12 +473,13 @@ class JoinFlatMapByKeyFarm
   };
 
  public:
-  JoinFlatMapByKeyFarm(unsigned nw, kernel_t kernel, bool left_input)
+  JoinFlatMapByKeyFarm(unsigned nw, kernel_t kernel, bool left_input,
+                       unsigned mb_size = 0)
       : base_farm_t(nw) {
-    auto e = new emitter_t(nw, pico::global_params.MICROBATCH_SIZE, *this);
+    auto e = new emitter_t(nw, pico::microbatch_size(mb_size));
     std::vector<ff::ff_node *> w;
     for (unsigned i = 0; i < nw; ++i)
-      w.push_back(new Worker(kernel, left_input));
+      w.push_back(new Worker(kernel, left_input, mb_size));
     auto c = new UnpackingCollector<pico::TokenCollector<Out>>(nw);
 
     this->setEmitterF(e);
@@ -488,7 +506,8 @@ class JFMRBK_seq_red : public base_JFMBK_Farm<TT1, TT2, TTO> {
 
   typedef pico::base_microbatch::tag_t tag_t;
   typedef typename pico::TokenCollector<Out>::cnode cnode_t;
-  typedef pico::Microbatch<TTO> mb_out;
+  typedef pico::kv_microbatch<TTO> kv_mb;
+  typedef typename kv_mb::type mb_out;
 
   typedef base_JFMBK_Farm<TT1, TT2, TTO> base_farm_t;
   typedef typename base_farm_t::Emitter emitter_t;
@@ -496,22 +515,23 @@ class JFMRBK_seq_red : public base_JFMBK_Farm<TT1, TT2, TTO> {
 
   class Worker : public worker_t {
    public:
-    Worker(mapf_t mapf, redf_t redf_, bool left_in)
-        : worker_t(mapf, left_in), redf(redf_) {}
+    Worker(mapf_t mapf, redf_t redf, bool left_in, unsigned mb_size_,
+           size_t combiner_entries)
+        : worker_t(mapf, left_in, mb_size_),
+          combiner(1, redf, mb_size_, combiner_entries) {}
+
+#ifdef TRACE_PICO
+    void ffStats(std::ostream &os) {
+      base_node::ffStats(os);
+      combiner.print_stats(os);
+    }
+#endif
 
    private:
     void handle_output(tag_t tag, cnode_t *it) {
-      /* update reduce state */
-      auto &s(tag_state[tag]);
+      /* combine the output */
       while (it) {
-        /* reduce the micro-batch */
-        for (Out &kv : *it->mb) {
-          const OutK &k(kv.Key());
-          if (s.kvmap.find(k) != s.kvmap.end())
-            s.kvmap[k] = redf(kv.Value(), s.kvmap[k]);
-          else
-            s.kvmap[k] = kv.Value();
-        }
+        combiner.reduce_mb(tag, it->mb, send_out());
 
         /* clean up and skip to the next micro-batch */
         auto it_ = it;
@@ -522,45 +542,33 @@ class JFMRBK_seq_red : public base_JFMBK_Farm<TT1, TT2, TTO> {
     }
 
     void finalize_output_tag(tag_t tag) {
-      /* stream out reduce state */
-      auto &s(tag_state[tag]);
-      auto mb = NEW<mb_out>(tag, pico::global_params.MICROBATCH_SIZE);
-      for (auto it = s.kvmap.begin(); it != s.kvmap.end(); ++it) {
-        new (mb->allocate()) Out(it->first, it->second);
-        mb->commit();
-        if (mb->full()) {
-          this->send_mb(mb);
-          mb = NEW<mb_out>(tag, pico::global_params.MICROBATCH_SIZE);
-        }
-      }
-
-      /* send out the remainder micro-batch or destroy if spurious */
-      if (!mb->empty())
-        this->send_mb(mb);
-      else
-        DELETE(mb);
+      /* stream out the combiner content */
+      combiner.flush(tag, send_out());
 
       /* close the collection */
       this->send_mb(make_sync(tag, PICO_CSTREAM_END));
     }
 
-    redf_t redf;
+    MapSideCombiner<TTO> combiner;
 
-    /* reduce state */
-    struct key_state {
-      std::unordered_map<OutK, OutV> kvmap;
-    };
-    std::unordered_map<pico::base_microbatch::tag_t, key_state> tag_state;
+    inline auto send_out() {
+      return [this](mb_out *mb, unsigned) { this->send_mb(mb); };
+    }
   };
 
  public:
-  JFMRBK_seq_red(unsigned nw, bool left_input, mapf_t mapf, redf_t redf)
+  JFMRBK_seq_red(unsigned nw, bool left_input, mapf_t mapf, redf_t redf,
+                 unsigned jf_mb_size = 0, unsigned red_mb_size = 0,
+                 size_t keys = 0, size_t combiner_entries = 0,
+                 pico::keyed_state_cfg state = {})
       : base_JFMBK_Farm<TT1, TT2, TTO>(nw) {
-    auto e = new emitter_t(nw, pico::global_params.MICROBATCH_SIZE, *this);
+    auto e = new emitter_t(nw, pico::microbatch_size(jf_mb_size));
     std::vector<ff::ff_node *> w;
     for (unsigned i = 0; i < nw; ++i)
-      w.push_back(new Worker(mapf, redf, left_input));
-    auto c = new PReduceCollector<Out, pico::Token<Out>>(nw, redf);
+      w.push_back(
+          new Worker(mapf, redf, left_input, jf_mb_size, combiner_entries));
+    auto c = new PReduceCollector<Out, pico::Token<Out>>(nw, redf, red_mb_size,
+                                                         keys, state);
 
     this->setEmitterF(e);
     this->setCollectorF(c);
@@ -571,10 +579,10 @@ class JFMRBK_seq_red : public base_JFMBK_Farm<TT1, TT2, TTO> {
 };
 
 /*
- * todo
- * this approach has poor performance, should be replaced by shuffling
+ * JoinFlatMapByKey followed by parallel ReduceByKey.
  *
- * JoinFlatMapByKey followed by parallel ReduceByKey
+ * Each join worker combines its output by a bounded combiner and shuffles the
+ * evicted entries (and the content, upon c-stream end) to the reducers.
  */
 template <typename TT1, typename TT2, typename TTO>
 class JFMRBK_par_red : public ff::ff_pipeline {
@@ -586,116 +594,74 @@ class JFMRBK_par_red : public ff::ff_pipeline {
   typedef std::function<void(In1 &, In2 &, pico::FlatMapCollector<Out> &)>
       mapf_t;
   typedef std::function<OutV(OutV &, OutV &)> redf_t;
-  typedef pico::Microbatch<TTO> mb_out;
-  typedef std::unordered_map<OutK, OutV> red_map_t;
-  typedef typename RBK_farm<TTO>::Emitter emitter_t;
+  typedef typename MapSideCombiner<TTO>::mb_t mb_out;
+  typedef typename base_JFMBK_Farm<TT1, TT2, TTO>::Emitter emitter_t;
+  typedef base_JFMBK_worker<TT1, TT2, TTO, base_shuffler> worker_t;
+  typedef std::shared_ptr<pico::hot_key_set<OutK>> hot_keys_t;
 
- private:
-  class FM_farm : public base_JFMBK_Farm<TT1, TT2, TTO> {
-    typedef base_JFMBK_Farm<TT1, TT2, TTO> base_farm_t;
-    typedef typename base_farm_t::Emitter emitter_t;
-    typedef base_JFMBK_worker<TT1, TT2, TTO> worker_t;
-
-    class Worker : public worker_t {
-      typedef pico::base_microbatch::tag_t tag_t;
-      typedef typename pico::TokenCollector<Out>::cnode cnode_t;
-
-     public:
-      Worker(mapf_t mapf, unsigned rbk_par_, redf_t redf_, bool left_in)
-          : worker_t(mapf, left_in), rbk_par(rbk_par_), redf(redf_) {}
-
-     private:
-      void handle_output(tag_t tag, cnode_t *it) {
-        auto &s(tag_state[tag]);
-        while (it) {
-          /* reduce the micro-batch */
-          for (Out &kv : *it->mb) {
-            const OutK &k(kv.Key());
-            if (s.red_map.find(k) != s.red_map.end())
-              s.red_map[k] = redf(kv.Value(), s.red_map[k]);
-            else
-              s.red_map[k] = kv.Value();
-          }
-
-          /* clean up and skip to the next micro-batch */
-          auto it_ = it;
-          it = it->next;
-          DELETE(it_->mb);
-          FREE(it_);
-        }
-      }
+  class Worker : public worker_t {
+    typedef pico::base_microbatch::tag_t tag_t;
+    typedef typename pico::TokenCollector<Out>::cnode cnode_t;
 
-      void finalize_output_tag(tag_t tag) {
-        std::vector<mb_out *> worker_mb;
-        for (unsigned wid = 0; wid < rbk_par; ++wid)
-          worker_mb.push_back(nullptr);
-        for (auto &kv : tag_state[tag].red_map) {
-          auto dst = key_to_worker(kv.first);
-          if (!worker_mb[dst]) worker_mb[dst] = NEW<mb_out>(tag, mb_size);
-          new (worker_mb[dst]->allocate()) Out(kv.first, kv.second);
-          worker_mb[dst]->commit();
-          if (worker_mb[dst]->full()) {
-            this->send_mb(worker_mb[dst]);
-            worker_mb[dst] = nullptr;
-          }
-        }
+   public:
+    Worker(mapf_t mapf, unsigned rbk_par, redf_t redf, bool left_in,
+           unsigned mb_size_, size_t combiner_entries, hot_keys_t hot)
+        : worker_t(mapf, left_in, mb_size_, rbk_par),
+          combiner(rbk_par, redf, mb_size_, combiner_entries, hot) {}
+
+#ifdef TRACE_PICO
+    void ffStats(std::ostream &os) {
+      base_node::ffStats(os);
+      combiner.print_stats(os);
+    }
+#endif
 
-        /* remainder */
-        for (auto mb : worker_mb)
-          if (mb) this->send_mb(mb);
+   private:
+    void handle_output(tag_t tag, cnode_t *it) {
+      /* combine the output */
+      while (it) {
+        combiner.reduce_mb(tag, it->mb, send_out());
 
-        /* close the collection */
-        this->send_mb(make_sync(tag, PICO_CSTREAM_END));
+        /* clean up and skip to the next micro-batch */
+        auto it_ = it;
+        it = it->next;
+        DELETE(it_->mb);
+        FREE(it_);
       }
+    }
 
-      const int mb_size = pico::global_params.MICROBATCH_SIZE;
-      unsigned rbk_par;
-      redf_t redf;
-      struct key_state {
-        red_map_t red_map;
-      };
-      std::unordered_map<pico::base_microbatch::tag_t, key_state> tag_state;
+    void finalize_output_tag(tag_t tag) {
+      /* shuffle the combiner content */
+      combiner.flush(tag, send_out());
 
-      inline size_t key_to_worker(const OutK &k) {
-        return std::hash<OutK>{}(k) % rbk_par;
-      }
-    };
+      /* close the collection */
+      this->send_mb(make_sync(tag, PICO_CSTREAM_END));
+    }
 
-   public:
-    FM_farm(unsigned nw, bool left_input, mapf_t mapf, unsigned rbk_par,
-            redf_t redf)
-        : base_JFMBK_Farm<TT1, TT2, TTO>(nw) {
-      auto e = new emitter_t(nw, pico::global_params.MICROBATCH_SIZE, *this);
-      std::vector<ff::ff_node *> w;
-      for (unsigned i = 0; i < nw; ++i)
-        w.push_back(new Worker(mapf, rbk_par, redf, left_input));
-      auto c = new ForwardingCollector(nw);
-
-      this->setEmitterF(e);
-      this->setCollectorF(c);
-      this->add_workers(w);
-
-      this->cleanup_all();
+    MapSideCombiner<TTO> combiner;
+
+    inline auto send_out() {
+      return [this](mb_out *mb, unsigned dst) { this->send_mb_to(mb, dst); };
     }
   };
 
  public:
   JFMRBK_par_red(unsigned fm_par, bool lin, mapf_t fm_f,  //
-                 unsigned rbk_par, redf_t rbk_f) {
-    /* create the JFMBK farm */
-    auto fm_farm = new FM_farm(fm_par, lin, fm_f, rbk_par, rbk_f);
-
-    /* create the reduce-by-key farm */
-    auto rbk_farm = new RBK_farm<TTO>(fm_par, rbk_par, rbk_f);
-
-    auto emitter = reinterpret_cast<emitter_t *>(rbk_farm->getEmitter());
-
-    /* combine the farms with shuffle */
-    auto combined_farm = ff::combine_farms<emitter_t, emitter_t>(
-        *fm_farm, emitter, *rbk_farm, nullptr, false);
-
-    /* compose the pipeline */
-    this->add_stage(combined_farm);
+                 unsigned rbk_par, redf_t rbk_f,        //
+                 unsigned jf_mb_size = 0, unsigned red_mb_size = 0,
+                 size_t keys = 0, size_t combiner_entries = 0,
+                 pico::keyed_state_cfg state = {}) {
+    /* create the join workers */
+    auto hot = std::make_shared<pico::hot_key_set<OutK>>();
+    std::vector<ff::ff_node *> w;
+    for (unsigned i = 0; i < fm_par; ++i)
+      w.push_back(new Worker(fm_f, rbk_par, rbk_f, lin, jf_mb_size,
+                             combiner_entries, hot));
+
+    /* shuffle to the reduce-by-key workers */
+    auto e = new emitter_t(fm_par, pico::microbatch_size(jf_mb_size));
+    this->add_stage(new RBK_shuffle<TTO>(e, w, rbk_par, rbk_f, hot,
+                                         red_mb_size, keys, state));
     this->cleanup_nodes();
   }
 };
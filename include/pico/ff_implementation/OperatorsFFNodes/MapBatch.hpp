@@ -24,6 +24,7 @@
 #include <ff/farm.hpp>
 
 #include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
 #include "pico/Internals/TimedToken.hpp"
 #include "pico/Internals/utils.hpp"
 
@@ -34,7 +35,7 @@ template <typename In, typename Out, typename Farm, typename TokenTypeIn,
           typename TokenTypeOut>
 class MapBatch : public Farm {
  public:
-  MapBatch(int par, std::function<Out(In &)> &mapf) {
+  MapBatch(int par, std::function<Out(In &)> &mapf, unsigned mb_size = 0) {
     ff::ff_node *e;
     if (this->isOFarm())
       e = new OrdForwardingEmitter(par);
@@ -43,7 +44,7 @@ class MapBatch : public Farm {
     this->setEmitterF(e);
     this->setCollectorF(new ForwardingCollector(par));
     std::vector<ff::ff_node *> w;
-    for (int i = 0; i < par; ++i) w.push_back(new Worker(mapf));
+    for (int i = 0; i < par; ++i) w.push_back(new Worker(mapf, mb_size));
     this->add_workers(w);
     this->cleanup_all();
   }
@@ -51,19 +52,28 @@ class MapBatch : public Farm {
  private:
   class Worker : public base_filter {
    public:
-    Worker(std::function<Out(In &)> kernel_) : mkernel(kernel_) {}
+    Worker(std::function<Out(In &)> kernel_, unsigned mb_size_)
+        : mkernel(kernel_), mb_size(pico::microbatch_size(mb_size_)) {}
 
     void kernel(pico::base_microbatch *in_mb) {
       auto in_microbatch = reinterpret_cast<mb_in *>(in_mb);
       auto tag = in_mb->tag();
-      auto out_mb = NEW<mb_out>(tag, pico::global_params.MICROBATCH_SIZE);
+      auto out_mb = NEW<mb_out>(tag, mb_size);
       // iterate over microbatch
       for (In &in : *in_microbatch) {
+        /* input microbatches may be larger than output ones */
+        if (out_mb->full()) {
+          ff_send_out(reinterpret_cast<void *>(out_mb));
+          out_mb = NEW<mb_out>(tag, mb_size);
+        }
         /* build item and enable copy elision */
         new (out_mb->allocate()) Out(mkernel(in));
         out_mb->commit();
       }
-      ff_send_out(reinterpret_cast<void *>(out_mb));
+      if (!out_mb->empty())
+        ff_send_out(reinterpret_cast<void *>(out_mb));
+      else
+        DELETE(out_mb);
       DELETE(in_microbatch);
     }
 
@@ -71,6 +81,7 @@ class MapBatch : public Farm {
     typedef pico::Microbatch<TokenTypeIn> mb_in;
     typedef pico::Microbatch<TokenTypeOut> mb_out;
     std::function<Out(In &)> mkernel;
+    const unsigned mb_size;
   };
 };
 
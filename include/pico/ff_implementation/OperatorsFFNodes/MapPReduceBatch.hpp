@@ -21,19 +21,31 @@
 #ifndef INTERNALS_FFOPERATORS_MAPPREDUCEBATCH_HPP_
 #define INTERNALS_FFOPERATORS_MAPPREDUCEBATCH_HPP_
 
-#include <unordered_map>
+#include <memory>
+#include <ostream>
+#include <vector>
 
-#include <ff/combine.hpp>
 #include <ff/farm.hpp>
 
+#include "pico/Internals/KVMicrobatch.hpp"
 #include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
 #include "pico/Internals/TimedToken.hpp"
 #include "pico/Internals/utils.hpp"
 #include "pico/WindowPolicy.hpp"
 
+#include "pico/ff_implementation/SupportFFNodes/MapSideCombiner.hpp"
 #include "pico/ff_implementation/SupportFFNodes/RBKOptFarm.hpp"
+#include "pico/ff_implementation/SupportFFNodes/emitters.hpp"
 #include "pico/ff_implementation/ff_config.hpp"
 
+/*
+ * Map followed by non-parallel ReduceByKey.
+ *
+ * Each worker combines its map output by a bounded combiner, whose evicted
+ * entries (and whose content, upon c-stream end) are streamed to the reducing
+ * collector.
+ */
 template <typename TokenTypeIn, typename TokenTypeOut>
 class MRBK_seq_red : public NonOrderingFarm {
   typedef typename TokenTypeIn::datatype In;
@@ -43,15 +55,20 @@ class MRBK_seq_red : public NonOrderingFarm {
   typedef ForwardingEmitter emitter_t;
 
  public:
-  MRBK_seq_red(int par,                         //
-               std::function<Out(In &)> &mapf,  //
-               std::function<OutV(OutV &, OutV &)> reducef) {
+  MRBK_seq_red(int par,                                        //
+               std::function<Out(In &)> &mapf,                 //
+               std::function<OutV(OutV &, OutV &)> reducef,  //
+               unsigned map_mb_size = 0, unsigned red_mb_size = 0,
+               size_t keys = 0, size_t combiner_entries = 0,
+               pico::keyed_state_cfg state = {}) {
     auto e = new emitter_t(par);
     this->setEmitterF(e);
-    auto c = new PReduceCollector<Out, TokenTypeOut>(par, reducef);
+    auto c = new PReduceCollector<Out, TokenTypeOut>(par, reducef, red_mb_size,
+                                                     keys, state);
     this->setCollectorF(c);
     std::vector<ff_node *> w;
-    for (int i = 0; i < par; ++i) w.push_back(new Worker(mapf, reducef));
+    for (int i = 0; i < par; ++i)
+      w.push_back(new Worker(mapf, reducef, map_mb_size, combiner_entries));
     this->add_workers(w);
     this->cleanup_all();
   }
@@ -60,57 +77,51 @@ class MRBK_seq_red : public NonOrderingFarm {
   class Worker : public base_filter {
    public:
     Worker(std::function<Out(In &)> &kernel_,
-           std::function<OutV(OutV &, OutV &)> &reducef_kernel_)
-        : map_kernel(kernel_), reduce_kernel(reducef_kernel_) {}
+           std::function<OutV(OutV &, OutV &)> &reducef_kernel_,
+           unsigned mb_size_, size_t combiner_entries)
+        : map_kernel(kernel_),
+          combiner(1, reducef_kernel_, mb_size_, combiner_entries) {}
 
     void kernel(pico::base_microbatch *in_mb) {
       auto in_microbatch = reinterpret_cast<in_mb_t *>(in_mb);
-      auto &s(tag_state[in_mb->tag()]);
+      auto tag = in_mb->tag();
       for (In &x : *in_microbatch) {
         Out kv = map_kernel(x);
-        const OutK &k(kv.Key());
-        if (s.kvmap.find(k) != s.kvmap.end())
-          s.kvmap[k] = reduce_kernel(kv.Value(), s.kvmap[k]);
-        else
-          s.kvmap[k] = kv.Value();
+        combiner.reduce(tag, kv.Key(), kv.Value(), send_out());
       }
       DELETE(in_microbatch);
     }
 
     void cstream_end_callback(pico::base_microbatch::tag_t tag) {
-      auto &s(tag_state[tag]);
-      out_mb_t *out_mb;
-      out_mb = NEW<out_mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
-      for (auto it = s.kvmap.begin(); it != s.kvmap.end(); ++it) {
-        new (out_mb->allocate()) Out(it->first, it->second);
-        out_mb->commit();
-        if (out_mb->full()) {
-          ff_send_out(reinterpret_cast<void *>(out_mb));
-          out_mb = NEW<out_mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
-        }
-      }
+      combiner.flush(tag, send_out());
+    }
 
-      if (!out_mb->empty())
-        ff_send_out(reinterpret_cast<void *>(out_mb));
-      else
-        DELETE(out_mb);  // spurious microbatch
+#ifdef TRACE_PICO
+    void ffStats(std::ostream &os) {
+      base_node::ffStats(os);
+      combiner.print_stats(os);
     }
+#endif
 
    private:
     typedef pico::Microbatch<TokenTypeIn> in_mb_t;
-    typedef pico::Microbatch<TokenTypeOut> out_mb_t;
+    typedef typename MapSideCombiner<TokenTypeOut>::mb_t out_mb_t;
     std::function<Out(In &)> map_kernel;
-    std::function<OutV(OutV &, OutV &)> reduce_kernel;
-    struct key_state {
-      std::unordered_map<OutK, OutV> kvmap;
-    };
-    std::unordered_map<pico::base_microbatch::tag_t, key_state> tag_state;
+    MapSideCombiner<TokenTypeOut> combiner;
+
+    inline auto send_out() {
+      return [this](out_mb_t *mb, unsigned) {
+        ff_send_out(reinterpret_cast<void *>(mb));
+      };
+    }
   };
 };
 
 /*
- * todo
- * this approach has poor performance, should be replaced by shuffling
+ * Map followed by parallel ReduceByKey.
+ *
+ * Each map worker combines its output by a bounded combiner and shuffles the
+ * evicted entries (and the content, upon c-stream end) to the reducers.
  */
 template <typename TokenTypeIn, typename TokenTypeOut>
 class MRBK_par_red : public ff::ff_pipeline {
@@ -118,119 +129,81 @@ class MRBK_par_red : public ff::ff_pipeline {
   typedef typename TokenTypeOut::datatype Out;
   typedef typename Out::keytype OutK;
   typedef typename Out::valuetype OutV;
-  typedef typename RBK_farm<TokenTypeOut>::Emitter emitter_t;
 
  public:
   MRBK_par_red(int map_par, std::function<Out(In &)> &map_f, int red_par,  //
-               std::function<OutV(OutV &, OutV &)> red_f) {
-    /* create the flatmap farm */
-    auto fmap_farm = new M_farm(map_par, map_f, red_par, red_f);
-
-    /* create the reduce-by-key farm farm */
-    auto rbk_farm = new RBK_farm<TokenTypeOut>(map_par, red_par, red_f);
-
-    auto emitter = reinterpret_cast<emitter_t *>(rbk_farm->getEmitter());
-
-    /* combine the farms with shuffle */
-    auto combined_farm = ff::combine_farms<emitter_t, emitter_t>(
-        *fmap_farm, emitter, *rbk_farm, nullptr, false);
-
-    /* compose the pipeline */
-    this->add_stage(combined_farm);
+               std::function<OutV(OutV &, OutV &)> red_f,
+               unsigned map_mb_size = 0, unsigned red_mb_size = 0,
+               size_t keys = 0, size_t combiner_entries = 0,
+               pico::keyed_state_cfg state = {}) {
+    /* create the map workers */
+    auto hot = std::make_shared<pico::hot_key_set<OutK>>();
+    std::vector<ff::ff_node *> w;
+    for (int i = 0; i < map_par; ++i)
+      w.push_back(new Worker(map_f, red_par, red_f, map_mb_size,
+                             combiner_entries, hot));
+
+    /* shuffle to the reduce-by-key workers */
+    auto e = new ForwardingEmitter(map_par);
+    this->add_stage(new RBK_shuffle<TokenTypeOut>(e, w, red_par, red_f, hot,
+                                                  red_mb_size, keys, state));
     this->cleanup_nodes();
   }
 
  private:
   /*
-   * the FlatMap farm computes the flat-map for each micro-batch,
-   * then reduces the result and streams it out
+   * the Map worker computes the map for each micro-batch,
+   * then combines the result and streams out the partially reduced pairs
    */
-  class M_farm : public NonOrderingFarm {
+  class Worker : public base_shuffler {
    public:
-    M_farm(int map_par, std::function<Out(In &)> &mapf, int rbk_par,  //
-           std::function<OutV(OutV &, OutV &)> reducef) {
-      using emitter_t = ForwardingEmitter;
-      auto e = new emitter_t(map_par);
-      this->setEmitterF(e);
-      auto c = new ForwardingCollector(map_par);
-      this->setCollectorF(c);
-      std::vector<ff_node *> w;
-      for (int i = 0; i < map_par; ++i)
-        w.push_back(new Worker(mapf, rbk_par, reducef));
-      this->add_workers(w);
-      this->cleanup_all();
-    }
+    Worker(std::function<Out(In &)> &kernel_,  //
+           int rbk_par, std::function<OutV(OutV &, OutV &)> &reducef_kernel_,
+           unsigned mb_size_, size_t combiner_entries,
+           std::shared_ptr<pico::hot_key_set<OutK>> hot)
+        : base_shuffler(rbk_par),
+          map_kernel(kernel_),
+          combiner(rbk_par, reducef_kernel_, mb_size_, combiner_entries,
+                   hot) {}
 
-   private:
-    class Worker : public base_filter {
-     public:
-      Worker(std::function<Out(In &)> &kernel_,  //
-             int rbk_par_, std::function<OutV(OutV &, OutV &)> &reducef_kernel_)
-          : map_kernel(kernel_),  //
-            rbk_par(rbk_par_),
-            rbk_f(reducef_kernel_) {}
-
-      void kernel(pico::base_microbatch *in_mb) {
-        /*
-         * got a microbatch to process and delete
-         */
-        auto in_microbatch = reinterpret_cast<mb_in *>(in_mb);
-        auto tag = in_mb->tag();
-
-        // iterate over microbatch
-        auto &s(tag_state[tag]);
-        for (In &in : *in_microbatch) {
-          auto res = map_kernel(in);
-          const OutK &k(res.Key());
-          if (s.red_map.find(k) != s.red_map.end())
-            s.red_map[k] = rbk_f(res.Value(), s.red_map[k]);
-          else
-            s.red_map[k] = res.Value();
-        }
-
-        // clean up
-        DELETE(in_microbatch);
+    void kernel(pico::base_microbatch *in_mb) {
+      /*
+       * got a microbatch to process and delete
+       */
+      auto in_microbatch = reinterpret_cast<mb_in *>(in_mb);
+      auto tag = in_mb->tag();
+
+      // iterate over microbatch
+      for (In &in : *in_microbatch) {
+        auto res = map_kernel(in);
+        combiner.reduce(tag, res.Key(), res.Value(), send_out());
       }
 
-      void cstream_end_callback(pico::base_microbatch::tag_t tag) {
-        std::vector<mb_out *> worker_mb;
-        for (unsigned wid = 0; wid < rbk_par; ++wid)
-          worker_mb.push_back(nullptr);
-        for (auto &kv : tag_state[tag].red_map) {
-          auto dst = key_to_worker(kv.first);
-          if (!worker_mb[dst]) worker_mb[dst] = NEW<mb_out>(tag, mb_size);
-          new (worker_mb[dst]->allocate()) Out(kv.first, kv.second);
-          worker_mb[dst]->commit();
-          if (worker_mb[dst]->full()) {
-            send_mb(worker_mb[dst]);
-            worker_mb[dst] = nullptr;
-          }
-        }
-
-        /* remainder */
-        for (auto mb : worker_mb)
-          if (mb) send_mb(mb);
-      }
+      // clean up
+      DELETE(in_microbatch);
+    }
 
-     private:
-      typedef pico::Microbatch<TokenTypeOut> mb_out;
-      typedef pico::Microbatch<TokenTypeIn> mb_in;
-      typedef std::unordered_map<OutK, OutV> red_map_t;
-      int mb_size = pico::global_params.MICROBATCH_SIZE;
+    void cstream_end_callback(pico::base_microbatch::tag_t tag) {
+      combiner.flush(tag, send_out());
+    }
 
-      std::function<Out(In &)> map_kernel;
-      unsigned rbk_par;
-      std::function<OutV(OutV &, OutV &)> rbk_f;
+#ifdef TRACE_PICO
+    void ffStats(std::ostream &os) {
+      base_node::ffStats(os);
+      combiner.print_stats(os);
+    }
+#endif
 
-      struct tag_kv {
-        red_map_t red_map;
-      };
-      std::unordered_map<pico::base_microbatch::tag_t, tag_kv> tag_state;
+   private:
+    typedef typename MapSideCombiner<TokenTypeOut>::mb_t mb_out;
+    typedef pico::Microbatch<TokenTypeIn> mb_in;
 
-      inline size_t key_to_worker(const OutK &k) {
-        return std::hash<OutK>{}(k) % rbk_par;
-      }
-    };
+    std::function<Out(In &)> map_kernel;
+    MapSideCombiner<TokenTypeOut> combiner;
+
+    inline auto send_out() {
+      return [this](mb_out *mb, unsigned dst) { send_mb_to(mb, dst); };
+    }
   };
 };
 
@@ -245,10 +218,15 @@ ff::ff_node *MapPReduceBatch(
     int map_par,                                    //
     std::function<tkn_dt<TO>(tkn_dt<TI> &)> &mapf,  //
     int red_par,                                    //
-    std::function<tkn_vt<TO>(tkn_vt<TO> &, tkn_vt<TO> &)> redf) {
+    std::function<tkn_vt<TO>(tkn_vt<TO> &, tkn_vt<TO> &)> redf,  //
+    unsigned map_mb_size = 0, unsigned red_mb_size = 0, size_t keys = 0,
+    size_t combiner_entries = 0,
+    pico::keyed_state_cfg state = {}) {
   if (red_par > 1)
-    return new MRBK_par_red<TI, TO>(map_par, mapf, red_par, redf);
-  return new MRBK_seq_red<TI, TO>(map_par, mapf, redf);
+    return new MRBK_par_red<TI, TO>(map_par, mapf, red_par, redf, map_mb_size,
+                                    red_mb_size, keys, combiner_entries, state);
+  return new MRBK_seq_red<TI, TO>(map_par, mapf, redf, map_mb_size,
+                                  red_mb_size, keys, combiner_entries, state);
 }
 
 #endif /* INTERNALS_FFOPERATORS_MAPPREDUCEBATCH_HPP_ */
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_PREDUCEBATCH_HPP_
+#define INTERNALS_FFOPERATORS_PREDUCEBATCH_HPP_
+
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include <ff/pipeline.hpp>
+
+#include "pico/Internals/KVMicrobatch.hpp"
+#include "pico/Internals/KeyedReducer.hpp"
+#include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
+#include "pico/Internals/utils.hpp"
+
+#include "pico/ff_implementation/SupportFFNodes/MapSideCombiner.hpp"
+#include "pico/ff_implementation/SupportFFNodes/RBKOptFarm.hpp"
+#include "pico/ff_implementation/SupportFFNodes/emitters.hpp"
+#include "pico/ff_implementation/ff_config.hpp"
+
+/*
+ * Standalone parallel ReduceByKey (i.e., not fused with a preceding operator).
+ *
+ * Input micro-batches are spread over partitioning workers, that pre-reduce
+ * them by map-side combiners and shuffle the partially reduced pairs to the
+ * reducers (see RBK_shuffle). Each reducer aggregates its share of the keys
+ * and, upon c-stream end, streams it out in parallel with the others.
+ */
+template <typename TokenType>
+class PReduceBatch_par : public ff::ff_pipeline {
+  typedef typename TokenType::datatype KV;
+  typedef typename KV::keytype K;
+  typedef typename KV::valuetype V;
+
+ public:
+  PReduceBatch_par(int par, std::function<V(V &, V &)> reducef,
+                   unsigned mb_size = 0, size_t keys = 0,
+                   size_t combiner_entries = 0,
+                   pico::keyed_state_cfg state = {}) {
+    /* create the partitioning workers */
+    auto hot = std::make_shared<pico::hot_key_set<K>>();
+    std::vector<ff::ff_node *> w;
+    for (int i = 0; i < par; ++i)
+      w.push_back(
+          new Partitioner(par, reducef, mb_size, combiner_entries, hot));
+
+    /* shuffle to the reduce-by-key workers */
+    auto e = new ForwardingEmitter(par);
+    this->add_stage(new RBK_shuffle<TokenType>(e, w, par, reducef, hot,
+                                               mb_size, keys, state));
+    this->cleanup_nodes();
+  }
+
+ private:
+  class Partitioner : public base_shuffler {
+   public:
+    Partitioner(int rbk_par, std::function<V(V &, V &)> &reducef,
+                unsigned mb_size, size_t combiner_entries,
+                std::shared_ptr<pico::hot_key_set<K>> hot)
+        : base_shuffler(rbk_par),
+          combiner(rbk_par, reducef, mb_size, combiner_entries, hot) {}
+
+    void kernel(pico::base_microbatch *in_mb) {
+      auto mb = reinterpret_cast<mb_in *>(in_mb);
+      combiner.reduce_mb(in_mb->tag(), mb, send_out());
+      DELETE(mb);
+    }
+
+    void cstream_end_callback(pico::base_microbatch::tag_t tag) {
+      combiner.flush(tag, send_out());
+    }
+
+#ifdef TRACE_PICO
+    void ffStats(std::ostream &os) {
+      base_node::ffStats(os);
+      combiner.print_stats(os);
+    }
+#endif
+
+   private:
+    typedef typename MapSideCombiner<TokenType>::fm_mb_t mb_in;
+    typedef typename MapSideCombiner<TokenType>::mb_t mb_out;
+
+    MapSideCombiner<TokenType> combiner;
+
+    inline auto send_out() {
+      return [this](mb_out *mb, unsigned dst) { send_mb_to(mb, dst); };
+    }
+  };
+};
+
+/*
+ * Standalone non-parallel ReduceByKey.
+ */
+template <typename TokenType>
+class PReduceBatch_seq : public base_filter {
+  typedef typename TokenType::datatype KV;
+  typedef typename KV::keytype K;
+  typedef typename KV::valuetype V;
+  typedef pico::Microbatch<TokenType> mb_t;
+  typedef pico::kv_microbatch<TokenType, false> kv_mb;
+
+ public:
+  PReduceBatch_seq(std::function<V(V &, V &)> reducef_, unsigned mb_size_ = 0,
+                   size_t keys_ = 0, pico::keyed_state_cfg state_ = {})
+      : reducef(reducef_),
+        mb_size(pico::microbatch_size(mb_size_)),
+        keys(keys_),
+        state(state_) {}
+
+  void kernel(pico::base_microbatch *in_mb) {
+    auto mb = reinterpret_cast<mb_t *>(in_mb);
+    auto &s(tag_state.try_emplace(in_mb->tag(), keys, state).first->second);
+    kv_mb::reduce_into(s.kvmap, mb, reducef);
+    DELETE(mb);
+  }
+
+  void cstream_end_callback(pico::base_microbatch::tag_t tag) {
+    auto st = tag_state.find(tag);
+    if (st == tag_state.end()) return;
+    auto mb = NEW<mb_t>(tag, mb_size);
+    st->second.kvmap.drain(reducef, [&](const K &k, const V &v) {
+      new (mb->allocate()) KV(k, v);
+      mb->commit();
+      if (mb->full()) {
+        send_mb(mb);
+        mb = NEW<mb_t>(tag, mb_size);
+      }
+    });
+
+    /* send out the remainder micro-batch or destroy if spurious */
+    if (!mb->empty())
+      send_mb(mb);
+    else
+      DELETE(mb);
+    spilled.add(st->second.kvmap.spills());
+    tag_state.erase(st);
+  }
+
+#ifdef TRACE_PICO
+  void ffStats(std::ostream &os) {
+    base_node::ffStats(os);
+    spilled.print(os);
+  }
+#endif
+
+ private:
+  std::function<V(V &, V &)> reducef;
+  const unsigned mb_size;
+  const size_t keys;  // expected number of keys
+  const pico::keyed_state_cfg state;
+  struct key_state {
+    key_state(size_t keys_, const pico::keyed_state_cfg &state_)
+        : kvmap(keys_, state_) {}
+    pico::keyed_reducer<K, V> kvmap;
+  };
+  std::unordered_map<pico::base_microbatch::tag_t, key_state> tag_state;
+  pico::spill_stats spilled;
+};
+
+template <typename TokenType>
+ff::ff_node *PReduceBatch(
+    int par, std::function<typename TokenType::datatype::valuetype(
+                 typename TokenType::datatype::valuetype &,
+                 typename TokenType::datatype::valuetype &)>
+                 reducef,
+    unsigned mb_size = 0, size_t keys = 0, size_t combiner_entries = 0,
+    pico::keyed_state_cfg state = {}) {
+  if (par > 1)
+    return new PReduceBatch_par<TokenType>(par, reducef, mb_size, keys,
+                                           combiner_entries, state);
+  return new PReduceBatch_seq<TokenType>(reducef, mb_size, keys, state);
+}
+
+#endif /* INTERNALS_FFOPERATORS_PREDUCEBATCH_HPP_ */
@@ -21,10 +21,14 @@
 #ifndef INTERNALS_FFOPERATORS_PREDUCEWIN_HPP_
 #define INTERNALS_FFOPERATORS_PREDUCEWIN_HPP_
 
+#include <algorithm>
 #include <unordered_map>
 
 #include <ff/farm.hpp>
 
+#include "pico/Internals/FlatHashMap.hpp"
+#include "pico/Internals/KVMicrobatch.hpp"
+#include "pico/Internals/KeyedReducer.hpp"
 #include "pico/Internals/utils.hpp"
 #include "pico/KeyValue.hpp"
 #include "pico/WindowPolicy.hpp"
@@ -39,6 +43,15 @@
  * A non-ordering farm is sufficient for keeping intra-key ordering.
  * Only batching windowing is supported by now, windowing is performed by
  * workers.
+ *
+ * Each worker keeps the open window of each key, i.e., a partial value and a
+ * count. Closed windows leave their keys in the table, to be reused by the
+ * next window, so that the table grows with the number of distinct keys.
+ * Given a memory budget (see keyed_state_cfg), a table outgrowing it is
+ * rebuilt with the keys of the open windows only. Open windows are never
+ * spilled, since each incoming pair updates (and may close) the window of
+ * its key, so they are bounded by the number of keys with a pending window.
+ * The aggregation strategy does not apply.
  */
 template <typename In, typename TokenType>
 class PReduceWin : public NonOrderingFarm {
@@ -47,14 +60,17 @@ class PReduceWin : public NonOrderingFarm {
 
  public:
   PReduceWin(int parallelism, std::function<V(V &, V &)> &preducef,
-             pico::WindowPolicy *win) {
-    auto e = new ByKeyEmitter<TokenType>(parallelism);
+             pico::WindowPolicy *win, unsigned mb_size = 0, size_t keys = 0,
+             pico::keyed_state_cfg state = {}) {
+    auto e = new ByKeyEmitter<TokenType>(parallelism, mb_size);
     this->setEmitterF(e);
     this->setCollectorF(new ForwardingCollector(
         parallelism));  // collects and emits single items
     std::vector<ff_node *> w;
+    size_t worker_keys = (keys + parallelism - 1) / parallelism;
     for (int i = 0; i < parallelism; ++i) {
-      w.push_back(new PReduceWinWorker(preducef, win->win_size()));
+      w.push_back(new PReduceWinWorker(preducef, win->win_size(), worker_keys,
+                                       state.memory_budget));
     }
     this->add_workers(w);
     this->cleanup_all();
@@ -63,59 +79,114 @@ class PReduceWin : public NonOrderingFarm {
  private:
   class PReduceWinWorker : public base_filter {
    public:
-    PReduceWinWorker(std::function<V(V &, V &)> &reducef_, size_t win_size_)
-        : rkernel(reducef_), win_size(win_size_) {}
+    PReduceWinWorker(std::function<V(V &, V &)> &reducef_, size_t win_size_,
+                     size_t keys_, size_t budget_)
+        : rkernel(reducef_),
+          win_size(win_size_),
+          keys(keys_),
+          budget(budget_) {}
 
     void kernel(pico::base_microbatch *in_mb_) {
-      auto in_mb = reinterpret_cast<mb_t *>(in_mb_);
+      auto in_mb = reinterpret_cast<in_mb_t *>(in_mb_);
       auto tag = in_mb_->tag();
-      auto &s(tag_state[tag]);
-      for (In &kv : *in_mb) {
-        auto k(kv.Key());
-        if (s.kvmap.find(k) != s.kvmap.end() && s.kvcountmap[k]) {
-          ++s.kvcountmap[k];
-          s.kvmap[k] = rkernel(s.kvmap[k], kv.Value());
-        } else {
-          s.kvcountmap[k] = 1;
-          s.kvmap[k] = kv.Value();
-        }
-        if (s.kvcountmap[k] == win_size) {
-          mb_t *out_mb;
-          out_mb = NEW<mb_t>(tag, 1);
-          new (out_mb->allocate()) In(k, s.kvmap[k]);
-          out_mb->commit();
-          ff_send_out(reinterpret_cast<void *>(out_mb));
-          s.kvcountmap[k] = 0;
-        }
-      }
+      auto &s(tag_state.try_emplace(tag, keys, budget).first->second);
+      auto key_at = [&](unsigned i) -> const K & {
+        return kv_mb::key(in_mb, i);
+      };
+      auto value_at = [&](unsigned i) {
+        return win_state{kv_mb::value(in_mb, i), 1};
+      };
+      s.kvmap.insert_batch(
+          in_mb->size(), key_at, value_at,
+          [&](unsigned i, std::pair<typename win_map_t::value_type *, bool> r) {
+            auto &w(r.first->second);
+            if (!r.second) {
+              V &v(kv_mb::value(in_mb, i));
+              if (w.count++)
+                w.value = rkernel(w.value, v);
+              else
+                w.value = v;
+            }
+            if (w.count == win_size) {
+              send_window(tag, r.first->first, w.value);
+              w.count = 0;
+            }
+          });
+      if (budget && table_bytes(s.kvmap) > s.compact_at) compact(s);
       DELETE(in_mb);
     }
 
     void cstream_end_callback(pico::base_microbatch::tag_t tag) {
-      auto &s(tag_state[tag]);
+      auto st = tag_state.find(tag);
+      if (st == tag_state.end()) return;
       /* stream out incomplete windows */
-      for (auto kc : s.kvcountmap) {
-        auto k(kc.first);
-        if (kc.second) {
-          mb_t *out_mb;
-          out_mb = NEW<mb_t>(tag, 1);
-          new (out_mb->allocate()) In(k, s.kvmap[k]);
-          out_mb->commit();
-          ff_send_out(reinterpret_cast<void *>(out_mb));
-          s.kvcountmap[k] = 0;
-        }
-      }
+      for (auto &kw : st->second.kvmap)
+        if (kw.second.count) send_window(tag, kw.first, kw.second.value);
+      tag_state.erase(st);
     }
 
+#ifdef TRACE_PICO
+    void ffStats(std::ostream &os) {
+      base_node::ffStats(os);
+      os << "  PICO-window compactions : " << compactions << "\n";
+    }
+#endif
+
    private:
     typedef pico::Microbatch<TokenType> mb_t;
+    typedef pico::kv_microbatch<TokenType> kv_mb;
+    typedef typename kv_mb::type in_mb_t;
     std::function<V(V &, V &)> rkernel;
+    struct win_state {
+      V value;       // partial per-window/key reduced value
+      size_t count;  // per-window/key counter
+    };
+    typedef pico::flat_hash_map<K, win_state> win_map_t;
     struct key_state {
-      std::unordered_map<K, V> kvmap;  // partial per-window/key reduced value
-      std::unordered_map<K, size_t> kvcountmap;  // per-window/key counter
+      key_state(size_t keys_, size_t budget_)
+          : kvmap(keys_), compact_at(budget_) {}
+      win_map_t kvmap;
+      size_t compact_at;  // table size (in bytes) triggering compaction
     };
     std::unordered_map<pico::base_microbatch::tag_t, key_state> tag_state;
     size_t win_size;
+    const size_t keys;    // expected number of keys
+    const size_t budget;  // in bytes, zero for unbounded
+#ifdef TRACE_PICO
+    unsigned long long compactions = 0;
+#endif
+
+    /* approximate size of a table (as for keyed_reducer) */
+    static size_t table_bytes(const win_map_t &m) {
+      return m.capacity() * (sizeof(uint64_t) + sizeof(K) + sizeof(win_state));
+    }
+
+    /*
+     * Rebuilds the table with the open windows only.
+     * The next compaction is due when the table outgrows twice its compacted
+     * size, so that compacting takes amortized constant time per pair even if
+     * the open windows alone exceed the budget.
+     */
+    void compact(key_state &s) {
+      size_t open = 0;
+      for (auto &kw : s.kvmap) open += kw.second.count != 0;
+      win_map_t kvmap(open);
+      for (auto &kw : s.kvmap)
+        if (kw.second.count) kvmap.insert(kw.first, kw.second);
+      s.kvmap = std::move(kvmap);
+      s.compact_at = std::max(budget, 2 * table_bytes(s.kvmap));
+#ifdef TRACE_PICO
+      ++compactions;
+#endif
+    }
+
+    void send_window(pico::base_microbatch::tag_t tag, const K &k, V &v) {
+      mb_t *out_mb;
+      out_mb = NEW<mb_t>(tag, 1);
+      new (out_mb->allocate()) In(k, v);
+      out_mb->commit();
+      ff_send_out(reinterpret_cast<void *>(out_mb));
+    }
   };
 };
 
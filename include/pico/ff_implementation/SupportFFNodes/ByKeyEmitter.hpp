@@ -22,38 +22,50 @@
 #define INTERNALS_FFOPERATORS_WINDOWFFNODES_BYKEYEMITTER_HPP_
 
 #include <unordered_map>
+#include <vector>
 
 #include <ff/farm.hpp>
 
+#include "../../Internals/KVMicrobatch.hpp"
 #include "../../Internals/Microbatch.hpp"
+#include "../../Internals/MicrobatchSizer.hpp"
 #include "base_nodes.hpp"
 #include "farms.hpp"
 
 template <typename TokenType>
 class ByKeyEmitter : public base_emitter {
  public:
-  ByKeyEmitter(unsigned nworkers_)
-      : base_emitter(nworkers_), nworkers(nworkers_) {}
+  ByKeyEmitter(unsigned nworkers_, unsigned mb_size = 0)
+      : base_emitter(nworkers_),
+        nworkers(nworkers_),
+        sizer(mb_size, nworkers_) {}
 
   void cstream_begin_callback(pico::base_microbatch::tag_t tag) {
     /* prepare a microbatch for each worker */
     auto &s(tag_state[tag]);
     for (unsigned dst = 0; dst < nworkers; ++dst)
-      s.worker_mb[dst] = NEW<mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
+      s.worker_mb[dst] = NEW<out_mb_t>(tag, sizer.size());
   }
 
   void kernel(pico::base_microbatch *in_mb) {
     auto in_microbatch = reinterpret_cast<mb_t *>(in_mb);
     auto tag = in_mb->tag();
     auto &s(tag_state[tag]);
-    for (auto tt : *in_microbatch) {
-      auto dst = key_to_worker(tt.Key());
+
+    /* hash all the keys in one pass, then scatter */
+    dst_buf.clear();
+    for (DataType &tt : *in_microbatch)
+      dst_buf.push_back(key_to_worker(tt.Key()));
+
+    auto dst_it = dst_buf.begin();
+    for (DataType &tt : *in_microbatch) {
+      auto dst = *(dst_it++);
       // add token to dst's microbatch
-      new (s.worker_mb[dst]->allocate()) DataType(tt);
-      s.worker_mb[dst]->commit();
+      kv_mb::push(s.worker_mb[dst], tt.Key(), tt.Value());
       if (s.worker_mb[dst]->full()) {
-        send_mb_to(s.worker_mb[dst], dst);
-        s.worker_mb[dst] = NEW<mb_t>(tag, pico::global_params.MICROBATCH_SIZE);
+        auto mb = s.worker_mb[dst];
+        sizer.send(mb->size(), [&]() { send_mb_to(mb, dst); });
+        s.worker_mb[dst] = NEW<out_mb_t>(tag, sizer.size());
       }
     }
     DELETE(in_microbatch);
@@ -73,10 +85,14 @@ class ByKeyEmitter : public base_emitter {
   typedef typename TokenType::datatype DataType;
   typedef typename DataType::keytype keytype;
   typedef pico::Microbatch<TokenType> mb_t;
+  typedef pico::kv_microbatch<TokenType> kv_mb;
+  typedef typename kv_mb::type out_mb_t;
   unsigned nworkers;
+  pico::MicrobatchSizer sizer;
+  std::vector<unsigned> dst_buf;
 
   struct w_state {
-    std::unordered_map<size_t, mb_t *> worker_mb;
+    std::unordered_map<size_t, out_mb_t *> worker_mb;
   };
   std::unordered_map<pico::base_microbatch::tag_t, w_state> tag_state;
 
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_SUPPORTFFNODES_MAPSIDECOMBINER_HPP_
+#define INTERNALS_FFOPERATORS_SUPPORTFFNODES_MAPSIDECOMBINER_HPP_
+
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "pico/Internals/BoundedCombiner.hpp"
+#include "pico/Internals/KVMicrobatch.hpp"
+#include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
+#include "pico/Internals/SkewPartitioner.hpp"
+#include "pico/Internals/Token.hpp"
+#include "pico/ff_implementation/ff_config.hpp"
+
+/*
+ * The map-side combining state of a worker feeding a number of reducers.
+ *
+ * For each tag, key-value pairs are pre-reduced by a bounded combiner.
+ * Evicted pairs are buffered into one micro-batch per reducer (i.e., the one
+ * in charge of the key), that is sent out as soon as it is full, so that
+ * partial results flow to the reducers while the collection is processed.
+ * Upon c-stream end, the combiner is flushed and remainders are sent out.
+ *
+ * Pairs are routed to reducers by a skew_partitioner, publishing hot keys
+ * into the given hot_key_set (if any) so that the reducers' partial results
+ * of split keys can be merged.
+ *
+ * Micro-batches are sent out by calling send_f(mb, reducer).
+ */
+template <typename TokenType>
+class MapSideCombiner {
+  typedef typename TokenType::datatype KV;
+  typedef typename KV::keytype K;
+  typedef typename KV::valuetype V;
+  typedef pico::kv_microbatch<TokenType> kv_mb;
+  typedef pico::kv_microbatch<pico::Token<KV>, false> fm_kv_mb;
+  typedef pico::base_microbatch::tag_t tag_t;
+
+ public:
+  typedef typename kv_mb::type mb_t;
+  typedef typename fm_kv_mb::type fm_mb_t;  // as from flat-map collectors
+
+  MapSideCombiner(unsigned nreducers_, std::function<V(V &, V &)> reduce_f_,
+                  unsigned mb_size_, size_t entries_,
+                  std::shared_ptr<pico::hot_key_set<K>> hot = nullptr)
+      : nreducers(nreducers_),
+        reduce_f(reduce_f_),
+        mb_size(pico::microbatch_size(mb_size_)),
+        entries(entries_),
+        key_to_reducer(nreducers_, hot) {}
+
+  /*
+   * combines a key-value pair
+   */
+  template <typename SendF>
+  inline void reduce(tag_t tag, const K &k, V &v, SendF &&send_f) {
+    auto &s(state(tag));
+    s.combiner.reduce(k, v, reduce_f, [&](const K &k_, V &v_) {
+      emit(s, tag, k_, v_, send_f);
+    });
+  }
+
+  /*
+   * combines all the pairs of a micro-batch
+   */
+  template <typename SendF>
+  void reduce_mb(tag_t tag, fm_mb_t *mb, SendF &&send_f) {
+    auto &s(state(tag));
+    s.combiner.reduce_batch(
+        mb->size(),
+        [&](unsigned i) -> const K & { return fm_kv_mb::key(mb, i); },
+        [&](unsigned i) -> V & { return fm_kv_mb::value(mb, i); }, reduce_f,
+        [&](const K &k, V &v) { emit(s, tag, k, v, send_f); });
+  }
+
+  /*
+   * flushes the state of a tag and sends out the remainder micro-batches
+   */
+  template <typename SendF>
+  void flush(tag_t tag, SendF &&send_f) {
+    auto st = tag_state.find(tag);
+    if (st == tag_state.end()) return;
+    auto &s(st->second);
+    s.combiner.flush([&](const K &k, V &v) { emit(s, tag, k, v, send_f); });
+    for (unsigned dst = 0; dst < nreducers; ++dst)
+      if (s.out_mb[dst]) send_f(s.out_mb[dst], dst);
+    lookups += s.combiner.lookups();
+    hits += s.combiner.hits();
+    evictions += s.combiner.evictions();
+    tag_state.erase(st);
+  }
+
+  /*
+   * reports the statistics of all the flushed combiners, and the number of
+   * pairs sent to each reducer
+   */
+  void print_stats(std::ostream &os) const {
+    os << "  PICO-combiner lookups   : " << lookups << "\n";
+    os << "  PICO-combiner hits      : " << hits << "\n";
+    if (lookups)
+      os << "  PICO-combiner hit rate  : " << (double)hits / lookups << "\n";
+    os << "  PICO-combiner evictions : " << evictions << "\n";
+    if (nreducers < 2) return;
+    os << "  PICO-shuffle hot keys   : " << key_to_reducer.hot_keys() << "\n";
+    auto &load(key_to_reducer.load());
+    for (unsigned dst = 0; dst < nreducers; ++dst)
+      os << "  PICO-shuffle pairs to reducer " << dst << " : " << load[dst]
+         << "\n";
+  }
+
+  /* the number of pairs sent to each reducer */
+  const std::vector<unsigned long long> &load() const {
+    return key_to_reducer.load();
+  }
+
+ private:
+  const unsigned nreducers;
+  std::function<V(V &, V &)> reduce_f;
+  const unsigned mb_size;
+  const size_t entries;  // entries per combiner
+  struct key_state {
+    key_state(size_t entries_, unsigned nreducers_)
+        : combiner(entries_), out_mb(nreducers_, nullptr) {}
+    pico::bounded_combiner<K, V> combiner;
+    std::vector<mb_t *> out_mb;  // partially reduced pairs, by reducer
+  };
+  std::unordered_map<tag_t, key_state> tag_state;
+  pico::skew_partitioner<K> key_to_reducer;
+  unsigned long long lookups = 0, hits = 0, evictions = 0;
+
+  inline key_state &state(tag_t tag) {
+    return tag_state.try_emplace(tag, entries, nreducers).first->second;
+  }
+
+  template <typename SendF>
+  void emit(key_state &s, tag_t tag, const K &k, V &v, SendF &send_f) {
+    auto dst = key_to_reducer(k);
+    auto &mb(s.out_mb[dst]);
+    if (!mb) mb = NEW<mb_t>(tag, mb_size);
+    kv_mb::push(mb, k, v);
+    if (mb->full()) {
+      send_f(mb, dst);
+      mb = nullptr;
+    }
+  }
+};
+
+#endif /* INTERNALS_FFOPERATORS_SUPPORTFFNODES_MAPSIDECOMBINER_HPP_ */
@@ -21,9 +21,13 @@
 #ifndef PICO_FF_IMPLEMENTATION_SUPPORTFFNODES_PREDUCECOLLECTOR_HPP_
 #define PICO_FF_IMPLEMENTATION_SUPPORTFFNODES_PREDUCECOLLECTOR_HPP_
 
+#include <ostream>
 #include <unordered_map>
 
+#include "pico/Internals/KVMicrobatch.hpp"
+#include "pico/Internals/KeyedReducer.hpp"
 #include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
 #include "pico/Internals/utils.hpp"
 
 #include "base_nodes.hpp"
@@ -33,54 +37,71 @@ class PReduceCollector : public base_sync_duplicate {
   typedef typename KV::keytype K;
   typedef typename KV::valuetype V;
   typedef pico::Microbatch<TokenType> mb_t;
+  typedef pico::kv_microbatch<TokenType> kv_mb;
+  typedef typename kv_mb::type in_mb_t;
 
  public:
-  PReduceCollector(unsigned nworkers_, std::function<V(V &, V &)> &rk_)
-      : base_sync_duplicate(nworkers_), rk(rk_) {}
+  PReduceCollector(unsigned nworkers_, std::function<V(V &, V &)> &rk_,
+                   unsigned mb_size_ = 0, size_t keys_ = 0,
+                   pico::keyed_state_cfg state_ = {})
+      : base_sync_duplicate(nworkers_),
+        rk(rk_),
+        mb_size(pico::microbatch_size(mb_size_)),
+        keys(keys_),
+        state(state_) {}
 
  private:
   std::function<V(V &, V &)> rk;
-  const int mb_size = pico::global_params.MICROBATCH_SIZE;
+  const unsigned mb_size;
+  const size_t keys;  // expected number of keys
+  const pico::keyed_state_cfg state;
 
   struct key_state {
-    std::unordered_map<K, V> kvmap;
+    key_state(size_t keys_, const pico::keyed_state_cfg &state_)
+        : kvmap(keys_, state_) {}
+    pico::keyed_reducer<K, V> kvmap;
   };
   std::unordered_map<pico::base_microbatch::tag_t, key_state> tag_state;
+  pico::spill_stats spilled;
 
   void kernel(pico::base_microbatch *in) {
-    auto in_microbatch = reinterpret_cast<mb_t *>(in);
+    auto in_microbatch = reinterpret_cast<in_mb_t *>(in);
     auto tag = in->tag();
-    auto &s(tag_state[tag]);
+    auto &s(tag_state.try_emplace(tag, keys, state).first->second);
     /* update the internal map */
-    for (KV &kv : *in_microbatch) {
-      auto &k(kv.Key());
-      if (s.kvmap.find(k) != s.kvmap.end())
-        s.kvmap[k] = rk(kv.Value(), s.kvmap[k]);
-      else
-        s.kvmap[k] = kv.Value();
-    }
+    kv_mb::reduce_into(s.kvmap, in_microbatch, rk);
     DELETE(in_microbatch);
   }
 
   void cstream_end_callback(pico::base_microbatch::tag_t tag) {
-    /* stream the internal map downstream */
-    auto &s(tag_state[tag]);
+    /* stream the internal state downstream (by key if sort-based) */
+    auto st = tag_state.find(tag);
+    if (st == tag_state.end()) return;
     auto out_microbatch = NEW<mb_t>(tag, mb_size);
-    for (auto it = s.kvmap.begin(); it != s.kvmap.end(); ++it) {
-      new (out_microbatch->allocate()) KV(it->first, it->second);
+    st->second.kvmap.drain(rk, [&](const K &k, const V &v) {
+      new (out_microbatch->allocate()) KV(k, v);
       out_microbatch->commit();
       if (out_microbatch->full()) {
         ff_send_out(reinterpret_cast<void *>(out_microbatch));
         out_microbatch = NEW<mb_t>(tag, mb_size);
       }
-    }
+    });
 
     /* send or delete residual microbatch */
     if (!out_microbatch->empty())
       ff_send_out(reinterpret_cast<void *>(out_microbatch));
     else
       DELETE(out_microbatch);
+    spilled.add(st->second.kvmap.spills());
+    tag_state.erase(st);
   }
+
+#ifdef TRACE_PICO
+  void ffStats(std::ostream &os) {
+    base_node::ffStats(os);
+    spilled.print(os);
+  }
+#endif
 };
 
 #endif /* PICO_FF_IMPLEMENTATION_SUPPORTFFNODES_PREDUCECOLLECTOR_HPP_ */
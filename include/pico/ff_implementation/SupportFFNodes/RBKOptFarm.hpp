@@ -18,124 +18,218 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifndef INTERNALS_FFOPERATORS_PREDUCEBATCH_HPP_
-#define INTERNALS_FFOPERATORS_PREDUCEBATCH_HPP_
+#ifndef INTERNALS_FFOPERATORS_RBKOPTFARM_HPP_
+#define INTERNALS_FFOPERATORS_RBKOPTFARM_HPP_
 
+#include <memory>
+#include <ostream>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
-#include <ff/farm.hpp>
-
+#include "pico/Internals/FlatHashMap.hpp"
+#include "pico/Internals/KVMicrobatch.hpp"
+#include "pico/Internals/KeyedReducer.hpp"
 #include "pico/Internals/Microbatch.hpp"
+#include "pico/Internals/MicrobatchSizer.hpp"
+#include "pico/Internals/SkewPartitioner.hpp"
 #include "pico/Internals/TimedToken.hpp"
 #include "pico/Internals/utils.hpp"
 
 #include "pico/ff_implementation/SupportFFNodes/PReduceCollector.hpp"
+#include "pico/ff_implementation/SupportFFNodes/ShuffleStage.hpp"
 #include "pico/ff_implementation/ff_config.hpp"
 
 /*
- * todo
- * this approach has poor performance, should be replaced by shuffling
+ * The shuffle stage of a parallel reduce-by-key.
+ *
+ * Senders (e.g., map workers) partition their key-value pairs by key and send
+ * them to the (stateful) reducers, that update their internal key-value state
+ * and, upon c-stream end, stream out the state.
  *
- * the (stateful) reduce-by-key farm updates the internal key-value state
- * and, upon c-stream end, streams out the state
+ * Senders may split hot keys across reducers (see skew_partitioner), after
+ * publishing them into the given hot_key_set. Reducers stream out the partial
+ * results of hot keys in dedicated micro-batches, that the collector merges
+ * before streaming them out upon c-stream end.
  */
 template <typename TokenType>
-class RBK_farm : public NonOrderingFarm {
+class RBK_shuffle : public ShuffleStage {
   typedef typename TokenType::datatype Out;
   typedef typename Out::keytype OutK;
   typedef typename Out::valuetype OutV;
+  typedef pico::Microbatch<TokenType> out_mb_t;
+  typedef std::shared_ptr<pico::hot_key_set<OutK>> hot_keys_t;
 
  public:
-  RBK_farm(int fmap_par, int red_par,
-           std::function<OutV(OutV &, OutV &)> reducef) {
-    auto e = new Emitter(red_par);
-    this->setEmitterF(e);
-    auto c = new ForwardingCollector(red_par);
-    this->setCollectorF(c);
-    std::vector<ff_node *> w;
+  RBK_shuffle(ff::ff_node *emitter, std::vector<ff::ff_node *> senders,
+              int red_par, std::function<OutV(OutV &, OutV &)> reducef,
+              hot_keys_t hot, unsigned mb_size = 0, size_t keys = 0,
+              pico::keyed_state_cfg state = {})
+      : ShuffleStage(emitter, senders,
+                     reducers(senders.size(), red_par, reducef, hot, mb_size,
+                              keys, state),
+                     new Collector(red_par, reducef, hot, mb_size)) {}
+
+ private:
+  static std::vector<ff::ff_node *> reducers(
+      unsigned nsenders, int red_par,
+      std::function<OutV(OutV &, OutV &)> &reducef, hot_keys_t &hot,
+      unsigned mb_size, size_t keys, pico::keyed_state_cfg state) {
+    /* each reducer gets a share of the keys */
+    size_t worker_keys = (keys + red_par - 1) / red_par;
+    std::vector<ff::ff_node *> w;
     for (int i = 0; i < red_par; ++i)
-      w.push_back(new Worker(fmap_par, reducef));
-    this->add_workers(w);
-    this->cleanup_all();
+      w.push_back(
+          new Worker(nsenders, reducef, hot, mb_size, worker_keys, state));
+    return w;
   }
 
-  class Emitter : public base_emitter {
+  class Worker : public base_sync_duplicate {
    public:
-    Emitter(unsigned nworkers_)
-        : base_emitter(nworkers_), nworkers(nworkers_) {}
+    Worker(int redundancy, std::function<OutV(OutV &, OutV &)> &reducef_kernel_,
+           hot_keys_t hot_, unsigned mb_size_, size_t keys_,
+           pico::keyed_state_cfg state_)
+        : base_sync_duplicate(redundancy),
+          reduce_kernel(reducef_kernel_),
+          hot(hot_),
+          mb_size(pico::microbatch_size(mb_size_)),
+          keys(keys_),
+          state(state_) {}
 
     void kernel(pico::base_microbatch *in_mb) {
-      auto in_microbatch = reinterpret_cast<mb_t *>(in_mb);
-      send_mb_to(in_mb, key_to_worker((*in_microbatch->begin()).Key()));
+      /*
+       * got a microbatch to process and delete
+       */
+      auto in_microbatch = reinterpret_cast<in_mb_t *>(in_mb);
+      auto tag = in_mb->tag();
+      auto &s(tag_state.try_emplace(tag, keys, state).first->second);
+
+      /* reduce the micro-batch updateing internal state */
+#ifdef TRACE_PICO
+      received += in_microbatch->size();
+#endif
+      kv_mb::reduce_into(s.kvmap, in_microbatch, reduce_kernel);
+
+      // clean up
+      DELETE(in_microbatch);
+    }
+
+    void cstream_end_callback(pico::base_microbatch::tag_t tag) {
+      auto st = tag_state.find(tag);
+      if (st == tag_state.end()) return;
+      out_mb_t *mb = nullptr, *hot_mb = nullptr;
+
+      /* keys split by any sender have been published by now */
+      hot->refresh(hot_keys);
+      st->second.kvmap.drain(reduce_kernel, [&](const OutK &k, const OutV &v) {
+        bool is_hot = !hot_keys.empty() && hot_keys.count(k);
+        emit(is_hot ? hot_mb : mb, tag, k, v);
+      });
+
+      /* send out the remainder micro-batches */
+      if (mb) ff_send_out(reinterpret_cast<void *>(mb));
+      if (hot_mb) ff_send_out(reinterpret_cast<void *>(hot_mb));
+      spilled.add(st->second.kvmap.spills());
+      tag_state.erase(st);
     }
 
+#ifdef TRACE_PICO
+    void ffStats(std::ostream &os) {
+      base_node::ffStats(os);
+      os << "  PICO-shuffle pairs received : " << received << "\n";
+      spilled.print(os);
+    }
+#endif
+
    private:
-    typedef typename TokenType::datatype DataType;
-    typedef typename DataType::keytype keytype;
-    typedef pico::Microbatch<TokenType> mb_t;
-    unsigned nworkers;
+    typedef pico::kv_microbatch<TokenType> kv_mb;
+    typedef typename kv_mb::type in_mb_t;
 
-    inline size_t key_to_worker(const keytype &k) {
-      return std::hash<keytype>{}(k) % nworkers;
+    std::function<OutV(OutV &, OutV &)> reduce_kernel;
+    hot_keys_t hot;
+    std::unordered_set<OutK> hot_keys;  // local copy of the hot keys
+    const unsigned mb_size;
+    const size_t keys;  // expected number of keys
+    const pico::keyed_state_cfg state;
+    struct key_state {
+      key_state(size_t keys_, const pico::keyed_state_cfg &state_)
+          : kvmap(keys_, state_) {}
+      pico::keyed_reducer<OutK, OutV> kvmap;
+    };
+    std::unordered_map<pico::base_microbatch::tag_t, key_state> tag_state;
+    pico::spill_stats spilled;
+#ifdef TRACE_PICO
+    unsigned long long received = 0;
+#endif
+
+    void emit(out_mb_t *&mb, pico::base_microbatch::tag_t tag, const OutK &k,
+              const OutV &v) {
+      if (!mb) mb = NEW<out_mb_t>(tag, mb_size);
+      new (mb->allocate()) Out(k, v);
+      mb->commit();
+      if (mb->full()) {
+        ff_send_out(reinterpret_cast<void *>(mb));
+        mb = nullptr;
+      }
     }
   };
 
- private:
-  class Worker : public base_sync_duplicate {
+  /*
+   * merges the partial results of hot keys, forwarding the rest
+   */
+  class Collector : public ShuffleCollector {
    public:
-    Worker(int redundancy, std::function<OutV(OutV &, OutV &)> &reducef_kernel_)
-        : base_sync_duplicate(redundancy), reduce_kernel(reducef_kernel_) {}
+    Collector(unsigned nw, std::function<OutV(OutV &, OutV &)> &reducef_,
+              hot_keys_t hot_, unsigned mb_size_)
+        : ShuffleCollector(nw),
+          reducef(reducef_),
+          hot(hot_),
+          mb_size(pico::microbatch_size(mb_size_)) {}
 
+   private:
     void kernel(pico::base_microbatch *in_mb) {
-      /*
-       * got a microbatch to process and delete
-       */
-      auto in_microbatch = reinterpret_cast<kv_mb *>(in_mb);
-      auto tag = in_mb->tag();
-      auto &s(tag_state[tag]);
+      auto mb = reinterpret_cast<out_mb_t *>(in_mb);
 
-      /* reduce the micro-batch updateing internal state */
-      for (Out &kv : *in_microbatch) {
-        auto &k(kv.Key());
-        if (s.kvmap.find(k) != s.kvmap.end())
-          s.kvmap[k] = reduce_kernel(kv.Value(), s.kvmap[k]);
-        else
-          s.kvmap[k] = kv.Value();
+      /* hot partial results come in dedicated micro-batches */
+      hot->refresh(hot_keys);
+      if (hot_keys.empty() || !hot_keys.count((*mb->begin()).Key())) {
+        send_mb(in_mb);
+        return;
       }
-
-      // clean up
-      DELETE(in_mb);
+      auto &merged(tag_state[in_mb->tag()]);
+      for (auto &kv : *mb) merged.reduce(kv.Key(), kv.Value(), reducef);
+      DELETE(mb);
     }
 
     void cstream_end_callback(pico::base_microbatch::tag_t tag) {
-      auto &s(tag_state[tag]);
-      auto mb = NEW<kv_mb>(tag, pico::global_params.MICROBATCH_SIZE);
-      for (auto it = s.kvmap.begin(); it != s.kvmap.end(); ++it) {
-        new (mb->allocate()) Out(it->first, it->second);
+      auto st = tag_state.find(tag);
+      if (st == tag_state.end()) return;
+      auto mb = NEW<out_mb_t>(tag, mb_size);
+      for (auto &kv : st->second) {
+        new (mb->allocate()) Out(kv.first, kv.second);
         mb->commit();
         if (mb->full()) {
-          ff_send_out(reinterpret_cast<void *>(mb));
-          mb = NEW<kv_mb>(tag, pico::global_params.MICROBATCH_SIZE);
+          send_mb(mb);
+          mb = NEW<out_mb_t>(tag, mb_size);
         }
       }
 
       /* send out the remainder micro-batch or destroy if spurious */
-      if (!mb->empty()) {
-        ff_send_out(reinterpret_cast<void *>(mb));
-      } else {
+      if (!mb->empty())
+        send_mb(mb);
+      else
         DELETE(mb);
-      }
+      tag_state.erase(st);
     }
 
-   private:
-    typedef pico::Microbatch<TokenType> kv_mb;
-
-    std::function<OutV(OutV &, OutV &)> reduce_kernel;
-    struct key_state {
-      std::unordered_map<OutK, OutV> kvmap;
-    };
-    std::unordered_map<pico::base_microbatch::tag_t, key_state> tag_state;
+    std::function<OutV(OutV &, OutV &)> reducef;
+    hot_keys_t hot;
+    std::unordered_set<OutK> hot_keys;  // local copy of the hot keys
+    const unsigned mb_size;
+    std::unordered_map<pico::base_microbatch::tag_t,
+                       pico::flat_hash_map<OutK, OutV>>
+        tag_state;
   };
 };
 
-#endif /* INTERNALS_FFOPERATORS_PREDUCEBATCH_HPP_ */
+#endif /* INTERNALS_FFOPERATORS_RBKOPTFARM_HPP_ */
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_SUPPORTFFNODES_SHUFFLESTAGE_HPP_
+#define INTERNALS_FFOPERATORS_SUPPORTFFNODES_SHUFFLESTAGE_HPP_
+
+#include <unordered_map>
+#include <vector>
+
+#include <ff/all2all.hpp>
+#include <ff/pipeline.hpp>
+
+#ifdef PICO_NUMA
+#include "pico/ff_implementation/numa.hpp"
+#endif
+
+#include "base_nodes.hpp"
+
+/*
+ * Gathers the output of the receivers of a shuffle stage.
+ *
+ * Forwards non-sync tokens and merges the sync tokens coming from the
+ * receivers: c-stream begin tokens are forwarded upon the first copy, while
+ * stream begin/end and c-stream end tokens are forwarded upon the last one.
+ */
+class ShuffleCollector : public base_mplex {
+ public:
+  ShuffleCollector(unsigned nw_)
+      : nw(nw_), pending_begin(nw_), pending_end(nw_) {}
+
+ protected:
+  virtual void kernel(pico::base_microbatch *mb) { send_mb(mb); }
+
+  /* called upon the last copy of a c-stream end, before forwarding it */
+  virtual void cstream_end_callback(pico::base_microbatch::tag_t) {}
+
+ private:
+  void handle_begin(pico::base_microbatch::tag_t tag) {
+    assert(pending_begin > 0);
+    if (!--pending_begin) send_mb(make_sync(tag, PICO_BEGIN));
+  }
+
+  bool handle_end(pico::base_microbatch::tag_t tag) {
+    assert(pending_end > 0);
+    if (!--pending_end) send_mb(make_sync(tag, PICO_END));
+    return false;
+  }
+
+  void handle_cstream_begin(pico::base_microbatch::tag_t tag) {
+    if (pending_cstream_end.find(tag) == pending_cstream_end.end()) {
+      pending_cstream_end[tag] = nw;
+      send_mb(make_sync(tag, PICO_CSTREAM_BEGIN));
+    }
+  }
+
+  void handle_cstream_end(pico::base_microbatch::tag_t tag) {
+    auto it = pending_cstream_end.find(tag);
+    assert(it != pending_cstream_end.end());
+    if (!--it->second) {
+      pending_cstream_end.erase(it);
+      cstream_end_callback(tag);
+      send_mb(make_sync(tag, PICO_CSTREAM_END));
+    }
+  }
+
+  unsigned nw, pending_begin, pending_end;
+  std::unordered_map<pico::base_microbatch::tag_t, unsigned>
+      pending_cstream_end;
+};
+
+/*
+ * An all-to-all shuffle stage:
+ *
+ *   emitter -> senders =(all-to-all)=> receivers -> collector
+ *
+ * Each sender (see base_shuffler) is connected to each receiver by a
+ * dedicated channel, so that it partitions its output and sends each
+ * micro-batch straight to the receiver in charge of it, with no central node
+ * traversed by shuffled data.
+ * Senders broadcast sync tokens, so that each receiver gets one copy per
+ * sender.
+ *
+ * The emitter is a multi-output node feeding the senders, while the collector
+ * (a ShuffleCollector) gathers the receivers' output.
+ */
+class ShuffleStage : public ff::ff_pipeline {
+ public:
+  ShuffleStage(ff::ff_node *emitter, std::vector<ff::ff_node *> senders,
+               std::vector<ff::ff_node *> receivers,
+               ShuffleCollector *collector) {
+#ifdef PICO_NUMA
+    pico::numa::place_workers(senders);
+    pico::numa::place_workers(receivers);
+#endif
+    auto a2a = new ff::ff_a2a();
+    a2a->add_firstset(senders, 0, true);
+    a2a->add_secondset(receivers, true);
+    this->add_stage(emitter);
+    this->add_stage(a2a);
+    this->add_stage(collector);
+    this->cleanup_nodes();
+  }
+};
+
+#endif /* INTERNALS_FFOPERATORS_SUPPORTFFNODES_SHUFFLESTAGE_HPP_ */
@@ -113,6 +113,12 @@ class sync_handler_filter : public sync_handler {
     if (!is_sync(in->payload())) {
 #ifdef TRACE_PICO
       tag_cnt[in->tag()].rcvd_data++;
+#endif
+#ifdef PICO_NUMA
+      if (in->numa_node() == pico::numa::this_node())
+        ++numa_local;
+      else
+        ++numa_remote;
 #endif
       kernel(in);
     } else {
@@ -128,7 +134,23 @@ class sync_handler_filter : public sync_handler {
 #endif
   }
 
+#ifdef PICO_NUMA
+  /* pins to the node assigned by the farm (if any) */
+  void numa_init(const void *self) {
+    pico::numa::run_on_node(pico::numa::placements().take(self));
+  }
+
+  void numa_end() {
+    pico::numa::stats().add(numa_local, numa_remote);
+    numa_local = numa_remote = 0;
+  }
+#endif
+
  private:
+#ifdef PICO_NUMA
+  unsigned long long numa_local = 0, numa_remote = 0;
+#endif
+
   virtual void handle_begin(pico::base_microbatch::tag_t tag) {
     // fprintf(stderr, "> %p begin tag=%llu\n", this, tag);
     assert(tag == pico::base_microbatch::nil_tag());
@@ -212,6 +234,15 @@ class base_filter : public base_node, public sync_handler_filter {
     work_flow(in);
     return GO_ON;
   }
+
+#ifdef PICO_NUMA
+  int svc_init() {
+    numa_init(static_cast<ff::ff_node *>(this));
+    return 0;
+  }
+
+  void svc_end() { numa_end(); }
+#endif
 };
 
 class base_emitter : public base_monode, public sync_handler_filter {
@@ -238,6 +269,15 @@ class base_emitter : public base_monode, public sync_handler_filter {
     return GO_ON;
   }
 
+#ifdef PICO_NUMA
+  int svc_init() {
+    numa_init(static_cast<ff::ff_node *>(this));
+    return 0;
+  }
+
+  void svc_end() { numa_end(); }
+#endif
+
 #ifdef TRACE_PICO
   std::chrono::duration<double> svcd;
 
@@ -248,6 +288,46 @@ class base_emitter : public base_monode, public sync_handler_filter {
 #endif
 };
 
+/*
+ * The sending side of a shuffle: a multi-output node sending each data
+ * micro-batch to a single destination, and sync tokens to all of them.
+ */
+class base_shuffler : public base_monode, public sync_handler_filter {
+ public:
+  base_shuffler(unsigned nw_) : nw(nw_) {}
+
+  virtual ~base_shuffler() {}
+
+ protected:
+  void send_mb_to(pico::base_microbatch *task, unsigned i) {
+    ff_send_out_to(task, i);
+  }
+
+  void send_mb(pico::base_microbatch *sync_mb) {
+    assert(is_sync(sync_mb->payload()));
+    for (unsigned i = 1; i < nw; ++i)
+      ff_send_out_to(make_sync(sync_mb->tag(), sync_mb->payload()), i);
+    ff_send_out_to(sync_mb, 0);
+  }
+
+ private:
+  unsigned nw;
+
+  pico::base_microbatch *svc(pico::base_microbatch *in) {
+    work_flow(in);
+    return GO_ON;
+  }
+
+#ifdef PICO_NUMA
+  int svc_init() {
+    numa_init(static_cast<ff::ff_node *>(this));
+    return 0;
+  }
+
+  void svc_end() { numa_end(); }
+#endif
+};
+
 class base_ord_emitter : public base_filter {
  public:
   base_ord_emitter(unsigned nw_) : nw(nw_) {}
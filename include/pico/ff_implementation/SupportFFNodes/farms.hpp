@@ -23,6 +23,10 @@
 
 #include <ff/farm.hpp>
 
+#ifdef PICO_NUMA
+#include "pico/ff_implementation/numa.hpp"
+#endif
+
 /*
  * A non-ordering farm.
  */
@@ -31,6 +35,13 @@ class NonOrderingFarm : public ff::ff_farm {
   using lb_t = ff::ff_farm::lb_t;
   void setEmitterF(ff::ff_node* f) { this->add_emitter(f); }
   void setCollectorF(ff::ff_node* f) { this->add_collector(f); }
+
+#ifdef PICO_NUMA
+  int add_workers(std::vector<ff::ff_node*>& w) {
+    pico::numa::place_workers(w);
+    return ff::ff_farm::add_workers(w);
+  }
+#endif
 };
 
 /*
@@ -43,6 +54,13 @@ class OrderingFarm : public ff::ff_farm {
   void setEmitterF(ff::ff_node* f) { this->add_emitter(f); }
 
   void setCollectorF(ff::ff_node* f) { this->add_collector(f); }
+
+#ifdef PICO_NUMA
+  int add_workers(std::vector<ff::ff_node*>& w) {
+    pico::numa::place_workers(w);
+    return ff::ff_farm::add_workers(w);
+  }
+#endif
 };
 
 #endif /* INTERNALS_FFOPERATORS_SUPPORTFFNODES_FARMWRAPPER_HPP_ */
@@ -39,6 +39,24 @@ static inline void DELETE(_Tp *p) {
   (p)->~_Tp();
   FREE(p);
 }
+#elif defined(PICO_POOL_ALLOC)
+#include "pool_allocator.hpp"
+
+static inline void *MALLOC(size_t size) { return pico::pool::allocate(size); }
+static inline void FREE(void *ptr) { pico::pool::deallocate(ptr); }
+static inline int POSIX_MEMALIGN(void **dst, size_t align, size_t size) {
+  return pico::pool::posix_memalign(dst, align, size);
+}
+template <typename _Tp, typename... _Args>
+static inline _Tp *NEW(_Args &&... __args) {
+  auto ptr = (_Tp *)MALLOC(sizeof(_Tp));
+  return new (ptr) _Tp(std::forward<_Args>(__args)...);
+}
+template <typename _Tp>
+static inline void DELETE(_Tp *p) {
+  (p)->~_Tp();
+  FREE(p);
+}
 #else
 #include <cstdlib>
 static inline void *MALLOC(size_t size) { return ::malloc(size); }
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_NUMA_HPP_
+#define INTERNALS_FFOPERATORS_NUMA_HPP_
+
+#include <numa.h>
+#include <sched.h>
+
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * NUMA-aware placement.
+ *
+ * Farm workers are pinned to NUMA nodes in contiguous blocks (i.e., worker i
+ * out of n runs on node i * nodes / n), with node-local allocation.
+ * Since microbatches and per-tag reduce state are allocated and first touched
+ * by the thread filling them, they are then placed on the node of the worker
+ * producing them.
+ *
+ * Each data microbatch is stamped with the node it was produced on, so that
+ * consumers can count local and remote deliveries.
+ */
+
+namespace pico {
+namespace numa {
+
+static inline bool available() {
+  static bool res = numa_available() >= 0;
+  return res;
+}
+
+static inline int n_nodes() {
+  return available() ? numa_num_configured_nodes() : 1;
+}
+
+/* the node a thread is pinned to, -1 if not pinned */
+inline int &pinned_node() {
+  static thread_local int node = -1;
+  return node;
+}
+
+/*
+ * the node the calling thread is running on
+ */
+static inline int this_node() {
+  int node = pinned_node();
+  if (node >= 0 || !available()) return node < 0 ? 0 : node;
+  int cpu = sched_getcpu();
+  node = cpu < 0 ? -1 : numa_node_of_cpu(cpu);
+  return node < 0 ? 0 : node;
+}
+
+/*
+ * pins the calling thread to a node and makes its allocations node-local
+ */
+static inline void run_on_node(int node) {
+  if (!available() || node < 0) return;
+  if (numa_run_on_node(node)) return;
+  numa_set_localalloc();
+  pinned_node() = node;
+}
+
+/*
+ * Placement hints, set by farms when adding workers and consumed by each
+ * node when its thread starts.
+ */
+class placement_registry {
+ public:
+  void place(const void *n, int node) {
+    std::lock_guard<std::mutex> lock(mtx);
+    hints[n] = node;
+  }
+
+  int take(const void *n) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = hints.find(n);
+    if (it == hints.end()) return -1;
+    auto res = it->second;
+    hints.erase(it);
+    return res;
+  }
+
+ private:
+  std::mutex mtx;
+  std::unordered_map<const void *, int> hints;
+};
+
+inline placement_registry &placements() {
+  static placement_registry r;
+  return r;
+}
+
+/*
+ * assigns farm workers to nodes in contiguous blocks
+ */
+template <typename Node>
+static inline void place_workers(const std::vector<Node *> &w) {
+  auto nw = w.size();
+  for (size_t i = 0; i < nw; ++i)
+    placements().place(w[i], (int)(i * n_nodes() / nw));
+}
+
+/*
+ * global microbatch delivery counters
+ */
+class delivery_stats {
+ public:
+  void add(unsigned long long local, unsigned long long remote) {
+    local_.fetch_add(local, std::memory_order_relaxed);
+    remote_.fetch_add(remote, std::memory_order_relaxed);
+  }
+
+  void print(std::ostream &os) {
+    auto l = local_.load(std::memory_order_relaxed);
+    auto r = remote_.load(std::memory_order_relaxed);
+    os << "*** NUMA ***\n";
+    os << "nodes             : " << n_nodes() << "\n";
+    os << "local deliveries  : " << l << "\n";
+    os << "remote deliveries : " << r;
+    if (l + r) os << " (" << 100.0 * r / (l + r) << "%)";
+    os << "\n";
+  }
+
+ private:
+  std::atomic<unsigned long long> local_{0}, remote_{0};
+};
+
+inline delivery_stats &stats() {
+  static delivery_stats s;
+  return s;
+}
+
+static inline void print_stats(std::ostream &os) { stats().print(os); }
+
+} /* namespace numa */
+} /* namespace pico */
+
+#endif /* INTERNALS_FFOPERATORS_NUMA_HPP_ */
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERNALS_FFOPERATORS_POOL_ALLOCATOR_HPP_
+#define INTERNALS_FFOPERATORS_POOL_ALLOCATOR_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/*
+ * Recycling allocator for microbatch chunks and sync tokens.
+ *
+ * Blocks are grouped into power-of-two size classes and cached per thread.
+ * A block remembers the cache it was carved from: a free issued by the owner
+ * thread goes back to the local free list, whereas a free issued by any other
+ * thread (the common case, since microbatches travel downstream) is pushed
+ * onto a lock-free stack of the owner, that the owner drains in one shot when
+ * its local list runs dry.
+ * Remote stacks are multi-producer/single-consumer and the consumer only
+ * detaches the whole list, so the push path is ABA-free.
+ *
+ * Thread caches are never released: when a thread exits its cache is
+ * orphaned and adopted by the next thread asking for one, so that blocks
+ * freed to a dead owner are not lost.
+ */
+
+namespace pico {
+namespace pool {
+
+constexpr unsigned min_class_shift = 5; /* 32B */
+constexpr unsigned n_classes = 14;      /* up to 256KB */
+constexpr size_t max_class_size = size_t(1) << (min_class_shift + n_classes - 1);
+constexpr size_t cache_bytes_per_class = size_t(4) << 20;
+constexpr uint32_t large_class = ~uint32_t(0);
+
+class thread_cache;
+
+/* prepended to each block, keeps user pointers 16B-aligned */
+struct alignas(16) block_header {
+  union {
+    thread_cache *owner; /* size-classed blocks */
+    void *base;          /* large (or over-aligned) blocks */
+  };
+  uint32_t sclass;
+};
+
+struct free_block {
+  free_block *next;
+};
+
+static inline unsigned size_class(size_t size) {
+  unsigned c = 0;
+  size_t cs = size_t(1) << min_class_shift;
+  while (cs < size) {
+    cs <<= 1;
+    ++c;
+  }
+  return c;
+}
+
+static inline size_t class_size(unsigned c) {
+  return size_t(1) << (min_class_shift + c);
+}
+
+static inline size_t class_capacity(unsigned c) {
+  size_t n = cache_bytes_per_class / class_size(c);
+  return n < 4 ? 4 : n;
+}
+
+class thread_cache {
+ public:
+  thread_cache() {
+    for (unsigned c = 0; c < n_classes; ++c) {
+      local[c] = nullptr;
+      local_cnt[c] = 0;
+      remote[c].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  void *allocate(unsigned c) {
+    free_block *b = local[c];
+    if (!b) {
+      /* reclaim blocks released by consumer threads */
+      b = remote[c].exchange(nullptr, std::memory_order_acquire);
+      local_cnt[c] = 0;
+      if (b) {
+        for (free_block *p = b->next; p; p = p->next) ++local_cnt[c];
+        ++local_cnt[c];
+      }
+    }
+    if (b) {
+      local[c] = b->next;
+      --local_cnt[c];
+      hits.store(hits.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+      return b;
+    }
+    misses.store(misses.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+    auto h = (block_header *)::malloc(sizeof(block_header) + class_size(c));
+    if (!h) return nullptr;
+    h->owner = this;
+    h->sclass = c;
+    return h + 1;
+  }
+
+  /* called by the owner thread */
+  void free_local(block_header *h) {
+    auto c = h->sclass;
+    if (local_cnt[c] >= class_capacity(c)) {
+      ::free(h);
+      return;
+    }
+    auto b = reinterpret_cast<free_block *>(h + 1);
+    b->next = local[c];
+    local[c] = b;
+    ++local_cnt[c];
+  }
+
+  /* called by any thread but the owner */
+  void free_remote(block_header *h) {
+    auto c = h->sclass;
+    auto b = reinterpret_cast<free_block *>(h + 1);
+    b->next = remote[c].load(std::memory_order_relaxed);
+    while (!remote[c].compare_exchange_weak(b->next, b,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed))
+      ;
+    remote_frees.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::atomic<unsigned long long> hits{0}, misses{0}, remote_frees{0};
+
+ private:
+  /* owner-only */
+  free_block *local[n_classes];
+  size_t local_cnt[n_classes];
+
+  /* pushed by other threads, drained by the owner */
+  std::atomic<free_block *> remote[n_classes];
+};
+
+/*
+ * keeps track of all the thread caches, for adoption and statistics
+ */
+class cache_registry {
+ public:
+  thread_cache *acquire() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!orphans.empty()) {
+      auto res = orphans.back();
+      orphans.pop_back();
+      return res;
+    }
+    auto res = new thread_cache();
+    caches.push_back(res);
+    return res;
+  }
+
+  void release(thread_cache *c) {
+    std::lock_guard<std::mutex> lock(mtx);
+    orphans.push_back(c);
+  }
+
+  void print_stats(std::ostream &os) {
+    unsigned long long h = 0, m = 0, r = 0;
+    size_t n;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      n = caches.size();
+      for (auto c : caches) {
+        h += c->hits.load(std::memory_order_relaxed);
+        m += c->misses.load(std::memory_order_relaxed);
+        r += c->remote_frees.load(std::memory_order_relaxed);
+      }
+    }
+    auto l = large_allocs.load(std::memory_order_relaxed);
+    auto tot = h + m;
+    os << "*** pool allocator ***\n";
+    os << "thread caches     : " << n << "\n";
+    os << "pooled allocations: " << tot << "\n";
+    os << "  hits            : " << h;
+    if (tot) os << " (" << 100.0 * h / tot << "%)";
+    os << "\n";
+    os << "  misses          : " << m << "\n";
+    os << "remote frees      : " << r << "\n";
+    os << "large allocations : " << l << "\n";
+  }
+
+  std::atomic<unsigned long long> large_allocs{0};
+
+ private:
+  std::mutex mtx;
+  std::vector<thread_cache *> caches, orphans;
+};
+
+/* never destroyed, blocks may be freed during static destruction */
+inline cache_registry &registry() {
+  static cache_registry *r = new cache_registry();
+  return *r;
+}
+
+class cache_handle {
+ public:
+  ~cache_handle() {
+    if (cache) registry().release(cache);
+    cache = nullptr;
+    dead = true;
+  }
+
+  thread_cache *get() {
+    if (!cache && !dead) cache = registry().acquire();
+    return cache;
+  }
+
+ private:
+  thread_cache *cache = nullptr;
+  bool dead = false;
+};
+
+inline thread_cache *my_cache() {
+  static thread_local cache_handle h;
+  return h.get();
+}
+
+static inline void *allocate_large(size_t size, size_t align) {
+  size_t pad = align > alignof(block_header) ? align : 0;
+  auto base = (char *)::malloc(sizeof(block_header) + size + pad);
+  if (!base) return nullptr;
+  uintptr_t p = (uintptr_t)(base + sizeof(block_header));
+  if (pad) p = (p + align - 1) & ~(uintptr_t)(align - 1);
+  auto h = (block_header *)p - 1;
+  h->base = base;
+  h->sclass = large_class;
+  registry().large_allocs.fetch_add(1, std::memory_order_relaxed);
+  return (void *)p;
+}
+
+static inline void *allocate(size_t size) {
+  thread_cache *tc;
+  if (size <= max_class_size && (tc = my_cache()))
+    return tc->allocate(size_class(size));
+  return allocate_large(size, alignof(block_header));
+}
+
+static inline void deallocate(void *ptr) {
+  if (!ptr) return;
+  auto h = (block_header *)ptr - 1;
+  if (h->sclass == large_class) {
+    ::free(h->base);
+    return;
+  }
+  auto tc = my_cache();
+  if (h->owner == tc)
+    tc->free_local(h);
+  else
+    h->owner->free_remote(h);
+}
+
+static inline int posix_memalign(void **dst, size_t align, size_t size) {
+  if (align <= alignof(block_header))
+    *dst = allocate(size);
+  else
+    *dst = allocate_large(size, align);
+  return *dst ? 0 : ENOMEM;
+}
+
+static inline void print_stats(std::ostream &os) { registry().print_stats(os); }
+
+} /* namespace pool */
+} /* namespace pico */
+
+#endif /* INTERNALS_FFOPERATORS_POOL_ALLOCATOR_HPP_ */
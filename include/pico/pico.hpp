@@ -28,6 +28,7 @@
 /* basic */
 #include "pico/FlatMapCollector.hpp"
 #include "pico/KeyValue.hpp"
+#include "pico/LineView.hpp"
 #include "pico/Pipe.hpp"
 #include "pico/SemanticGraph.hpp"
 #include "pico/WindowPolicy.hpp"
@@ -35,9 +36,19 @@
 /* operators */
 #include "pico/Operators/FlatMap.hpp"
 #include "pico/Operators/FoldReduce.hpp"
+#include "pico/Operators/InOut/ReadFromBinaryFile.hpp"
+#ifdef PICO_ZLIB
+#include "pico/Operators/InOut/ReadFromCompressedFile.hpp"
+#endif
 #include "pico/Operators/InOut/ReadFromFile.hpp"
+#include "pico/Operators/InOut/ReadFromFiles.hpp"
 #include "pico/Operators/InOut/ReadFromSocket.hpp"
+#include "pico/Operators/InOut/ReadFromSockets.hpp"
 #include "pico/Operators/InOut/ReadFromStdIn.hpp"
+#include "pico/Operators/InOut/WriteToBinaryFile.hpp"
+#ifdef PICO_ZLIB
+#include "pico/Operators/InOut/WriteToCompressedFile.hpp"
+#endif
 #include "pico/Operators/InOut/WriteToDisk.hpp"
 #include "pico/Operators/InOut/WriteToStdOut.hpp"
 #include "pico/Operators/JoinFlatMapByKey.hpp"
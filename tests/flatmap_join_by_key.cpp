@@ -18,6 +18,8 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <fstream>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -197,3 +199,59 @@ TEST_CASE("JoinFlatMapByKey plus reduce by key", "[JoinFlatMapByKeyTag]") {
 
   REQUIRE(expected == observed);
 }
+
+TEST_CASE("JoinFlatMapByKey with many keys per micro-batch",
+          "[JoinFlatMapByKeyTag]") {
+  typedef pico::KeyValue<int, int> IKV;
+  std::string small_file = "join_small.txt", large_file = "join_large.txt";
+  std::string output_file = "output.txt";
+  const int small_keys = 5000, large_keys = 20000;
+
+  /*
+   * Both sides repeat each of their keys, and micro-batches mix thousands of
+   * distinct keys. The left (cached) side is much smaller than the right one,
+   * so that it usually ends first and the remaining right items are joined
+   * without being stored.
+   */
+  std::unordered_map<int, std::vector<int>> small_values;
+  {
+    std::ofstream out(small_file);
+    for (int i = 0; i < 2 * small_keys; ++i) {
+      IKV kv(i % small_keys, i);
+      out << kv.to_string() << "\n";
+      small_values[kv.Key()].push_back(kv.Value());
+    }
+  }
+  std::vector<std::string> expected;
+  {
+    std::ofstream out(large_file);
+    for (int i = 0; i < 10 * large_keys; ++i) {
+      IKV kv(i % large_keys, -i);
+      out << kv.to_string() << "\n";
+      for (int v : small_values[kv.Key()])
+        expected.push_back(IKV(kv.Key(), v + kv.Value()).to_string());
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+
+  auto to_pair = pico::Map<std::string, IKV>(
+      [](std::string line) { return IKV::from_string(line); }, 2);
+  auto small = pico::Pipe().add(pico::ReadFromFile(small_file)).add(to_pair);
+  auto large =
+      pico::Pipe().add(pico::ReadFromFile(large_file, 2)).add(to_pair);
+
+  small
+      .pair_with(large, pico::JoinFlatMapByKey<IKV, IKV, IKV>(
+                            [](IKV& in1, IKV& in2,
+                               pico::FlatMapCollector<IKV>& collector) {
+                              collector.add(in1 + in2);
+                            },
+                            2))
+      .add(pico::WriteToDisk<IKV>(output_file))
+      .run();
+
+  auto observed = read_lines(output_file);
+  std::sort(observed.begin(), observed.end());
+
+  REQUIRE(expected == observed);
+}
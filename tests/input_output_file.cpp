@@ -18,7 +18,13 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <string>
 
 #include <catch.hpp>
@@ -50,3 +56,349 @@ TEST_CASE("read and write", "read and write tag") {
 
   REQUIRE(input_lines == output_lines);
 }
+
+TEST_CASE("parallel write", "parallel write tag") {
+  std::string input_file = "./testdata/lines.txt";
+  std::string output_file = "output.txt";
+  std::vector<std::string> output_lines;
+
+  pico::ReadFromFile reader(input_file, 4);
+
+  SECTION("single file") {
+    pico::WriteToDisk<std::string> writer(output_file);
+    pico::Pipe().add(reader).add(writer.parallel(4)).run();
+    output_lines = read_lines(output_file);
+  }
+  SECTION("shards") {
+    std::string shards_dir = "output.shards";
+    std::string stale = shards_dir + "/part-00009";
+    mkdir(shards_dir.c_str(), 0755);
+    std::ofstream(stale) << "left by a former run\n";
+
+    pico::WriteToDisk<std::string> writer(shards_dir);
+    pico::Pipe().add(reader).add(writer.shards(4)).run();
+    for (auto part : {"part-00000", "part-00001", "part-00002", "part-00003"}) {
+      auto lines = read_lines(shards_dir + "/" + part);
+      output_lines.insert(output_lines.end(), lines.begin(), lines.end());
+    }
+    REQUIRE(!std::ifstream(stale));
+  }
+
+  /* forget the order and compare */
+  auto input_lines = read_lines(input_file);
+  std::sort(input_lines.begin(), input_lines.end());
+  std::sort(output_lines.begin(), output_lines.end());
+
+  REQUIRE(input_lines == output_lines);
+}
+
+TEST_CASE("parallel write in stream order", "parallel write tag") {
+  std::string input_file = "./testdata/lines.txt";
+  std::string output_file = "output.txt";
+
+  /* a sequential reader produces the lines in file order */
+  auto p = pico::Pipe().add(pico::ReadFromFile(input_file, 1).microbatch(8));
+  pico::WriteToDisk<std::string> writer(output_file);
+
+  SECTION("single file") { p.add(writer.parallel(4)).run(); }
+  SECTION("single file, asynchronous writes") {
+    p.add(writer.parallel(4).async_write()).run();
+  }
+
+  REQUIRE(read_lines(input_file) == read_lines(output_file));
+}
+
+/* expands each line into many numbered copies */
+static const int expand_copies = 500;
+static void expand(std::string &line, pico::FlatMapCollector<std::string> &c) {
+  for (int i = 0; i < expand_copies; ++i)
+    c.add(line + "#" + std::to_string(i));
+}
+
+TEST_CASE("parallel write of large outputs", "parallel write tag") {
+  std::string input_file = "./testdata/lines.txt";
+  std::string output_file = "output.txt";
+
+  /*
+   * each writer fills several buffers, whose flushes to the shared file must
+   * keep lines whole
+   */
+  auto p = pico::Pipe()
+               .add(pico::ReadFromFile(input_file, 4))
+               .add(pico::FlatMap<std::string, std::string>(expand));
+  pico::WriteToDisk<std::string> writer(output_file);
+
+  SECTION("single file") { p.add(writer.parallel(4)).run(); }
+  SECTION("single file, asynchronous writes") {
+    p.add(writer.parallel(4).async_write()).run();
+  }
+
+  std::vector<std::string> expected;
+  std::ifstream in(input_file);
+  for (std::string line; std::getline(in, line);)
+    for (int i = 0; i < expand_copies; ++i)
+      expected.push_back(line + "#" + std::to_string(i));
+  auto output_lines = read_lines(output_file);
+  std::sort(expected.begin(), expected.end());
+  std::sort(output_lines.begin(), output_lines.end());
+
+  REQUIRE(expected == output_lines);
+}
+
+TEST_CASE("read multiple files", "read multiple files tag") {
+  std::string input_file = "./testdata/lines.txt";
+  std::string shards_dir = "input.shards";
+  std::string output_file = "output.txt";
+
+  /* split the input into part files */
+  pico::Pipe()
+      .add(pico::ReadFromFile(input_file))
+      .add(pico::WriteToDisk<std::string>(shards_dir).shards(4))
+      .run();
+
+  pico::WriteToDisk<pico::LineView> writer(output_file);
+  SECTION("directory") {
+    pico::Pipe()
+        .add(pico::ReadFromFiles<pico::LineView>(shards_dir))
+        .add(writer)
+        .run();
+  }
+  SECTION("glob") {
+    pico::Pipe()
+        .add(pico::ReadFromFiles<pico::LineView>(shards_dir + "/part-*", 2))
+        .add(writer)
+        .run();
+  }
+  SECTION("list") {
+    std::vector<std::string> inputs{shards_dir + "/part-00000",
+                                    shards_dir + "/part-00001",
+                                    shards_dir + "/part-0000[23]"};
+    pico::Pipe()
+        .add(pico::ReadFromFiles<pico::LineView>(inputs))
+        .add(writer)
+        .run();
+  }
+
+  /* forget the order and compare */
+  auto input_lines = read_lines(input_file);
+  auto output_lines = read_lines(output_file);
+  std::sort(input_lines.begin(), input_lines.end());
+  std::sort(output_lines.begin(), output_lines.end());
+
+  REQUIRE(input_lines == output_lines);
+}
+
+TEST_CASE("read multiple large files", "read multiple files tag") {
+  std::string input_file = "./testdata/lines.txt";
+  std::string large_file = "input.large.txt";
+  std::string output_file = "output.txt";
+
+  /* a file spanning several split units, of lines of varying length */
+  {
+    std::ofstream out(large_file);
+    for (int i = 0; i < 400000; ++i)
+      out << "line " << i << " " << std::string(i % 41, 'x') << "\n";
+  }
+
+  std::vector<std::string> inputs{large_file, input_file};
+  pico::Pipe()
+      .add(pico::ReadFromFiles<pico::LineView>(inputs, 2))
+      .add(pico::WriteToDisk<pico::LineView>(output_file))
+      .run();
+
+  /* forget the order and compare against sequential reads */
+  auto input_lines = read_lines(large_file);
+  auto small_lines = read_lines(input_file);
+  input_lines.insert(input_lines.end(), small_lines.begin(), small_lines.end());
+  auto output_lines = read_lines(output_file);
+  std::sort(input_lines.begin(), input_lines.end());
+  std::sort(output_lines.begin(), output_lines.end());
+
+  REQUIRE(input_lines == output_lines);
+}
+
+TEST_CASE("read and write line views", "read and write line views tag") {
+  std::string input_file = "./testdata/lines.txt";
+  std::string output_file = "output.txt";
+
+  /* read lines as views into shared input blocks, by a single reader */
+  pico::BasicReadFromFile<pico::LineView> reader(input_file, 1);
+  pico::WriteToDisk<pico::LineView> writer(output_file);
+
+  auto io_file_pipe = pico::Pipe()  // the empty pipeline
+                          .add(reader)
+                          .add(writer);
+
+  SECTION("sequential reader") { io_file_pipe.run(); }
+  SECTION("parallel reader") {
+    pico::Pipe()
+        .add(pico::BasicReadFromFile<pico::LineView>(input_file, 4))
+        .add(writer)
+        .run();
+  }
+  SECTION("sequential memory-mapped reader") {
+    pico::Pipe()
+        .add(pico::BasicReadFromFile<pico::LineView>(input_file, 1).mmap())
+        .add(writer)
+        .run();
+  }
+  SECTION("memory-mapped reader") {
+    pico::Pipe()
+        .add(pico::BasicReadFromFile<pico::LineView>(input_file, 4).mmap())
+        .add(writer)
+        .run();
+  }
+  SECTION("sequential asynchronous reader") {
+    pico::Pipe()
+        .add(pico::BasicReadFromFile<pico::LineView>(input_file, 1)
+                 .async_io(2, 64))
+        .add(writer)
+        .run();
+  }
+  SECTION("direct asynchronous reader") {
+    pico::Pipe()
+        .add(pico::BasicReadFromFile<pico::LineView>(input_file, 4).direct_io())
+        .add(writer)
+        .run();
+  }
+  SECTION("asynchronous reader") {
+    pico::Pipe()
+        .add(pico::BasicReadFromFile<pico::LineView>(input_file, 4)
+                 .async_io(2, 64))
+        .add(writer)
+        .run();
+  }
+  SECTION("fine-grained chunks") {
+    pico::Pipe()
+        .add(pico::BasicReadFromFile<pico::LineView>(input_file, 4)
+                 .chunk_size(4096))
+        .add(writer)
+        .run();
+  }
+
+  /* forget the order and compare */
+  auto input_lines = read_lines(input_file);
+  auto output_lines = read_lines(output_file);
+  std::sort(input_lines.begin(), input_lines.end());
+  std::sort(output_lines.begin(), output_lines.end());
+
+  REQUIRE(input_lines == output_lines);
+}
+
+#ifdef PICO_ZLIB
+TEST_CASE("read and write compressed", "read and write compressed tag") {
+  std::string input_file = "./testdata/lines.txt";
+  std::string compressed_file = "output.pzb";
+  std::string output_file = "output.txt";
+
+  /* compress by small blocks */
+  pico::Pipe()
+      .add(pico::ReadFromFile(input_file))
+      .add(pico::WriteToCompressedFile<std::string>(compressed_file, 1024))
+      .run();
+
+  pico::WriteToDisk<std::string> writer(output_file);
+  SECTION("sequential reader") {
+    pico::Pipe()
+        .add(pico::ReadFromCompressedFile(compressed_file, 1))
+        .add(writer)
+        .run();
+  }
+  SECTION("parallel reader") {
+    pico::Pipe()
+        .add(pico::ReadFromCompressedFile<pico::LineView>(compressed_file, 4))
+        .add(pico::WriteToDisk<pico::LineView>(output_file))
+        .run();
+  }
+
+  /* forget the order and compare */
+  auto input_lines = read_lines(input_file);
+  auto output_lines = read_lines(output_file);
+  std::sort(input_lines.begin(), input_lines.end());
+  std::sort(output_lines.begin(), output_lines.end());
+
+  REQUIRE(input_lines == output_lines);
+}
+
+TEST_CASE("compressed file format", "read and write compressed tag") {
+  std::string compressed_file = "output.pzb";
+  const int lines = 1000;
+
+  std::vector<std::string> expected;
+  {
+    zblock::writer out(compressed_file, 256);
+    for (int i = 0; i < lines; ++i) {
+      expected.push_back("line " + std::to_string(i));
+      out.write_line(expected.back());
+    }
+  }
+
+  /* the trailer is little-endian, whatever the host byte order */
+  std::ifstream in(compressed_file, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)),
+                    std::istreambuf_iterator<char>());
+  REQUIRE(bytes.size() > 32);
+  const char *t = bytes.data() + bytes.size() - 24;
+  uint64_t n_blocks = 0, index_offset = 0;
+  for (int i = 7; i >= 0; --i) {
+    n_blocks = (n_blocks << 8) | (unsigned char)t[i];
+    index_offset = (index_offset << 8) | (unsigned char)t[8 + i];
+  }
+  REQUIRE(std::string(t + 16, 8) == "PICOZIX1");
+  REQUIRE(n_blocks > 1);
+  REQUIRE(index_offset + n_blocks * 16 + 24 == bytes.size());
+
+  /* blocks are found through the index and hold all the lines, in order */
+  int fd = open(compressed_file.c_str(), O_RDONLY);
+  std::vector<zblock::entry> index;
+  REQUIRE(zblock::read_index(fd, index));
+  REQUIRE(index.size() == n_blocks);
+  REQUIRE(index[0].offset == 8);
+  std::vector<std::string> observed;
+  std::string cbuf;
+  for (auto &e : index) {
+    auto blk = zblock::read_block(fd, e, cbuf);
+    zblock::for_each_line(blk, e.size,
+                          [&](pico::line_block *, const char *p, size_t n) {
+                            observed.emplace_back(p, n);
+                          });
+    blk->unref();
+  }
+  close(fd);
+  REQUIRE(expected == observed);
+}
+#endif
+
+TEST_CASE("read and write binary", "read and write binary tag") {
+  typedef pico::KeyValue<unsigned, float> KV;
+  std::string input_file = "./testdata/lines.txt";
+  std::string binary_file = "output.bin";
+  std::string output_file = "output.txt";
+
+  /* write key-value records */
+  auto to_kv = [](std::string &line) {
+    return KV(line.size(), line.size() / 2.0f);
+  };
+  pico::Pipe()
+      .add(pico::ReadFromFile(input_file))
+      .add(pico::Map<std::string, KV>(to_kv))
+      .add(pico::WriteToBinaryFile<KV>(binary_file))
+      .run();
+
+  /* read them back in parallel */
+  pico::Pipe()
+      .add(pico::ReadFromBinaryFile<KV>(binary_file, 4))
+      .add(pico::WriteToDisk<KV>(output_file))
+      .run();
+
+  /* empty lines are also records */
+  std::vector<std::string> expected;
+  std::ifstream in(input_file);
+  for (std::string line; std::getline(in, line);)
+    expected.push_back(to_kv(line).to_string());
+  auto output_lines = read_lines(output_file);
+  std::sort(expected.begin(), expected.end());
+  std::sort(output_lines.begin(), output_lines.end());
+
+  REQUIRE(expected == output_lines);
+}
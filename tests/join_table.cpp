@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include "pico/pico.hpp"
+
+typedef pico::KeyValue<int, int> KV;
+typedef pico::base_microbatch::tag_t tag_t;
+
+/*
+ * The join table and the join workers are driven directly, so that the order
+ * of the incoming micro-batches is fixed rather than left to scheduling.
+ */
+
+TEST_CASE("join table", "[join table]") {
+  pico::join_table<KV> table;
+  std::vector<KV> probes;
+  for (int k = 0; k < 1000; ++k) probes.push_back(KV(k, 0));
+
+  SECTION("empty table") {
+    unsigned matches = 0;
+    table.probe(probes, [&](KV &, KV &) { ++matches; });
+    REQUIRE(matches == 0);
+  }
+
+  SECTION("empty partitions") {
+    /* a single stored key, thus most of the probes hit empty partitions */
+    table.insert(KV(7, 1));
+    table.insert(KV(7, 2));
+    std::vector<std::pair<int, int>> matches;
+    table.probe(probes, [&](KV &in, KV &t) {
+      matches.emplace_back(in.Key(), t.Value());
+    });
+    REQUIRE(matches == (std::vector<std::pair<int, int>>{{7, 2}, {7, 1}}));
+  }
+
+  SECTION("duplicate keys across partitions") {
+    /*
+     * 500 keys (spread over all the partitions) inserted in rounds, with a
+     * different number of items for each key, each one matched in reverse
+     * insertion order
+     */
+    std::map<int, std::vector<int>> stored;
+    std::vector<KV> items;
+    for (int round = 0; round < 8; ++round)
+      for (int k = 0; k < 500; ++k)
+        if (round <= k % 8) {
+          items.push_back(KV(k, round * 1000 + k));
+          stored[k].insert(stored[k].begin(), round * 1000 + k);
+        }
+    table.insert_all(items);
+    REQUIRE(table.size() == items.size());
+
+    /* probe each key twice, along with absent keys */
+    probes.insert(probes.end(), probes.begin(), probes.end());
+    std::map<int, std::vector<int>> matched;
+    unsigned n = 0;
+    bool same_key = true;
+    table.probe(probes, [&](KV &in, KV &t) {
+      same_key = same_key && in.Key() == t.Key();
+      matched[in.Key()].push_back(t.Value());
+      ++n;
+    });
+    REQUIRE(same_key);
+    REQUIRE(n == 2 * items.size());
+    for (auto &kv : stored) {
+      auto &m(matched[kv.first]);
+      auto twice(kv.second);
+      twice.insert(twice.end(), kv.second.begin(), kv.second.end());
+      REQUIRE(m == twice);
+    }
+    REQUIRE(matched.size() == stored.size());
+
+    table.clear();
+    REQUIRE(table.empty());
+    table.probe(probes, [&](KV &, KV &) { ++n; });
+    REQUIRE(n == 2 * items.size());
+  }
+}
+
+/*
+ * A join worker collecting its output by tag, with sync tokens dropped.
+ */
+class join_worker : public base_JFMBK_worker<pico::Token<KV>, pico::Token<KV>,
+                                             pico::Token<KV>> {
+  typedef base_JFMBK_worker<pico::Token<KV>, pico::Token<KV>, pico::Token<KV>>
+      worker_t;
+  typedef pico::base_microbatch::tag_t tag_t;
+  typedef pico::TokenCollector<KV>::cnode cnode_t;
+
+ public:
+  using worker_t::stored;
+  using worker_t::worker_t;
+
+  std::map<tag_t, std::vector<std::pair<int, int>>> output;
+  std::vector<tag_t> finalized;
+
+  void begin(tag_t tag, char *origin) {
+    handle_cstream_begin(tag);
+    kernel(make_sync(tag, origin));
+  }
+
+  void feed(tag_t tag, const std::vector<KV> &items) {
+    auto mb = NEW<pico::Microbatch<pico::Token<KV>>>(tag, items.size());
+    for (auto &kv : items) {
+      new (mb->allocate()) KV(kv);
+      mb->commit();
+    }
+    kernel(mb);
+  }
+
+ protected:
+  void send_mb(pico::base_microbatch *mb) { DELETE(mb); }
+
+ private:
+  void handle_output(tag_t tag, cnode_t *it) {
+    while (it) {
+      for (auto &kv : *it->mb) output[tag].emplace_back(kv.Key(), kv.Value());
+      DELETE(it->mb);
+      auto next = it->next;
+      FREE(it);
+      it = next;
+    }
+  }
+
+  void finalize_output_tag(tag_t tag) { finalized.push_back(tag); }
+};
+
+/*
+ * the pairs joining the given collections, as produced by the kernel
+ */
+static std::vector<std::pair<int, int>> join(const std::vector<KV> &left,
+                                             const std::vector<KV> &right) {
+  std::vector<std::pair<int, int>> res;
+  for (auto &l : left)
+    for (auto &r : right)
+      if (l.Key() == r.Key())
+        res.emplace_back(l.Key(), l.Value() * 1000 + r.Value());
+  std::sort(res.begin(), res.end());
+  return res;
+}
+
+static std::vector<KV> items(int from, int n) {
+  std::vector<KV> res;
+  for (int i = 0; i < n; ++i) res.push_back(KV(i % 10, from + i));
+  return res;
+}
+
+TEST_CASE("join worker", "[join table]") {
+  auto kernel = [](KV &l, KV &r, pico::FlatMapCollector<KV> &c) {
+    c.add(KV(l.Key(), l.Value() * 1000 + r.Value()));
+  };
+
+  /*
+   * The cached collection is taken from the right (resp. left) input when
+   * only the left (resp. right) one has an input.
+   * Two non-cached collections are joined with it: the first one completes
+   * before the cached one does, the second one straddles its completion.
+   */
+  for (bool cache_left : {false, true}) {
+    join_worker w(kernel, !cache_left, 16);
+    char *cached_origin =
+        cache_left ? PICO_CSTREAM_FROM_LEFT : PICO_CSTREAM_FROM_RIGHT;
+    char *other_origin =
+        cache_left ? PICO_CSTREAM_FROM_RIGHT : PICO_CSTREAM_FROM_LEFT;
+    auto t1 = pico::base_microbatch::fresh_tag();
+    auto t2 = pico::base_microbatch::fresh_tag();
+    auto tc = pico::base_microbatch::fresh_tag();
+    auto a = items(100, 30), b1 = items(200, 25), b2 = items(300, 25);
+    auto c1 = items(400, 20), c2 = items(500, 40);
+
+    /* stored, with nothing to be joined with yet */
+    w.begin(t1, other_origin);
+    w.feed(t1, a);
+    REQUIRE(w.stored(t1) == a.size());
+
+    /* joined with the stored part of t1 */
+    w.begin(tc, cached_origin);
+    w.feed(tc, b1);
+
+    /* kept for the rest of the cached collection */
+    w.handle_cstream_end(t1);
+    REQUIRE(w.finalized.empty());
+    REQUIRE(w.stored(t1) == a.size());
+
+    /* joined with the cached part so far, and stored */
+    w.begin(t2, other_origin);
+    w.feed(t2, c1);
+    REQUIRE(w.stored(t2) == c1.size());
+
+    /* joined with both t1 and t2 */
+    w.feed(tc, b2);
+
+    /* completes t1 */
+    w.handle_cstream_end(tc);
+    REQUIRE(w.finalized == std::vector<tag_t>{t1});
+    REQUIRE(w.stored(t1) == 0);
+    REQUIRE(w.stored(tc) == b1.size() + b2.size());
+
+    /* joined with the complete cached collection, without being stored */
+    w.feed(t2, c2);
+    REQUIRE(w.stored(t2) == c1.size());
+    w.handle_cstream_end(t2);
+    REQUIRE(w.finalized == (std::vector<tag_t>{t1, t2}));
+    REQUIRE(w.stored(t2) == 0);
+
+    w.end_callback();
+    REQUIRE(w.stored(tc) == 0);
+
+    auto b(b1);
+    b.insert(b.end(), b2.begin(), b2.end());
+    auto c(c1);
+    c.insert(c.end(), c2.begin(), c2.end());
+    for (auto &o : w.output) std::sort(o.second.begin(), o.second.end());
+    REQUIRE(w.output.size() == 2);
+    REQUIRE(w.output[t1] == (cache_left ? join(b, a) : join(a, b)));
+    REQUIRE(w.output[t2] == (cache_left ? join(b, c) : join(c, b)));
+  }
+}
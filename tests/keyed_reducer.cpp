@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include "pico/Internals/KeyedReducer.hpp"
+
+/*
+ * The reduce state is tested directly, so that each aggregation strategy is
+ * exercised regardless of the sizes the operators would pick.
+ */
+
+static long sum(long &a, long &b) { return a + b; }
+
+/* distinct keys spread over all the bytes of an int, negative ones included */
+static int spread_key(unsigned i) { return (int)(i * 2654435761u); }
+
+/*
+ * drains the state into a vector, in emission order
+ */
+template <typename Reducer, typename K>
+static std::vector<std::pair<K, long>> drain(Reducer &r) {
+  std::vector<std::pair<K, long>> res;
+  r.drain(sum, [&](const K &k, const long &v) { res.emplace_back(k, v); });
+  return res;
+}
+
+/*
+ * tells whether the keys are strictly ascending, i.e., sorted with no
+ * duplicates
+ */
+template <typename K>
+static bool ascending(const std::vector<std::pair<K, long>> &kvs) {
+  for (size_t i = 1; i < kvs.size(); ++i)
+    if (!(kvs[i - 1].first < kvs[i].first)) return false;
+  return true;
+}
+
+TEST_CASE("sort reducer", "[keyed reducer]") {
+  SECTION("multi-byte keys, small runs") {
+    /* 3000 keys, each one reduced 20 times, in runs of 16 pairs */
+    pico::sort_reducer<int, long> r(16);
+    std::map<int, long> expected;
+    for (unsigned i = 0; i < 60000; ++i) {
+      int k = spread_key(i % 3000);
+      long v = i;
+      r.reduce(k, v, sum);
+      expected[k] += v;
+    }
+    auto res = drain<decltype(r), int>(r);
+    REQUIRE(ascending(res));
+    REQUIRE(std::map<int, long>(res.begin(), res.end()) == expected);
+    REQUIRE(r.empty());
+  }
+
+  SECTION("log-structured merge") {
+    /*
+     * The same 16 keys in each run. Since SORT_MERGE_FANOUT runs of the same
+     * level are merged into one of the next level, the runs kept after n
+     * seals are as many as the digits of n in base SORT_MERGE_FANOUT add up
+     * to, each holding the 16 keys.
+     */
+    const unsigned keys = 16, n = SORT_MERGE_FANOUT * SORT_MERGE_FANOUT + 3;
+    auto kept_runs = [](unsigned sealed) {
+      unsigned res = 0;
+      for (; sealed; sealed /= SORT_MERGE_FANOUT)
+        res += sealed % SORT_MERGE_FANOUT;
+      return res;
+    };
+    pico::sort_reducer<int, long> r(keys);
+    bool merged = true;
+    for (unsigned sealed = 1; sealed <= n; ++sealed) {
+      for (unsigned i = 0; i < keys; ++i) r.reduce(spread_key(i), 1, sum);
+      merged = merged && r.size() == keys * kept_runs(sealed);
+    }
+    REQUIRE(merged);
+    auto res = drain<decltype(r), int>(r);
+    REQUIRE(ascending(res));
+    REQUIRE(res.size() == keys);
+    for (auto &kv : res) REQUIRE(kv.second == n);
+  }
+
+  SECTION("comparison-sorted keys") {
+    pico::sort_reducer<std::string, long> r(16);
+    std::map<std::string, long> expected;
+    for (unsigned i = 0; i < 10000; ++i) {
+      auto k = std::to_string(spread_key(i % 700));
+      r.reduce(k, 1, sum);
+      expected[k] += 1;
+    }
+    auto res = drain<decltype(r), std::string>(r);
+    REQUIRE(ascending(res));
+    REQUIRE(std::map<std::string, long>(res.begin(), res.end()) == expected);
+  }
+}
+
+TEST_CASE("keyed reducer", "[keyed reducer]") {
+  SECTION("automatic switch to sorting") {
+    /* one key beyond the threshold, each one reduced twice */
+    const unsigned keys = SORT_AGG_KEYS + 1;
+    pico::keyed_reducer<int, long> r;
+    bool hashing = true;
+    for (unsigned i = 0; i < keys; ++i) {
+      hashing = hashing && !r.sort_based();
+      long v = 1;
+      r.reduce(spread_key(i), v, sum);
+    }
+    REQUIRE(hashing);
+    REQUIRE(r.sort_based());
+    for (unsigned i = 0; i < keys; ++i) {
+      long v = 2;
+      r.reduce(spread_key(i), v, sum);
+    }
+    auto res = drain<decltype(r), int>(r);
+    REQUIRE(ascending(res));
+    REQUIRE(res.size() == keys);
+    bool sums = true;
+    for (auto &kv : res) sums = sums && kv.second == 3;
+    REQUIRE(sums);
+  }
+
+  SECTION("cardinality hint") {
+    REQUIRE(!pico::keyed_reducer<int, long>(SORT_AGG_KEYS).sort_based());
+    REQUIRE(pico::keyed_reducer<int, long>(SORT_AGG_KEYS + 1).sort_based());
+  }
+
+  SECTION("forced aggregation") {
+    pico::keyed_state_cfg cfg;
+    cfg.agg = pico::Aggregation::SORT;
+    pico::keyed_reducer<int, long> sorting(0, cfg);
+    cfg.agg = pico::Aggregation::HASH;
+    pico::keyed_reducer<int, long> hashing(SORT_AGG_KEYS + 1, cfg);
+    REQUIRE(sorting.sort_based());
+    REQUIRE(!hashing.sort_based());
+
+    std::map<int, long> expected;
+    for (unsigned i = 0; i < 50000; ++i) {
+      int k = spread_key(i % 5000);
+      long v = i;
+      sorting.reduce(k, v, sum);
+      hashing.reduce(k, v, sum);
+      expected[k] += i;
+    }
+    auto sorted = drain<decltype(sorting), int>(sorting);
+    auto hashed = drain<decltype(hashing), int>(hashing);
+    REQUIRE(ascending(sorted));
+    REQUIRE(std::map<int, long>(sorted.begin(), sorted.end()) == expected);
+    REQUIRE(std::map<int, long>(hashed.begin(), hashed.end()) == expected);
+  }
+}
+
+TEST_CASE("spilling keyed state", "[keyed reducer]") {
+  SECTION("level merge of spilled runs") {
+    /*
+     * A budget of a few pairs, so that each run is spilled. Spilling the
+     * SPILL_MERGE_FANOUT-th run of distinct keys merges all the spilled runs
+     * into one, thus rewriting at least as many bytes as spilled so far.
+     */
+    pico::sort_reducer<int, long> r(SORT_RUN_ITEMS, 64);
+    std::map<int, long> expected;
+    unsigned long long before = 0;
+    unsigned i = 0;
+    for (; r.stats().runs < SPILL_MERGE_FANOUT; ++i) {
+      before = r.stats().bytes;
+      r.reduce(spread_key(i), 1, sum);
+      expected[spread_key(i)] += 1;
+    }
+    REQUIRE(r.stats().bytes >= 2 * before);
+
+    /* enough runs for merges at the next level, with duplicate keys */
+    const unsigned keys = 30000;
+    for (unsigned j = 0; j < 2 * keys; ++j) {
+      r.reduce(spread_key(j % keys), 2, sum);
+      expected[spread_key(j % keys)] += 2;
+    }
+    REQUIRE(r.stats().runs > SPILL_MERGE_FANOUT * SPILL_MERGE_FANOUT);
+
+    auto res = drain<decltype(r), int>(r);
+    REQUIRE(ascending(res));
+    REQUIRE(std::map<int, long>(res.begin(), res.end()) == expected);
+    REQUIRE(r.empty());
+  }
+
+  SECTION("memory budget") {
+    /* the hash table outgrows the budget, then sorted runs are spilled */
+    pico::keyed_state_cfg cfg;
+    cfg.memory_budget = 1 << 12;
+    pico::keyed_reducer<int, long> r(0, cfg);
+    std::map<int, long> expected;
+    for (unsigned i = 0; i < 100000; ++i) {
+      int k = spread_key(i % 20000);
+      long v = i;
+      r.reduce(k, v, sum);
+      expected[k] += i;
+    }
+    REQUIRE(r.sort_based());
+    REQUIRE(r.spills().runs > 0);
+    REQUIRE(r.spills().bytes > 0);
+    REQUIRE(!r.spills().budget_ignored);
+
+    auto res = drain<decltype(r), int>(r);
+    REQUIRE(ascending(res));
+    REQUIRE(std::map<int, long>(res.begin(), res.end()) == expected);
+  }
+
+  SECTION("unspillable values") {
+    /* values with no spill codec are kept in memory, as reported */
+    typedef std::vector<int> values;
+    auto append = [](values &a, values &b) {
+      b.insert(b.end(), a.begin(), a.end());
+      return b;
+    };
+    pico::keyed_state_cfg cfg;
+    cfg.memory_budget = 1 << 12;
+    pico::keyed_reducer<int, values> r(0, cfg);
+    REQUIRE(!pico::keyed_reducer<int, values>::spillable);
+    for (int i = 0; i < 20000; ++i) {
+      values v{i};
+      r.reduce(i % 5000, v, append);
+    }
+    REQUIRE(r.spills().budget_ignored);
+    REQUIRE(r.spills().runs == 0);
+
+    size_t keys = 0, items = 0;
+    r.drain(append, [&](const int &, const values &v) {
+      ++keys;
+      items += v.size();
+    });
+    REQUIRE(keys == 5000);
+    REQUIRE(items == 20000);
+  }
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ *
+ * This file is part of pico
+ * (see https://github.com/alpha-unito/pico).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include "pico/ff_implementation/pool_allocator.hpp"
+
+/*
+ * The allocator is tested directly, so that it is exercised whether or not
+ * the tests are built with PICO_POOL_ALLOC.
+ */
+
+static size_t block_size(int i) { return 16 + (i % 16) * 200; }
+
+static bool check_block(void *p, int i) {
+  auto c = (unsigned char *)p;
+  for (size_t j = 0; j < block_size(i); ++j)
+    if (c[j] != (unsigned char)i) return false;
+  return true;
+}
+
+TEST_CASE("pool allocator frees from other threads", "[pool allocator]") {
+  using namespace pico::pool;
+  const int n = 20000;
+  auto tc = my_cache();
+  REQUIRE(tc != nullptr);
+
+  std::vector<void *> blocks;
+  bool aligned = true;
+  for (int i = 0; i < n; ++i) {
+    void *p = allocate(block_size(i));
+    aligned = aligned && ((uintptr_t)p & 15) == 0;
+    memset(p, i, block_size(i));
+    blocks.push_back(p);
+  }
+  REQUIRE(aligned);
+
+  /* blocks are released by a consumer thread, as microbatches are */
+  auto remote_frees = tc->remote_frees.load();
+  bool intact = true;
+  std::thread consumer([&]() {
+    for (int i = 0; i < n; ++i) {
+      intact = intact && check_block(blocks[i], i);
+      deallocate(blocks[i]);
+    }
+  });
+  consumer.join();
+  REQUIRE(intact);
+  REQUIRE(tc->remote_frees.load() - remote_frees == n);
+
+  /* the owner reclaims them */
+  auto hits = tc->hits.load();
+  for (int i = 0; i < n; ++i) {
+    blocks[i] = allocate(block_size(i));
+    memset(blocks[i], i, block_size(i));
+  }
+  REQUIRE(tc->hits.load() - hits == n);
+
+  SECTION("concurrent reclaims") {
+    /* the owner allocates while the consumer frees */
+    std::vector<void *> more(n);
+    std::thread consumer([&]() {
+      for (int i = 0; i < n; ++i) {
+        intact = intact && check_block(blocks[i], i);
+        deallocate(blocks[i]);
+      }
+    });
+    for (int i = 0; i < n; ++i) {
+      more[i] = allocate(block_size(i));
+      memset(more[i], i, block_size(i));
+    }
+    consumer.join();
+    for (int i = 0; i < n; ++i) {
+      intact = intact && check_block(more[i], i);
+      deallocate(more[i]);
+    }
+    REQUIRE(intact);
+  }
+
+  SECTION("large and aligned blocks") {
+    for (int i = 0; i < n; ++i) deallocate(blocks[i]);
+    void *large = allocate(max_class_size + 1);
+    void *page = nullptr;
+    REQUIRE(pico::pool::posix_memalign(&page, 4096, 100) == 0);
+    REQUIRE(((uintptr_t)page & 4095) == 0);
+    memset(large, 1, max_class_size + 1);
+    memset(page, 2, 100);
+    std::thread consumer([&]() {
+      deallocate(large);
+      deallocate(page);
+    });
+    consumer.join();
+  }
+}
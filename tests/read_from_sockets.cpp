@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2019 alpha group, CS department, University of Torino.
+ * 
+ * This file is part of pico 
+ * (see https://github.com/alpha-unito/pico).
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include "pico/pico.hpp"
+
+#include "common/io.hpp"
+
+/*
+ * many loopback producers, each sending a numbered sequence of lines
+ */
+
+constexpr unsigned n_producers = 4, n_lines = 10000;
+
+static void produce(int fd, unsigned id) {
+  std::string out;
+  for (unsigned i = 0; i < n_lines; ++i)
+    out += std::to_string(id) + " " + std::to_string(i) + "\n";
+  size_t sent = 0;
+  while (sent < out.size()) {
+    ssize_t n = write(fd, out.data() + sent, out.size() - sent);
+    if (n <= 0) break;
+    sent += n;
+  }
+  close(fd);
+}
+
+static sockaddr_in loopback(int port) {
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  return addr;
+}
+
+/* connects to the reader, retrying until it listens */
+static void connect_and_produce(int port, unsigned id) {
+  auto addr = loopback(port);
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  while (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    usleep(10000);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+  }
+  produce(fd, id);
+}
+
+/* listens on a port and serves a single connection */
+static int listen_on(int port) {
+  int option = 1, fd = socket(AF_INET, SOCK_STREAM, 0);
+  auto addr = loopback(port);
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+  REQUIRE(bind(fd, (sockaddr *)&addr, sizeof(addr)) == 0);
+  REQUIRE(listen(fd, 1) == 0);
+  return fd;
+}
+
+TEST_CASE("read from sockets", "read from sockets tag") {
+  std::string output_file = "output.txt";
+  std::vector<std::thread> producers;
+
+  /* redirect stdout to output file */
+  auto coutbuf = std::cout.rdbuf();  // save old buf
+  std::ofstream out(output_file);
+  std::cout.rdbuf(out.rdbuf());  // redirect
+
+  pico::WriteToStdOut<std::string> writer;
+
+  SECTION("listening") {
+    pico::ReadFromSockets<> reader(4001, n_producers, '\n', 2);
+    auto test_pipe = pico::Pipe().add(reader).add(writer);
+    for (unsigned i = 0; i < n_producers; ++i)
+      producers.emplace_back(connect_and_produce, 4001, i);
+    test_pipe.run();
+  }
+  SECTION("connecting") {
+    std::vector<std::pair<std::string, int>> endpoints;
+    for (unsigned i = 0; i < n_producers; ++i) {
+      int server = listen_on(4010 + i);
+      endpoints.emplace_back("localhost", 4010 + i);
+      producers.emplace_back([server, i]() {
+        produce(accept(server, nullptr, nullptr), i);
+        close(server);
+      });
+    }
+    pico::ReadFromSockets<> reader(endpoints, '\n', 2);
+    pico::Pipe().add(reader).add(writer).run();
+  }
+
+  for (auto &p : producers) p.join();
+
+  /* undo stdout redirection */
+  std::cout.rdbuf(coutbuf);
+  out.close();
+
+  /* each producer's lines must come in order */
+  std::vector<unsigned> next(n_producers, 0);
+  for (auto line : read_lines(output_file)) {
+    std::istringstream is(line);
+    unsigned id, i;
+    is >> id >> i;
+    REQUIRE(id < n_producers);
+    REQUIRE(i == next[id]);
+    ++next[id];
+  }
+  for (auto n : next) REQUIRE(n == n_lines);
+}
@@ -18,6 +18,10 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <iostream>
 #include <string>
 
@@ -69,3 +73,51 @@ TEST_CASE("read from stdin and write", "read from stdin and write tag") {
 
   REQUIRE(input_lines == output_lines);
 }
+
+TEST_CASE("read from stdin in parallel", "read from stdin in parallel tag") {
+  std::string input_file = "./testdata/lines.txt";
+  std::string output_file = "output.txt";
+
+  /* redirect input file to the stdin descriptor */
+  int stdin_fd = dup(0);
+  int in_fd = open(input_file.c_str(), O_RDONLY);
+  REQUIRE(in_fd >= 0);
+  dup2(in_fd, 0);
+  close(in_fd);
+
+  auto input_lines = read_lines(input_file);
+  std::vector<std::string> output_lines;
+
+  SECTION("stream") {
+    /* redirect stdout to output file */
+    auto coutbuf = std::cout.rdbuf();  // save old buf
+    std::ofstream out(output_file);
+    std::cout.rdbuf(out.rdbuf());  // redirect
+
+    pico::Pipe()
+        .add(pico::ReadFromStdIn('\n', 4))
+        .add(pico::WriteToStdOut<std::string>())
+        .run();
+
+    std::cout.rdbuf(coutbuf);
+    out.close();
+    output_lines = read_lines(output_file);
+  }
+  SECTION("bag") {
+    pico::Pipe()
+        .add(pico::BasicReadFromStdIn<pico::LineView>('\n', 4).unordered())
+        .add(pico::WriteToDisk<pico::LineView>(output_file))
+        .run();
+
+    /* forget the order */
+    output_lines = read_lines(output_file);
+    std::sort(input_lines.begin(), input_lines.end());
+    std::sort(output_lines.begin(), output_lines.end());
+  }
+
+  /* undo redirection */
+  dup2(stdin_fd, 0);
+  close(stdin_fd);
+
+  REQUIRE(input_lines == output_lines);
+}
@@ -18,17 +18,29 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <catch.hpp>
 
+#include "pico/Internals/SkewPartitioner.hpp"
 #include "pico/pico.hpp"
 
 #include "common/io.hpp"
 
 typedef pico::KeyValue<char, int> KV;
 
-TEST_CASE("reduce by key", "reduce by key tag") {
+/*
+ * If standalone, the pairs are reduced twice: the second reduce follows
+ * another reduce (rather than a Map), thus it is not fused with its input.
+ */
+static void reduce_pairs(const pico::ReduceByKey<KV> &reducer,
+                         bool standalone = false) {
   std::string input_file = "./testdata/pairs.txt";
   std::string output_file = "output.txt";
 
@@ -39,13 +51,14 @@ TEST_CASE("reduce by key", "reduce by key tag") {
                                [&](KV in) { return in.to_string(); });
 
   /* compose the pipeline */
-  auto test_pipe =
+  auto reduce_pipe =
       pico::Pipe()
           .add(reader)
           .add(pico::Map<std::string, KV>(
               [](std::string line) { return KV::from_string(line); }))
-          .add(pico::ReduceByKey<KV>([](int v1, int v2) { return v1 + v2; }))
-          .add(writer);
+          .add(reducer);
+  auto test_pipe = standalone ? reduce_pipe.add(reducer).add(writer)
+                              : reduce_pipe.add(writer);
 
   test_pipe.run();
 
@@ -67,3 +80,138 @@ TEST_CASE("reduce by key", "reduce by key tag") {
 
   REQUIRE(expected == observed);
 }
+
+TEST_CASE("reduce by key", "reduce by key tag") {
+  pico::ReduceByKey<KV> reducer([](int v1, int v2) { return v1 + v2; });
+
+  SECTION("default") { reduce_pairs(reducer); }
+
+  SECTION("cardinality hint") {
+    /* both under- and over-estimated number of keys */
+    reduce_pairs(reducer.cardinality(4));
+    reduce_pairs(reducer.cardinality(1 << 16));
+  }
+
+  SECTION("aggregation") {
+    reduce_pairs(reducer.aggregation(pico::Aggregation::HASH));
+    reduce_pairs(reducer.aggregation(pico::Aggregation::SORT));
+    reduce_pairs(reducer.aggregation(pico::Aggregation::SORT), true);
+  }
+
+  SECTION("memory budget") {
+    /* tiny budgets, so that the state is spilled to disk */
+    reduce_pairs(reducer.memory_budget(64));
+    reduce_pairs(reducer.memory_budget(64), true);
+  }
+
+  SECTION("standalone") {
+    pico::ReduceByKey<KV> seq_reducer([](int v1, int v2) { return v1 + v2; },
+                                      1);
+    reduce_pairs(reducer, true);
+    reduce_pairs(seq_reducer, true);
+    reduce_pairs(reducer.combiner(4), true);
+  }
+}
+
+/*
+ * Key i is drawn with probability proportional to 1/(i+1), by a
+ * low-discrepancy sequence.
+ */
+class skewed_keys {
+ public:
+  skewed_keys(int keys) {
+    for (int i = 0; i < keys; ++i) cdf.push_back(total += 1.0 / (i + 1));
+  }
+
+  int operator()(int i) const {
+    double x = std::fmod(i * 0.6180339887, 1.0) * total;
+    return std::lower_bound(cdf.begin(), cdf.end(), x) - cdf.begin();
+  }
+
+ private:
+  std::vector<double> cdf;
+  double total = 0;
+};
+
+TEST_CASE("reduce by key with skewed keys", "reduce by key tag") {
+  typedef pico::KeyValue<int, int> IKV;
+  std::string input_file = "skewed_pairs.txt";
+  std::string output_file = "output.txt";
+  const int keys = 100, pairs = 400000;
+
+  /*
+   * Behind a tiny combiner, the most frequent keys keep being evicted, so
+   * that they get hot in the shuffle and are split across the reducers.
+   */
+  skewed_keys key(keys);
+  std::unordered_map<int, int> expected;
+  {
+    std::ofstream out(input_file);
+    for (int i = 0; i < pairs; ++i) {
+      IKV kv(key(i), i % 5 + 1);
+      out << kv.to_string() << "\n";
+      expected[kv.Key()] += kv.Value();
+    }
+  }
+
+  pico::Pipe()
+      .add(pico::ReadFromFile(input_file, 2))
+      .add(pico::Map<std::string, IKV>(
+          [](std::string line) { return IKV::from_string(line); }, 2))
+      .add(pico::ReduceByKey<IKV>([](int v1, int v2) { return v1 + v2; }, 8)
+               .combiner(4))
+      .add(pico::WriteToDisk<IKV>(output_file))
+      .run();
+
+  /* each key, hot or not, is reduced to exactly one pair */
+  std::unordered_map<int, int> observed;
+  for (auto pair : read_lines(output_file)) {
+    auto kv = IKV::from_string(pair);
+    REQUIRE(observed.find(kv.Key()) == observed.end());
+    observed[kv.Key()] = kv.Value();
+  }
+
+  REQUIRE(expected == observed);
+}
+
+TEST_CASE("skew partitioner", "reduce by key tag") {
+  const int keys = 100, pairs = 400000;
+  const unsigned n = 8;
+  skewed_keys key(keys);
+  auto published = std::make_shared<pico::hot_key_set<int>>();
+  pico::skew_partitioner<int> partitioner(n, published);
+
+  /* the workers each key is routed to, once the sketch is warm */
+  std::unordered_map<int, std::unordered_set<unsigned>> routes;
+  bool in_range = true;
+  for (int i = 0; i < pairs; ++i) {
+    int k = key(i);
+    auto dst = partitioner(k);
+    in_range = in_range && dst < n;
+    if (i >= pairs / 2) routes[k].insert(dst);
+  }
+  REQUIRE(in_range);
+
+  /*
+   * The most frequent key takes about 1/5 of the traffic, i.e., more than the
+   * fair share of a worker: it must be marked hot and published.
+   */
+  std::unordered_set<int> hot;
+  published->refresh(hot);
+  REQUIRE(partitioner.hot_keys() > 0);
+  REQUIRE(hot.size() == partitioner.hot_keys());
+  REQUIRE(hot.count(0));
+  REQUIRE(!hot.count(keys - 1));
+  REQUIRE(routes[0].size() > 1);
+  REQUIRE(routes[keys - 1].size() == 1);
+
+  /*
+   * no worker gets more than 1.5 times its fair share, that is less than the
+   * traffic of the most frequent key alone
+   */
+  auto &load(partitioner.load());
+  unsigned long long routed = 0;
+  for (auto l : load) routed += l;
+  REQUIRE(routed == (unsigned long long)pairs);
+  REQUIRE(2 * *std::max_element(load.begin(), load.end()) < 3 * pairs / n);
+}
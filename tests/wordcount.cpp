@@ -106,3 +106,95 @@ TEST_CASE("wordcount", "wordcount tag") {
 
   REQUIRE(expected == observed);
 }
+
+TEST_CASE("wordcount with adaptive microbatches",
+          "wordcount adaptive microbatch tag") {
+  std::string input_file = "./testdata/lines.txt";
+  std::string output_file = "output.txt";
+
+  auto countWords =
+      pico::Pipe()                                         // the empty pipeline
+          .add(pico::FlatMap<std::string, KV>(tokenizer))  //
+          .add(pico::ReduceByKey<KV>([](int v1, int v2) { return v1 + v2; }));
+
+  pico::ReadFromFile reader(input_file);
+  pico::WriteToDisk<KV> writer(output_file,
+                               [](KV in) { return in.to_string(); });
+
+  auto wc = pico::Pipe().add(reader).to(countWords).add(writer);
+
+  SECTION("throughput target") { wc.throughput_target(1e9); }
+  SECTION("latency target") { wc.latency_target(0.01); }
+
+  wc.run();
+
+  auto observed = read_lines(output_file);
+  std::sort(observed.begin(), observed.end());
+
+  auto expected = to_vec_str(seq_wc(read_lines(input_file)));
+  std::sort(expected.begin(), expected.end());
+
+  REQUIRE(expected == observed);
+}
+
+TEST_CASE("wordcount with per-operator microbatches",
+          "wordcount per-operator microbatch tag") {
+  std::string input_file = "./testdata/lines.txt";
+  std::string output_file = "output.txt";
+
+  auto tokenize = pico::FlatMap<std::string, KV>(tokenizer).microbatch(3);
+  auto reduce =
+      pico::ReduceByKey<KV>([](int v1, int v2) { return v1 + v2; })
+          .microbatch_bytes(4096);
+  auto countWords = pico::Pipe().add(tokenize).add(reduce);
+
+  auto reader = pico::ReadFromFile(input_file).microbatch(1);
+  pico::WriteToDisk<KV> writer(output_file,
+                               [](KV in) { return in.to_string(); });
+
+  auto wc = pico::Pipe().add(reader).to(countWords).add(writer);
+
+  wc.run();
+
+  auto observed = read_lines(output_file);
+  std::sort(observed.begin(), observed.end());
+
+  auto expected = to_vec_str(seq_wc(read_lines(input_file)));
+  std::sort(expected.begin(), expected.end());
+
+  REQUIRE(expected == observed);
+}
+
+TEST_CASE("wordcount with bounded combiners", "wordcount combiner tag") {
+  std::string input_file = "./testdata/lines.txt";
+  std::string output_file = "output.txt";
+
+  auto sum = [](int v1, int v2) { return v1 + v2; };
+  auto count_words = [&](const pico::ReduceByKey<KV>& reduce) {
+    pico::ReadFromFile reader(input_file);
+    pico::WriteToDisk<KV> writer(output_file,
+                                 [](KV in) { return in.to_string(); });
+    pico::Pipe()
+        .add(reader)
+        .add(pico::FlatMap<std::string, KV>(tokenizer))
+        .add(reduce)
+        .add(writer)
+        .run();
+  };
+
+  /* tiny combiners, so that partial counts are evicted along the stream */
+  SECTION("sequential reduce") {
+    count_words(pico::ReduceByKey<KV>(sum, 1).combiner(8));
+  }
+  SECTION("parallel reduce") {
+    count_words(pico::ReduceByKey<KV>(sum).combiner(8));
+  }
+
+  auto observed = read_lines(output_file);
+  std::sort(observed.begin(), observed.end());
+
+  auto expected = to_vec_str(seq_wc(read_lines(input_file)));
+  std::sort(expected.begin(), expected.end());
+
+  REQUIRE(expected == observed);
+}